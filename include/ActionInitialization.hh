@@ -6,8 +6,11 @@
 #define ActionInitialization_h 1
 
 #include "G4VUserActionInitialization.hh"
+#include "globals.hh"
 
 class DetectorConstruction;
+class SecondaryFilter;
+class G4GenericMessenger;
 
 class ActionInitialization : public G4VUserActionInitialization
 {
@@ -20,6 +23,13 @@ class ActionInitialization : public G4VUserActionInitialization
     
   private:
     DetectorConstruction* fDetectorConstruction;
+    
+    // Install the global stepping action (level 2 step trace, looper kills)
+    G4bool fUseSteppingAction;
+    
+    // Stacking-time kill policy shared by the stacking actions of all threads
+    SecondaryFilter* fSecondaryFilter;
+    G4GenericMessenger* fMessenger;
 };
 
 #endif
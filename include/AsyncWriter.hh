@@ -0,0 +1,108 @@
+// ==========================
+// include/AsyncWriter.hh
+// ==========================
+
+#ifndef AsyncWriter_h
+#define AsyncWriter_h 1
+
+#include "globals.hh"
+#include "SpscQueue.hh"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+class EventOutput;
+struct OutputEvent;
+
+// Queue of completed events from one worker's EventOutput to the writer
+// thread. Events travel one way and come back empty for reuse the other
+// way, so a worker allocates only until the queue reaches its working
+// depth. Push blocks while the queue is full or holds more than the memory
+// budget, which bounds the memory between a fast producer and the disk.
+class AsyncChannel
+{
+  public:
+    AsyncChannel(EventOutput* owner, std::size_t depth);
+    ~AsyncChannel();
+    
+    // Producer side
+    
+    // An empty event to fill, reused when the writer has returned one
+    OutputEvent* Acquire();
+    
+    // Hand a filled event to the writer, waiting while over the limits
+    void Push(OutputEvent* event);
+    
+    // Wait until the writer has written every event pushed so far
+    void Drain();
+    
+    void SetBudget(std::size_t bytes) { fBudget = bytes; }
+    void ResetStatistics();
+    
+    std::uint64_t GetEvents() const { return fEvents; }
+    std::size_t GetMaxDepth() const { return fMaxDepth; }
+    std::size_t GetPeakBytes() const { return fPeakBytes; }
+    std::uint64_t GetStalls() const { return fStalls; }
+    G4double GetStallTime() const { return fStallTime; }   // Seconds, Push and Drain
+    G4double GetDrainTime() const { return fDrainTime; }   // ... of which in Drain
+    std::size_t GetCapacity() const { return fFull.GetCapacity(); }
+    G4int GetThreadID() const { return fThreadID; }
+    
+    // Consumer side: write the queued events; false if there were none
+    G4bool Service();
+  
+  private:
+    EventOutput* fOwner;
+    G4int fThreadID;          // Of the producer
+    SpscQueue<OutputEvent*> fFull;
+    SpscQueue<OutputEvent*> fEmpty;
+    std::atomic<std::uint64_t> fWritten;
+    std::atomic<std::size_t> fBytesQueued;
+    
+    // Producer only
+    std::uint64_t fPushed;
+    std::size_t fBudget;
+    std::uint64_t fEvents;
+    std::size_t fMaxDepth;
+    std::size_t fPeakBytes;
+    std::uint64_t fStalls;
+    G4double fStallTime;
+    G4double fDrainTime;
+};
+
+// Writer thread serving the channels of all workers.
+//
+// Formatting, compression and writes of the output shards happen on this
+// thread, so a worker's end of event costs a copy of its hits into the
+// queue. The thread starts with the first channel and runs until exit,
+// sleeping when the channels are empty.
+class AsyncWriter
+{
+  public:
+    static AsyncWriter* Instance();
+    
+    // New channel of an EventOutput, served from now on
+    AsyncChannel* Connect(EventOutput* owner, std::size_t depth);
+    
+    // Print and reset the queue statistics of the channels for the run; on
+    // the master, after the workers have drained
+    void PrintReport();
+  
+  private:
+    AsyncWriter();
+    ~AsyncWriter();
+    
+    void Run();
+    
+    static const G4int kMaxChannels = 256;
+    
+    std::atomic<AsyncChannel*> fChannels[kMaxChannels];
+    std::atomic<G4int> fNChannels;
+    std::mutex fConnectMutex;
+    std::thread fThread;
+    std::atomic<G4bool> fStop;
+    std::atomic<std::uint64_t> fBusyNanoseconds;
+};
+
+#endif
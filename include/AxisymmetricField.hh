@@ -0,0 +1,26 @@
+// ==============================
+// include/AxisymmetricField.hh
+// ==============================
+
+#ifndef AxisymmetricField_h
+#define AxisymmetricField_h 1
+
+#include "globals.hh"
+
+// Field with rotational symmetry about the z axis, described in the (r,z)
+// half-plane. Any such field can be sampled onto a FieldMap2D.
+class AxisymmetricField
+{
+  public:
+    virtual ~AxisymmetricField() {}
+    
+    // Static field components at (r,z): Br, Bz, Er, Ez
+    virtual void GetFieldRZ(G4double r, G4double z, G4double fieldRZ[4]) const = 0;
+    
+    // Extent outside which the field vanishes
+    virtual G4double GetMaxRadius() const = 0;
+    virtual G4double GetZMin() const = 0;
+    virtual G4double GetZMax() const = 0;
+};
+
+#endif
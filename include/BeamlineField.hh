@@ -0,0 +1,67 @@
+// ===========================
+// include/BeamlineField.hh
+// ===========================
+
+#ifndef BeamlineField_h
+#define BeamlineField_h 1
+
+#include "G4ElectroMagneticField.hh"
+#include <memory>
+#include <vector>
+
+// Sum of the fields of any number of beamline elements (solenoid sections,
+// RF cavities), each nonzero only within its own z range and radius.
+//
+// The element z ranges are cut at every element boundary into segments,
+// each listing the elements that cover it. A query finds its segment by
+// binary search and visits only those elements, so the cost grows as
+// log(n) with the lattice size and linearly only with the local overlap.
+// Successive queries along a track mostly fall in the same segment, which
+// is checked first, so tracking does not pay for the search at all.
+class BeamlineField : public G4ElectroMagneticField
+{
+  public:
+    BeamlineField();
+    virtual ~BeamlineField();
+    
+    // Takes ownership of the field, which must vanish outside the given
+    // extent. Elements may overlap; their fields add.
+    void AddElement(G4ElectroMagneticField* field, G4double zMin, G4double zMax,
+                    G4double maxRadius);
+    
+    // Build the segment index; call after the last AddElement
+    void BuildIndex();
+    
+    virtual void GetFieldValue(const G4double point[4], G4double* field) const;
+    
+    virtual G4bool DoesFieldChangeEnergy() const { return fChangesEnergy; }
+    
+    G4int GetNumberOfElements() const { return fElements.size(); }
+    G4int GetNumberOfSegments() const { return fSegmentStart.empty() ? 0 : fSegmentStart.size() - 1; }
+    
+    // Mean number of elements listed per segment, weighted by segment length
+    G4double GetMeanOverlap() const;
+    
+  private:
+    struct Element
+    {
+      G4double zMin;
+      G4double zMax;
+      G4double maxRadius2;
+      const G4ElectroMagneticField* field;
+    };
+    
+    std::vector<std::unique_ptr<G4ElectroMagneticField>> fFields;
+    std::vector<Element> fElements;
+    G4bool fChangesEnergy;
+    
+    // Segment s spans [fBoundaries[s], fBoundaries[s+1]) and covers the
+    // elements fSegmentElements[fSegmentStart[s] .. fSegmentStart[s+1])
+    std::vector<G4double> fBoundaries;
+    std::vector<G4int> fSegmentStart;
+    std::vector<G4int> fSegmentElements;
+    
+    mutable G4int fLastSegment;   // Segment of the previous query
+};
+
+#endif
@@ -0,0 +1,63 @@
+// =============================
+// include/BeamlineLattice.hh
+// =============================
+
+#ifndef BeamlineLattice_h
+#define BeamlineLattice_h 1
+
+#include "globals.hh"
+#include <vector>
+
+class BeamlineField;
+class G4GenericMessenger;
+
+// Definition of a beamline lattice of solenoid sections and RF cavities,
+// filled from macro commands or a lattice file on the master thread.
+// Each worker builds its own BeamlineField from it.
+//
+// One element per command or file line, lengths with a unit:
+//   solenoid <zCentre> <length> <radius> <unit> <Bz> <unit>
+//   cavity <zCentre> <length> <radius> <unit> <gradient> <unit> <frequency> <unit> <phase> <unit>
+// e.g. "solenoid 400 1200 90 cm 7 tesla" or
+//      "cavity 350 50 40 cm 1 MV/m 2856 MHz 0 deg".
+// In files, '#' starts a comment.
+class BeamlineLattice
+{
+  public:
+    BeamlineLattice();
+    ~BeamlineLattice();
+    
+    G4bool IsEnabled() const { return fEnabled; }
+    
+    // New field with one element per definition; with none defined, the
+    // default solenoid and RF cavity
+    BeamlineField* CreateField() const;
+    
+    // Parse one element definition; false if it is malformed
+    G4bool AddElement(const G4String& line);
+    
+  private:
+    struct ElementSpec
+    {
+      G4bool cavity;
+      G4double zCentre;
+      G4double length;
+      G4double radius;
+      G4double strength;    // Bz of a solenoid, peak Ez of a cavity
+      G4double frequency;
+      G4double phase;
+    };
+    
+    void AddCommand(const G4String& line);
+    void LoadCommand(const G4String& fileName);
+    void ClearCommand() { fElements.clear(); }
+    void ListCommand();
+    void BenchmarkCommand(G4int nPoints);
+    
+    std::vector<ElementSpec> fElements;
+    G4bool fEnabled;
+    
+    G4GenericMessenger* fMessenger;
+};
+
+#endif
@@ -0,0 +1,22 @@
+// =============================
+// include/BeamlinePhysics.hh
+// =============================
+
+#ifndef BeamlinePhysics_h
+#define BeamlinePhysics_h 1
+
+#include "G4VPhysicsConstructor.hh"
+
+// Processes modelling the beamline elements that are not part of the
+// reference physics list (helium cloud cooling, RF kick hook)
+class BeamlinePhysics : public G4VPhysicsConstructor
+{
+  public:
+    BeamlinePhysics(const G4String& name = "Beamline");
+    virtual ~BeamlinePhysics();
+    
+    virtual void ConstructParticle();
+    virtual void ConstructProcess();
+};
+
+#endif
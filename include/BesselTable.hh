@@ -0,0 +1,62 @@
+// ==========================
+// include/BesselTable.hh
+// ==========================
+
+#ifndef BesselTable_h
+#define BesselTable_h 1
+
+#include "globals.hh"
+#include <algorithm>
+#include <vector>
+
+// J0(x) and J1(x)/x, the radial profiles of Ez and Bphi/r in the TM010
+// pillbox mode, tabulated from the axis out to the first zero of J0,
+// where the cavity wall is.
+//
+// Both functions are even in x, so they are smooth in x^2, and the table
+// is indexed by x^2: a caller holding r^2 needs no square root, and
+// linear interpolation on 1024 points stays within ~1e-7 of the series.
+// The table is built once from the power series and shared by all threads.
+class BesselTable
+{
+  public:
+    static const BesselTable& Instance();
+    
+    // First zero of J0
+    static constexpr G4double kFirstZero = 2.404825557695773;
+    
+    // Interpolated J0(x) and J1(x)/x for x^2 in [0, kFirstZero^2]
+    inline void Evaluate(G4double x2, G4double& j0, G4double& j1OverX) const;
+    
+    // The power series, accurate to rounding for x^2 in the same range
+    static void Series(G4double x2, G4double& j0, G4double& j1OverX);
+    
+    G4int GetNPoints() const { return fNodes.size(); }
+  
+  private:
+    BesselTable();
+    
+    struct Node
+    {
+      G4double j0;
+      G4double j1OverX;
+    };
+    
+    std::vector<Node> fNodes;
+    G4double fInvSpacing;   // Nodes per unit of x^2
+    G4int fLastCell;
+};
+
+inline void BesselTable::Evaluate(G4double x2, G4double& j0, G4double& j1OverX) const
+{
+  G4double f = x2 * fInvSpacing;
+  G4int index = std::min(static_cast<G4int>(f), fLastCell);
+  G4double t = f - index;
+  
+  const Node& low = fNodes[index];
+  const Node& high = fNodes[index + 1];
+  j0 = low.j0 + t * (high.j0 - low.j0);
+  j1OverX = low.j1OverX + t * (high.j1OverX - low.j1OverX);
+}
+
+#endif
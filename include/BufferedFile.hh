@@ -0,0 +1,116 @@
+// ==========================
+// include/BufferedFile.hh
+// ==========================
+
+#ifndef BufferedFile_h
+#define BufferedFile_h 1
+
+#include "globals.hh"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+struct z_stream_s;
+
+// Output file written through a large buffer owned by one thread.
+//
+// Records are formatted straight into the buffer, which goes to disk in
+// one write when it fills, so a file costs one write call per buffer
+// rather than one per row, and nothing is shared between threads.
+//
+// The file can be written gzip-compressed, through a deflate stream of its
+// own, with the zlib that Geant4 ships. Every flush interval the stream is
+// synced to the file, so a crash loses at most the data since then; the
+// gzip members of several files can be concatenated into one.
+class BufferedFile
+{
+  public:
+    BufferedFile();
+    ~BufferedFile();
+    
+    BufferedFile(const BufferedFile&) = delete;
+    BufferedFile& operator=(const BufferedFile&) = delete;
+    
+    // Open for writing, truncating the file; false if it cannot be opened.
+    // A compression level of 1 to 9 writes gzip, synced every flushInterval
+    // bytes of data (never if 0)
+    G4bool Open(const G4String& fileName, std::size_t bufferSize,
+                G4int compressionLevel = 0, std::size_t flushInterval = 0);
+    
+    // Flush the buffer and close the file, ending the gzip stream
+    void Close();
+    
+    G4bool IsOpen() const { return fFile.is_open(); }
+    const G4String& GetFileName() const { return fFileName; }
+    
+    // Space for at least size bytes at the end of the buffer; Commit the
+    // number actually used
+    inline char* Reserve(std::size_t size);
+    void Commit(std::size_t size) { fFill += size; }
+    
+    // Blocks larger than the buffer go to the file directly
+    inline void Write(const void* data, std::size_t size);
+    
+    void Flush();
+    
+    // Bytes passed to the file so far, buffered ones included
+    std::uint64_t GetBytes() const { return fBytesFlushed + fFill; }
+    
+    // Bytes on disk so far, after compression
+    std::uint64_t GetFileBytes() const { return fFileBytes; }
+    
+    // Writes to the file so far
+    std::uint64_t GetWrites() const { return fWrites; }
+    
+    G4bool IsCompressed() const { return fStream != nullptr; }
+    
+    // Seconds spent in deflate
+    G4double GetCompressTime() const { return fCompressTime; }
+  
+  private:
+    void WriteThrough(const void* data, std::size_t size);
+    
+    // Run the deflate stream, writing what it produces
+    void Deflate(G4int flush);
+    
+    void WriteFile(const char* data, std::size_t size);
+    
+    std::ofstream fFile;
+    G4String fFileName;
+    std::vector<char> fBuffer;
+    std::size_t fFill;
+    std::uint64_t fBytesFlushed;
+    std::uint64_t fWrites;
+    std::uint64_t fFileBytes;
+    
+    z_stream_s* fStream;               // Null when not compressing
+    std::vector<char> fCompressed;     // Output of the stream
+    std::size_t fFlushInterval;
+    std::size_t fSinceSync;            // Data bytes since the last sync
+    G4double fCompressTime;
+};
+
+inline char* BufferedFile::Reserve(std::size_t size)
+{
+  if (fFill + size > fBuffer.size()) {
+    Flush();
+    if (size > fBuffer.size()) fBuffer.resize(size);
+  }
+  return fBuffer.data() + fFill;
+}
+
+inline void BufferedFile::Write(const void* data, std::size_t size)
+{
+  if (fFill + size > fBuffer.size()) {
+    Flush();
+    if (size >= fBuffer.size()) {
+      WriteThrough(data, size);
+      return;
+    }
+  }
+  std::memcpy(fBuffer.data() + fFill, data, size);
+  fFill += size;
+}
+
+#endif
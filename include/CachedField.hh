@@ -0,0 +1,39 @@
+// =========================
+// include/CachedField.hh
+// =========================
+
+#ifndef CachedField_h
+#define CachedField_h 1
+
+#include "G4ElectroMagneticField.hh"
+
+class FieldStatistics;
+
+// Caching decorator for a static field, in the spirit of
+// G4CachedMagneticField but passing all six components through. A query
+// within fDistance of the previous evaluation point returns the previous
+// value. The cache is mutable state, so each thread needs its own instance.
+class CachedField : public G4ElectroMagneticField
+{
+  public:
+    CachedField(const G4Field* field, G4double distance);
+    virtual ~CachedField();
+    
+    virtual void GetFieldValue(const G4double point[4], G4double* field) const;
+    
+    virtual G4bool DoesFieldChangeEnergy() const { return fField->DoesFieldChangeEnergy(); }
+    
+    void SetDistance(G4double distance) { fDistance2 = distance * distance; }
+    
+  private:
+    const G4Field* fField;
+    G4double fDistance2;
+    
+    mutable G4bool fValid;
+    mutable G4double fLastPoint[3];
+    mutable G4double fLastValue[6];
+    
+    FieldStatistics* fStatistics;   // Of the thread that owns the field
+};
+
+#endif
@@ -0,0 +1,85 @@
+// ==============================
+// include/CoilSolenoidField.hh
+// ==============================
+
+#ifndef CoilSolenoidField_h
+#define CoilSolenoidField_h 1
+
+#include "globals.hh"
+#include "AxisymmetricField.hh"
+#include "FieldStorage.hh"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Solenoid field of a set of coaxial coils, each a winding of rectangular
+// cross-section carrying a total current (ampere-turns) spread evenly over
+// it.
+//
+// The field of a current loop involves complete elliptic integrals; summed
+// over the turns of a coil, the integral along z has a closed form in the
+// same kind of integral (Derby & Olbert, Am. J. Phys. 78 (2010) 229), so
+// each coil is a few current sheets across its thickness, placed at
+// Gauss-Legendre nodes, each evaluated exactly over its length. That is
+// still far too slow per tracking step; the field is meant to be sampled
+// once onto a map, which MakeMap does on all cores and caches on disk.
+class CoilSolenoidField : public AxisymmetricField
+{
+  public:
+    struct Coil
+    {
+      G4double innerRadius;
+      G4double outerRadius;
+      G4double zCenter;
+      G4double length;
+      G4double current;   // Ampere-turns of the whole winding
+    };
+    
+    // Field sampled for r < maxRadius and zMin < z < zMax; the coils may
+    // lie outside that extent
+    CoilSolenoidField(G4double maxRadius, G4double zMin, G4double zMax);
+    
+    void AddCoil(const Coil& coil);
+    const std::vector<Coil>& GetCoils() const { return fCoils; }
+    
+    virtual void GetFieldRZ(G4double r, G4double z, G4double fieldRZ[4]) const;
+    virtual G4double GetMaxRadius() const { return fMaxRadius; }
+    virtual G4double GetZMin() const { return fZMin; }
+    virtual G4double GetZMax() const { return fZMax; }
+    
+    // Hash of the coils and the extent, identifying the field in a cache
+    std::uint64_t GetParameterKey() const;
+    
+    // Map of the field on nR x nZ points, read from the cache file
+    // <cacheDirectory>/coils_<key>.bfm when one matches the coils and grid;
+    // otherwise sampled on nThreads threads and written to that file.
+    // Instantiated for the policies of FieldStorage.hh.
+    template <class Storage>
+    std::shared_ptr<const FieldMap2DT<Storage>> MakeMap(G4int nR, G4int nZ, G4double tolerance,
+                                                       G4int nThreads,
+                                                       const G4String& cacheDirectory) const;
+    
+    // List the coils and the field at the centre of the extent
+    void Print() const;
+  
+  private:
+    // Thin solenoid of radius a, half-length b, centred at z0; scale is
+    // mu0 n I / pi for its current per unit length n I
+    struct Sheet
+    {
+      G4double radius;
+      G4double halfLength;
+      G4double zCenter;
+      G4double scale;
+    };
+    
+    void AddSheetField(const Sheet& sheet, G4double r, G4double z, G4double& br, G4double& bz) const;
+    
+    G4double fMaxRadius;
+    G4double fZMin;
+    G4double fZMax;
+    std::vector<Coil> fCoils;
+    std::vector<Sheet> fSheets;
+};
+
+#endif
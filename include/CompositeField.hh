@@ -0,0 +1,27 @@
+// ===========================
+// include/CompositeField.hh
+// ===========================
+
+#ifndef CompositeField_h
+#define CompositeField_h 1
+
+#include "G4ElectroMagneticField.hh"
+
+// Sum of two fields, for volumes where a local field is superimposed on
+// the field of the volume around it (the RF cavity inside the solenoid)
+class CompositeField : public G4ElectroMagneticField
+{
+  public:
+    CompositeField(const G4Field* first, const G4Field* second);
+    virtual ~CompositeField();
+    
+    virtual void GetFieldValue(const G4double point[4], G4double* field) const;
+    
+    virtual G4bool DoesFieldChangeEnergy() const;
+    
+  private:
+    const G4Field* fFirst;
+    const G4Field* fSecond;
+};
+
+#endif
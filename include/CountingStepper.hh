@@ -0,0 +1,61 @@
+// ==========================
+// include/CountingStepper.hh
+// ==========================
+
+#ifndef CountingStepper_h
+#define CountingStepper_h 1
+
+#include "FieldStatistics.hh"
+#include <algorithm>
+#include <utility>
+
+// Stepper T that books each of its substeps in FieldStatistics.
+//
+// The drivers do not report rejected steps, but they show in the calls: a
+// substep rejected on its error estimate, or by the chord search, is taken
+// again from the same start with a smaller step, and G4MagInt_Driver also
+// re-integrates the chord it accepted. A call from the same start as the
+// previous one is counted as retried. The comparison is six doubles, so
+// the wrapper costs nothing next to the field calls of the substep.
+template <class T>
+class CountingStepper : public T
+{
+  public:
+    template <class... Args>
+    explicit CountingStepper(Args&&... args)
+    : T(std::forward<Args>(args)...),
+      fStatistics(FieldStatistics::Instance()),
+      fHaveStart(false)
+    {
+    }
+    
+    virtual void Stepper(const G4double y[], const G4double dydx[], G4double h,
+                         G4double yOut[], G4double yErr[])
+    {
+      Count(y);
+      T::Stepper(y, dydx, h, yOut, yErr);
+    }
+    
+    // FSAL form, called directly by G4InterpolationDriver
+    void Stepper(const G4double y[], const G4double dydx[], G4double h,
+                 G4double yOut[], G4double yErr[], G4double dydxOut[])
+    {
+      Count(y);
+      T::Stepper(y, dydx, h, yOut, yErr, dydxOut);
+    }
+  
+  private:
+    void Count(const G4double y[])
+    {
+      G4bool retried = fHaveStart && std::equal(y, y + 6, fStart);
+      std::copy(y, y + 6, fStart);
+      fHaveStart = true;
+      fStatistics->CountSubstep(retried);
+    }
+    
+    FieldStatistics* fStatistics;
+    G4bool fHaveStart;
+    G4double fStart[6];     // Position and momentum of the last substep's start
+};
+
+#endif
@@ -10,13 +10,21 @@
 #include "globals.hh"
 #include "G4LogicalVolume.hh"
 #include "G4VPhysicalVolume.hh"
+#include "CoilSolenoidField.hh"
+#include "FieldMapImport.hh"
+#include "FieldStorage.hh"
+#include "RFCavityField.hh"
+#include <memory>
+#include <mutex>
 
 class G4VPhysicalVolume;
 class G4LogicalVolume;
 class G4Material;
 class G4FieldManager;
+class G4GenericMessenger;
 class MagneticField;
-class RFCavityField;  // Added for RF cavity field
+class FieldIntegration;
+class BeamlineLattice;
 
 class DetectorConstruction : public G4VUserDetectorConstruction
 {
@@ -35,19 +43,96 @@ class DetectorConstruction : public G4VUserDetectorConstruction
   private:
     void DefineMaterials();
     G4VPhysicalVolume* DefineVolumes();
+    void DefineCommands();
+    
+    // Shared read-only maps, built on first use: imported from the map
+    // files when set, then the solenoid from the coils when there are any,
+    // otherwise sampled from the analytic fields
+    std::shared_ptr<const SolenoidFieldMap> GetSolenoidMap();
+    std::shared_ptr<const RFFieldMap> GetRFMap();
+    RFCavityField::Model GetRFModel() const;
+    CoilSolenoidField GetCoilField() const;
+    void ReportFieldMaps();
+    
+    // Imported maps replace the analytic fields
+    void SetSolenoidMapFile(const G4String& fileName);
+    void SetRFMapFile(const G4String& fileName);
+    void SetMapUnits(const G4String& units);
+    
+    // Coil windings generating the solenoid map
+    void AddCoil(const G4String& parameters);
+    void ClearCoils();
+    
+    // Time the RF field evaluation variants and check them against the analytic form
+    void BenchmarkRFField(G4int nPoints);
+    
+    // Time the batched field evaluation against the scalar loop
+    void BenchmarkBatchedField(G4int nPoints);
+    
+    // Compare memory, lookup time and error of the map storage policies
+    void BenchmarkMapStorage(G4int nPoints);
+    
+    // Compare memory, lookup time and error of uniform and adaptive map grids
+    void BenchmarkAdaptiveGrid(G4int nPoints);
+    
+    // Track reference muons with every stepper and compare cost and accuracy
+    void CompareSteppers(G4int nMuons);
     
     G4LogicalVolume* fWorldLV;
     G4LogicalVolume* fCylinderLV;
+    G4LogicalVolume* fSolenoidLV;   // Envelope of the solenoid field
     G4LogicalVolume* fTungstenBlockLV;
     G4LogicalVolume* fDetector1LV;
     G4LogicalVolume* fDetector2LV;
     G4LogicalVolume* fDetector3LV;
     G4LogicalVolume* fHeliumCloudLV;
     G4LogicalVolume* fRFCavityLV;
+    G4LogicalVolume* fRFGapLV;    // Beam aperture of the RF cavity
     
-    MagneticField* fMagneticField;
-    RFCavityField* fRFField;  // Added field for RF cavity
+    // Fields are built per thread in ConstructSDandField
+    static G4ThreadLocal MagneticField* fMagneticField;
+    static G4ThreadLocal RFCavityField* fRFField;  // Added field for RF cavity
     G4FieldManager* fFieldMgr;
+    
+    G4String fRFMode;   // "field", "kick" or "off"
+    G4String fRFModel;  // "gaussian" or "pillbox"
+    G4bool fRFTable;        // Spatial RF profile from the (r^2,z) table
+    G4bool fRFPhaseCache;   // Time factor by recurrence from the last call
+    
+    // Solenoid field on the envelope only, or on the whole world
+    G4bool fUseEnvelope;
+    
+    // Stepper and accuracy settings of the two field managers
+    FieldIntegration* fSolenoidIntegration;
+    FieldIntegration* fRFIntegration;
+    
+    // Reuse the solenoid field within this distance of the last query (0 = off)
+    G4double fCacheDistance;
+    
+    // Field maps shared by the fields of all threads
+    G4bool fUseFieldMaps;
+    G4int fMapPointsR;    // Solenoid map points along r^2
+    G4int fMapPointsZ;    // Solenoid map points along z
+    G4double fMapTolerance;  // Adaptive z grid tolerance of sampled maps, 0 = uniform
+    std::shared_ptr<const SolenoidFieldMap> fSolenoidMap;
+    std::shared_ptr<const RFFieldMap> fRFMap;
+    std::mutex fFieldMapMutex;
+    
+    // ASCII field maps to import, empty for the analytic fields
+    G4String fSolenoidMapFile;
+    G4String fRFMapFile;
+    FieldMapImport::Units fMapUnits;
+    
+    // Coils of the solenoid, empty for the analytic model, and the
+    // directory of their cached maps
+    std::vector<CoilSolenoidField::Coil> fCoils;
+    G4String fCoilCacheDirectory;
+    
+    // Lattice of field elements replacing both fields when enabled
+    BeamlineLattice* fLattice;
+    
+    G4GenericMessenger* fMessenger;
+    G4GenericMessenger* fFieldMessenger;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+// ==========================
+// include/DetectorHit.hh
+// ==========================
+
+#ifndef DetectorHit_h
+#define DetectorHit_h 1
+
+#include "G4VHit.hh"
+#include "G4THitsCollection.hh"
+#include "G4Allocator.hh"
+#include "G4ThreeVector.hh"
+#include "VolumeRoleTable.hh"
+
+// One hit per track and detector plane: the phase-space point where the
+// track entered the plane plus the energy it deposited while inside.
+class DetectorHit : public G4VHit
+{
+  public:
+    DetectorHit();
+    virtual ~DetectorHit();
+    
+    inline void* operator new(size_t);
+    inline void operator delete(void* hit);
+    
+    void SetTrackID(G4int trackID) { fTrackID = trackID; }
+    void SetSpecies(Species species) { fSpecies = species; }
+    void SetKineticEnergy(G4double energy) { fKineticEnergy = energy; }
+    void SetPosition(const G4ThreeVector& position) { fPosition = position; }
+    void SetMomentum(const G4ThreeVector& momentum) { fMomentum = momentum; }
+    void AddEdep(G4double edep) { fEdep += edep; }
+    
+    G4int GetTrackID() const { return fTrackID; }
+    Species GetSpecies() const { return fSpecies; }
+    G4double GetKineticEnergy() const { return fKineticEnergy; }
+    const G4ThreeVector& GetPosition() const { return fPosition; }
+    const G4ThreeVector& GetMomentum() const { return fMomentum; }
+    G4double GetEdep() const { return fEdep; }
+    
+  private:
+    G4int fTrackID;
+    Species fSpecies;
+    G4double fKineticEnergy;   // Kinetic energy on entry
+    G4ThreeVector fPosition;   // Position on entry
+    G4ThreeVector fMomentum;   // Momentum on entry
+    G4double fEdep;            // Energy deposited in the plane
+};
+
+typedef G4THitsCollection<DetectorHit> DetectorHitsCollection;
+
+extern G4ThreadLocal G4Allocator<DetectorHit>* DetectorHitAllocator;
+
+inline void* DetectorHit::operator new(size_t)
+{
+  if (!DetectorHitAllocator) {
+    DetectorHitAllocator = new G4Allocator<DetectorHit>;
+  }
+  return (void*)DetectorHitAllocator->MallocSingle();
+}
+
+inline void DetectorHit::operator delete(void* hit)
+{
+  DetectorHitAllocator->FreeSingle((DetectorHit*)hit);
+}
+
+#endif
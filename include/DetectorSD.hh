@@ -0,0 +1,40 @@
+// ==========================
+// include/DetectorSD.hh
+// ==========================
+
+#ifndef DetectorSD_h
+#define DetectorSD_h 1
+
+#include "G4VSensitiveDetector.hh"
+#include "DetectorHit.hh"
+#include <unordered_map>
+
+class G4Step;
+class G4HCofThisEvent;
+class G4TouchableHistory;
+class StepTrace;
+
+// Sensitive detector for one silicon plane. Steps of the same track are
+// merged into a single hit per event.
+class DetectorSD : public G4VSensitiveDetector
+{
+  public:
+    DetectorSD(const G4String& name, G4int detectorIndex);
+    virtual ~DetectorSD();
+    
+    virtual void Initialize(G4HCofThisEvent* hce);
+    virtual G4bool ProcessHits(G4Step* step, G4TouchableHistory* history);
+    
+    G4int GetDetectorIndex() const { return fDetectorIndex; }
+    
+  private:
+    G4int fDetectorIndex;
+    StepTrace* fStepTrace;    // Of the thread that built the detector
+    G4int fHitsCollectionID;
+    DetectorHitsCollection* fHitsCollection;
+    
+    // Hit of each track seen in the current event
+    std::unordered_map<G4int, DetectorHit*> fTrackHits;
+};
+
+#endif
@@ -7,45 +7,29 @@
 
 #include "G4UserEventAction.hh"
 #include "globals.hh"
-#include <map>
-#include <vector>
+#include "VolumeRoleTable.hh"
 
 
 
 class G4Event;
+class RunAction;
+class EventOutput;
 
 class EventAction : public G4UserEventAction
 {
   public:
-    EventAction();
+    EventAction(RunAction* runAction);
     virtual ~EventAction();
     
     virtual void BeginOfEventAction(const G4Event*);
     virtual void EndOfEventAction(const G4Event*);
     
-    // Methods to store 6D vector data for later output
-    void Add6DVector(const G4String& detectorName, 
-                    G4double x, G4double px, G4double y, G4double py, G4double z, G4double pz);
-    
-    // Method to store particle data
-    void AddParticleData(const G4String& detectorName,
-                        const G4String& particleName, G4double energy);
-    
   private:
-    // Structure to hold 6D vector data (x, px, y, py, z, pz)
-    struct Vector6D {
-      G4double x, px, y, py, z, pz;
-    };
-    
-    // Structure for particle data
-    struct ParticleData {
-      G4String name;
-      G4double energy;
-    };
+    RunAction* fRunAction;
+    EventOutput* fOutput;
     
-    // Maps to store data by detector
-    std::map<G4String, std::vector<Vector6D>> fVector6DMap;
-    std::map<G4String, std::vector<ParticleData>> fParticleDataMap;
+    // Hits collection IDs of the detector planes, looked up on first use
+    G4int fHitsCollectionIDs[kNumDetectors];
 };
 
 #endif
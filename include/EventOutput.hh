@@ -0,0 +1,116 @@
+// ==========================
+// include/EventOutput.hh
+// ==========================
+
+#ifndef EventOutput_h
+#define EventOutput_h 1
+
+#include "globals.hh"
+#include "BufferedFile.hh"
+#include "PhaseSpaceWriter.hh"
+#include "NtupleOutput.hh"
+#include "DetectorHit.hh"
+#include "VolumeRoleTable.hh"
+#include <cstdint>
+#include <vector>
+
+class AsyncChannel;
+class G4GenericMessenger;
+
+// Hit as queued for writing
+struct OutputHit
+{
+  G4int detector;
+  Species species;
+  G4double values[6];     // x, px, y, py, z, pz in cm and GeV/c
+  G4double energy;        // Kinetic energy in GeV
+};
+
+// Hits of one event
+struct OutputEvent
+{
+  G4int eventID;
+  std::vector<OutputHit> hits;
+};
+
+// Per-thread writer of the trajectory and particle CSV files.
+//
+// Each thread that processes events writes its rows into shard files of
+// its own, opened on the first event of a run and written through large
+// buffers. At end of run the workers close their shards and the master
+// either concatenates them into trajectory_data.csv and particle_data.csv,
+// writing each header once, or leaves them in place and writes a manifest
+// listing them. Rows are grouped by thread, not ordered by event.
+//
+// In the columnar format the trajectory rows, with their species, go to
+// phase-space files instead (see PhaseSpaceFormat.hh), merged per run into
+// trajectory_data_run<N>.bps; the particle file stays CSV. In the ntuple
+// format both go to G4AnalysisManager ntuples instead of shards (see
+// NtupleOutput), and the CSV shards are only a fallback when the ntuple
+// file cannot be opened.
+//
+// With /beamTest/output/async, a worker copies the hits of each event into
+// a queue (see AsyncWriter) and the rows are formatted and written on the
+// writer thread; the ntuples are always filled on the worker, as the
+// analysis manager belongs to it.
+//
+// With /beamTest/output/compression, the CSV shards are written as gzip,
+// each through a deflate stream of its own thread (or of the writer thread
+// in async mode), and merged into trajectory_data.csv.gz and
+// particle_data.csv.gz; the report gives the ratio and the time in deflate.
+// The columnar files stay plain, as their reader maps them in place.
+class EventOutput
+{
+  public:
+    // Instance owned by the calling thread
+    static EventOutput* Instance();
+    
+    // Open the ntuple file of the run when they are in use
+    void BeginOfRun(G4int runID);
+    
+    // Write the hits of one event, one collection per detector plane
+    void WriteEvent(G4int eventID, const DetectorHitsCollection* const hits[kNumDetectors]);
+    
+    // Format and write the rows of an event; called on the writer thread
+    // in async mode
+    void WriteRecords(const OutputEvent& event);
+    
+    // Close this thread's shards of the run and hand them to the master
+    void EndOfRun();
+    
+    // Merge the shards of all threads, or write their manifests (master)
+    void MergeShards(G4int runID);
+  
+  private:
+    EventOutput();
+    ~EventOutput();
+    
+    enum Stream { kTrajectory, kParticle, kNumStreams };
+    
+    void OpenShards();
+    
+    BufferedFile fShards[kNumStreams];
+    PhaseSpaceWriter fPhaseSpace;       // Trajectory shard in the columnar format
+    NtupleOutput fNtuples;
+    OutputEvent fEvent;                 // Event being written, when not async
+    AsyncChannel* fChannel;             // To the writer thread, once async
+    std::uint64_t fRows[kNumStreams];
+    G4int fRunID;
+    G4bool fShardsOpened;     // Opened, or tried to, in this run
+    
+    G4int fBufferSize;        // Per shard, in kB
+    G4bool fMerge;            // Merge the shards, or write a manifest
+    G4String fFormat;         // "csv" or "columnar"
+    G4int fRowGroupSize;
+    G4bool fDoublePrecision;  // Columnar values as double rather than float
+    G4String fNtupleType;     // Analysis manager file type
+    G4String fNtupleFile;
+    G4bool fAsync;            // Write on the writer thread
+    G4int fQueueDepth;        // Events per worker queue
+    G4int fQueueMemory;       // Per worker queue, in MB
+    G4int fCompression;       // gzip level of the CSV files, 0 for plain
+    G4int fFlushInterval;     // Between syncs of the gzip streams, in MB
+    G4GenericMessenger* fMessenger;
+};
+
+#endif
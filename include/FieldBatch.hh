@@ -0,0 +1,33 @@
+// ========================
+// include/FieldBatch.hh
+// ========================
+
+#ifndef FieldBatch_h
+#define FieldBatch_h 1
+
+#include "globals.hh"
+
+// Batch of points for the batched field evaluation, in structure-of-arrays
+// layout so that each coordinate is contiguous and loops over the batch
+// vectorise: point i is (x[i], y[i], z[i], t[i]). Output arrays must not
+// overlap each other or the inputs.
+struct FieldPoints
+{
+  const G4double* x;
+  const G4double* y;
+  const G4double* z;
+  const G4double* t;
+};
+
+// Field values of a batch, one array per component, same layout
+struct FieldValues
+{
+  G4double* bx;
+  G4double* by;
+  G4double* bz;
+  G4double* ex;
+  G4double* ey;
+  G4double* ez;
+};
+
+#endif
@@ -0,0 +1,54 @@
+// ===========================
+// include/FieldBenchmark.hh
+// ===========================
+
+#ifndef FieldBenchmark_h
+#define FieldBenchmark_h 1
+
+#include "globals.hh"
+#include "FieldStorage.hh"
+#include "RFCavityField.hh"
+#include <memory>
+
+
+// Microbenchmarks of the field evaluation paths, run on demand from the
+// UI. Each one times the variants on the same points and checks them
+// against the analytic evaluation.
+namespace FieldBenchmark
+{
+  // RF cavity: analytic vs table spatial profile, exact vs recurrence time
+  // factor, on points along straight tracks through the cavity; the table
+  // must have been sampled from the given model
+  void RunRFCavity(std::shared_ptr<const RFFieldMap> table, RFCavityField::Model model,
+                   G4int nPoints);
+  
+  // RF cavity models: the Gaussian profile, and the pillbox with J0 and J1
+  // from the table and from their series, on the same track points; the
+  // deviation of the table from the series, in E and B
+  void RunRFModels(G4int nPoints);
+  
+  // Solenoid and RF cavity, analytic and map, and the pillbox cavity:
+  // scalar GetFieldValue loop vs the batched structure-of-arrays
+  // GetFieldValues, on points scattered over and around the field volumes
+  void RunBatched(std::shared_ptr<const SolenoidFieldMap> solenoidMap,
+                  std::shared_ptr<const RFFieldMap> rfMap, G4int nPoints);
+  
+  // Solenoid and RF cavity maps of the given grids in every storage policy:
+  // memory, scalar and batched lookup time on points scattered over the
+  // whole map, and the largest interpolation error against the analytic field
+  void RunStorage(G4int solenoidPointsR, G4int solenoidPointsZ,
+                  G4int rfPointsR, G4int rfPointsZ, G4int nPoints);
+  
+  // Solenoid and RF cavity maps on the uniform z grids given, on adaptive
+  // grids built from them at the tolerance, and on uniform grids with as
+  // many z points as the adaptive ones: grid size, memory, lookup time and
+  // largest interpolation error
+  void RunAdaptiveGrid(G4int solenoidPointsR, G4int solenoidPointsZ,
+                       G4int rfPointsR, G4int rfPointsZ, G4double tolerance, G4int nPoints);
+  
+  // BeamlineField lookups in periodic lattices of 1 to 1000 cells, to show
+  // the cost per query does not grow with the lattice
+  void RunBeamline(G4int nPoints);
+}
+
+#endif
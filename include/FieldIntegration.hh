@@ -0,0 +1,113 @@
+// =============================
+// include/FieldIntegration.hh
+// =============================
+
+#ifndef FieldIntegration_h
+#define FieldIntegration_h 1
+
+#include "globals.hh"
+#include "VolumeRoleTable.hh"
+#include <vector>
+
+class G4ElectroMagneticField;
+class G4EquationOfMotion;
+class G4ChordFinder;
+class G4FieldManager;
+class G4GenericMessenger;
+
+// Integration settings of one field manager: stepper, driver and accuracy
+// parameters, set from /beamTest/field/<name>/. One instance is shared by
+// all threads; each thread builds its own chord finder from it.
+//
+// Steppers:
+//   ClassicalRK4       G4ClassicalRK4 with G4MagInt_Driver (former default)
+//   DormandPrince745   G4DormandPrince745 with G4InterpolationDriver
+//   BogackiShampine45  G4BogackiShampine45 with G4MagInt_Driver
+//   ExactHelix         G4ExactHelixStepper, exact only where B is uniform;
+//                      pure magnetic fields only
+//
+// With per-track accuracy enabled, the field managers made by
+// CreateFieldManager take deltaOneStep and the epsilon bounds of each
+// track from a table of momentum bands per species, and the settings
+// above for tracks outside every band.
+class FieldIntegration
+{
+  public:
+    // Accuracy of the tracks of a species with momentum up to maxMomentum
+    struct TrackAccuracy
+    {
+      G4double maxMomentum;
+      G4double deltaOneStep;
+      G4double epsilonMin;
+      G4double epsilonMax;
+    };
+    
+    FieldIntegration(const G4String& name);
+    ~FieldIntegration();
+    
+    // Build equation, stepper, driver and chord finder for the field with
+    // the named stepper; pure magnetic fields use the 6-variable equation
+    G4ChordFinder* CreateChordFinder(const G4String& stepperName,
+                                     G4ElectroMagneticField* field,
+                                     G4bool pureMagnetic,
+                                     G4EquationOfMotion** equation = nullptr) const;
+    
+    // Attach the field to the manager with the configured stepper and accuracies
+    void Configure(G4FieldManager* fieldManager,
+                   G4ElectroMagneticField* field,
+                   G4bool pureMagnetic) const;
+    
+    // Field manager applying the per-track accuracy table; still to be
+    // configured with a field
+    G4FieldManager* CreateFieldManager() const;
+    
+    // Set deltaOneStep and the epsilon bounds of the manager, the table
+    // band when given, otherwise the settings of this integration
+    void ApplyAccuracy(G4FieldManager* fieldManager, const TrackAccuracy* accuracy) const;
+    
+    // Bands of the species in increasing momentum; the first one holding
+    // a track's momentum applies
+    G4bool IsPerTrackAccuracy() const { return fPerTrackAccuracy; }
+    const std::vector<TrackAccuracy>& GetTrackAccuracies(Species species) const {
+      return fTrackAccuracies[species];
+    }
+    
+    // Changes with every edit of the table, so managers can drop the band
+    // they applied last
+    G4int GetTableVersion() const { return fTableVersion; }
+    
+    void AddTrackAccuracy(Species species, const TrackAccuracy& accuracy);
+    void ClearTrackAccuracies();
+    void PrintTrackAccuracies() const;
+    
+    // Relative accuracy the field manager uses for a step of this length
+    G4double GetEpsilon(G4double stepLength) const;
+    
+    const G4String& GetName() const { return fName; }
+    const G4String& GetStepperName() const { return fStepperName; }
+    G4double GetDeltaChord() const { return fDeltaChord; }
+    
+    // Stepper names accepted by CreateChordFinder
+    static const char* const kStepperNames[];
+    static const G4int kNumSteppers;
+    
+  private:
+    void TrackAccuracyCommand(const G4String& value);
+    
+    G4String fName;
+    G4String fStepperName;
+    G4double fMinStep;            // Smallest step the driver attempts
+    G4double fDeltaChord;         // Miss distance of the chord
+    G4double fDeltaOneStep;       // Position accuracy of a physics step
+    G4double fDeltaIntersection;  // Accuracy of boundary intersections
+    G4double fEpsilonMin;         // Bounds of deltaOneStep/stepLength
+    G4double fEpsilonMax;
+    
+    G4bool fPerTrackAccuracy;
+    std::vector<TrackAccuracy> fTrackAccuracies[kNumSpecies];
+    G4int fTableVersion;
+    
+    G4GenericMessenger* fMessenger;
+};
+
+#endif
@@ -0,0 +1,174 @@
+// ==========================
+// include/FieldMap2D.hh
+// ==========================
+
+#ifndef FieldMap2D_h
+#define FieldMap2D_h 1
+
+#include "globals.hh"
+#include "FieldBatch.hh"
+#include "FieldStorage.hh"
+#include "GridAxis.hh"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class AxisymmetricField;
+class MappedFile;
+
+// Axisymmetric field sampled on a grid in (r^2, z), regular in r^2 and
+// evenly spaced within segments in z (see GridAxis).
+//
+// The grid is filled once from an AxisymmetricField and is read-only
+// afterwards, so one map can be shared by the fields of all threads.
+// Interpolation is bilinear in r^2 and z: solenoid and cavity fields are
+// even in r, which makes them close to linear in r^2, and no sqrt is needed
+// per lookup. Radial components are stored divided by r, so Bx = (Br/r)*x.
+//
+// The nodes are encoded by the Storage policy (see FieldStorage.hh);
+// FieldMap2D is the double precision map.
+//
+// A map can be written to a binary cache file and later served straight
+// from a read-only mapping of that file, with the same interpolation.
+template <class Storage>
+class FieldMap2DT
+{
+  public:
+    // nR and nZ are the number of grid points along r^2 and z. With a
+    // tolerance, z points are dropped where the field is close to linear:
+    // each panel of 64 z intervals keeps every 2nd, 4th, ... up to 64th
+    // point, the coarsest choice that reproduces all nZ samples to within
+    // tolerance of each component's peak. The grid rows are sampled on
+    // nThreads threads, so the source's GetFieldRZ must be thread-safe.
+    FieldMap2DT(const AxisymmetricField& source, G4int nR, G4int nZ, G4double tolerance = 0.,
+                G4int nThreads = 1);
+    ~FieldMap2DT();
+    
+    // Write the grid to a binary cache, tagged with a key identifying its
+    // source; written to a temporary file unique to the call and renamed,
+    // so concurrent jobs never see a partial cache
+    G4bool WriteCache(const G4String& fileName, std::uint64_t sourceKey) const;
+    
+    // Map read from a cache file; null if the file is missing, of another
+    // format version or storage, or written for another source key
+    static std::shared_ptr<const FieldMap2DT> ReadCache(const G4String& fileName,
+                                                        std::uint64_t sourceKey);
+    
+    // Interpolated Br/r, Bz, Er/r, Ez at (r^2, z); false and zeros outside the grid
+    inline G4bool Interpolate(G4double r2, G4double z, G4double values[4]) const;
+    
+    // All six components at a point, in the G4ElectroMagneticField layout
+    inline void GetFieldValue(const G4double point[4], G4double field[6]) const;
+    
+    // Same for n points at once; branch-free, points off the grid get zeros
+    void GetFieldValues(G4int n, const FieldPoints& points, const FieldValues& values) const;
+    
+    G4int GetNPointsR() const { return fNR; }
+    G4int GetNPointsZ() const { return fNZ; }
+    const GridAxis& GetAxisZ() const { return fAxisZ; }
+    
+    // Bytes held by the grid and its block scales, and whether they are
+    // mapped from a cache file
+    std::size_t GetMemoryUsage() const;
+    G4bool IsMapped() const { return fMapping != nullptr; }
+    
+    // Largest magnitude of Br, Bz, Er and Ez over the grid nodes
+    void GetPeakValues(G4double peak[4]) const;
+    
+    // Largest and rms deviation of Br, Bz, Er and Ez from the source,
+    // evaluated at the cell centres where bilinear interpolation is worst
+    void GetInterpolationError(const AxisymmetricField& source,
+                               G4double maxError[4], G4double rmsError[4]) const;
+    
+    // Print the grid size, memory use and the interpolation error against
+    // the source; the error is left out without a source
+    void Report(const AxisymmetricField* source, const G4String& name) const;
+    
+  private:
+    typedef typename Storage::Node Node;
+    
+    FieldMap2DT(std::unique_ptr<MappedFile> mapping, std::size_t dataOffset,
+                std::size_t scaleOffset, std::size_t nScales, G4int nR,
+                G4double r2Max, const GridAxis& axisZ);
+    void SetSpacing();
+    
+    // Kernel of GetFieldValues; the arrays are declared not to overlap so
+    // the compiler vectorises the loop without run-time alias checks
+    void InterpolateBatch(G4int n,
+                          const G4double* __restrict px, const G4double* __restrict py,
+                          const G4double* __restrict pz,
+                          G4double* __restrict bx, G4double* __restrict by, G4double* __restrict bz,
+                          G4double* __restrict ex, G4double* __restrict ey, G4double* __restrict ez) const;
+    
+    // Grid nodes, z-major: index = iz*fNR + ir, and the block scales of
+    // the policies that have them. They live in fNodes and fScales, or in
+    // the cache file mapping when read from one.
+    const Node* fData;
+    const BlockScale* fScaleData;
+    std::size_t fNScales;
+    std::vector<Node> fNodes;
+    std::vector<BlockScale> fScales;
+    std::unique_ptr<MappedFile> fMapping;
+    G4int fNR;
+    G4int fNZ;
+    G4double fR2Max;
+    G4double fZMin;
+    G4double fZMax;
+    GridAxis fAxisZ;
+    G4double fDR2;
+    G4double fInvDR2;
+};
+
+template <class Storage>
+inline G4bool FieldMap2DT<Storage>::Interpolate(G4double r2, G4double z, G4double values[4]) const
+{
+  if (r2 >= fR2Max || z < fZMin || z >= fZMax) {
+    values[0] = values[1] = values[2] = values[3] = 0.;
+    return false;
+  }
+  
+  // r^2 just below the edge can round onto the last node; it stays in the
+  // last cell, at t = 1
+  G4double fr = r2 * fInvDR2;
+  G4int ir = std::min(static_cast<G4int>(fr), fNR - 2);
+  G4double tr = fr - ir;
+  G4int iz;
+  G4double tz;
+  fAxisZ.Locate(z, iz, tz);
+  
+  std::size_t index = static_cast<std::size_t>(iz)*fNR + ir;
+  G4double v00[4], v01[4], v10[4], v11[4];
+  Storage::Load(fData, fScaleData, index, v00);
+  Storage::Load(fData, fScaleData, index + 1, v01);
+  Storage::Load(fData, fScaleData, index + fNR, v10);
+  Storage::Load(fData, fScaleData, index + fNR + 1, v11);
+  
+  G4double w00 = (1. - tr) * (1. - tz);
+  G4double w01 = tr * (1. - tz);
+  G4double w10 = (1. - tr) * tz;
+  G4double w11 = tr * tz;
+  
+  for (G4int c = 0; c < 4; ++c) {
+    values[c] = w00*v00[c] + w01*v01[c] + w10*v10[c] + w11*v11[c];
+  }
+  return true;
+}
+
+template <class Storage>
+inline void FieldMap2DT<Storage>::GetFieldValue(const G4double point[4], G4double field[6]) const
+{
+  G4double x = point[0];
+  G4double y = point[1];
+  G4double values[4];
+  Interpolate(x*x + y*y, point[2], values);
+  
+  field[0] = values[0] * x;
+  field[1] = values[0] * y;
+  field[2] = values[1];
+  field[3] = values[2] * x;
+  field[4] = values[2] * y;
+  field[5] = values[3];
+}
+
+#endif
@@ -0,0 +1,44 @@
+// ===========================
+// include/FieldMapImport.hh
+// ===========================
+
+#ifndef FieldMapImport_h
+#define FieldMapImport_h 1
+
+#include "globals.hh"
+#include "FieldStorage.hh"
+#include <memory>
+
+
+// Field maps from ASCII (r,z) grids, as exported by Superfish, Poisson or
+// OPERA-2D, with a binary cache next to the text file.
+//
+// The text file holds one grid point per line. Columns are taken from a
+// header when there is one: an OPERA table header (dimensions, then
+// "<index> <name> [unit]" lines closed by "0"), or a line of column names
+// right before the data such as "R(cm) Z(cm) Br Bz". Names are matched on
+// R/X, Z/Y, BR/BX, BZ/BY, ER/EX, EZ/EY. Without a header the columns are
+// r z Br Bz [Er Ez]. Lines starting with # ! % or * are comments. The
+// points must form a regular grid in r and z starting on the axis.
+//
+// Parsing happens once: the grid is resampled onto a map with as
+// many points along r^2 and z as the file has along r and z, and written
+// to <file>.bfm. Later loads map that cache read-only, as long as the text
+// file's size and modification time and the units are unchanged.
+namespace FieldMapImport
+{
+  // Units of the numbers in the file
+  struct Units
+  {
+    G4double length;
+    G4double magnetic;
+    G4double electric;
+  };
+  
+  // Map of the file in the given storage, from the cache when it is up to
+  // date; null on error. Instantiated for the policies of FieldStorage.hh.
+  template <class Storage>
+  std::shared_ptr<const FieldMap2DT<Storage>> Load(const G4String& fileName, const Units& units);
+}
+
+#endif
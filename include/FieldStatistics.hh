@@ -0,0 +1,99 @@
+// ============================
+// include/FieldStatistics.hh
+// ============================
+
+#ifndef FieldStatistics_h
+#define FieldStatistics_h 1
+
+#include "globals.hh"
+#include "VolumeRoleTable.hh"
+#include <vector>
+
+class G4LogicalVolume;
+
+// Per-thread counters of field transport work. Each thread counts into its
+// own instance without locking; at end of run every thread merges its
+// counters into a run total, which the master prints and writes as JSON.
+//
+// The work is also broken down by particle species and logical volume.
+// The field managers call EnterFieldStep before each step in a field, and
+// the field calls and substeps counted until the next such call go to
+// that step's species and volume. Attribution happens only at those
+// calls, so the counting hot paths stay single increments.
+class FieldStatistics
+{
+  public:
+    // Instance owned by the calling thread
+    static FieldStatistics* Instance();
+    
+    void CountFieldCall() { ++fFieldCalls; }
+    void CountFieldCalls(G4long n) { fFieldCalls += n; }
+    void CountCacheHit() { ++fCacheHits; }
+    void CountCacheMiss() { ++fCacheMisses; }
+    void CountChargedStep(G4bool inField) {
+      ++fChargedSteps;
+      if (inField) ++fFieldSteps;
+    }
+    
+    // An integration substep; retried when it starts where the previous
+    // one did, i.e. repeats a substep the driver rejected
+    void CountSubstep(G4bool retried) {
+      ++fSubsteps;
+      if (retried) ++fRetriedSubsteps;
+    }
+    
+    // Start of a step in a field; the work counted from here on belongs to it
+    void EnterFieldStep(Species species, const G4LogicalVolume* volume);
+    
+    // Track killed by transportation as a looper
+    void CountLooperKill(Species species, const G4LogicalVolume* volume);
+    
+    G4long GetFieldCalls() const { return fFieldCalls; }
+    
+    void Reset();
+    
+    // Add this thread's counters to the run total
+    void Merge();
+    
+    // Write the run total as JSON
+    static void WriteTotal(const G4String& fileName, G4int runID, G4int nEvents);
+    
+    // Print the run total, with the change in field evaluations per event
+    // from the previous run, and clear it
+    static void PrintTotal(G4int nEvents);
+    
+    // Work of one species in one volume
+    struct Breakdown
+    {
+      G4long steps;           // Steps in a field
+      G4long fieldCalls;
+      G4long substeps;
+      G4long retriedSubsteps;
+      G4long looperKills;
+    };
+    
+  private:
+    FieldStatistics();
+    
+    // Breakdown of a species and volume, indexed by the volume's instance ID
+    Breakdown& GetBreakdown(Species species, const G4LogicalVolume* volume);
+    
+    // Attribute the work since the last EnterFieldStep to its breakdown
+    void CloseFieldStep();
+    
+    G4long fFieldCalls;     // Field evaluations
+    G4long fChargedSteps;   // Steps of charged tracks
+    G4long fFieldSteps;     // ... of which in a volume with a field
+    G4long fCacheHits;      // CachedField queries answered from the cache
+    G4long fCacheMisses;    // ... and passed on to the field
+    G4long fSubsteps;         // Integration substeps
+    G4long fRetriedSubsteps;  // ... of which repeats of rejected ones
+    
+    std::vector<Breakdown> fBreakdown;   // [volume ID * kNumSpecies + species]
+    G4int fOpenStep;                     // Breakdown index of the step in progress, -1 for none
+    G4long fOpenStepCalls;               // Counters when that step started
+    G4long fOpenStepSubsteps;
+    G4long fOpenStepRetried;
+};
+
+#endif
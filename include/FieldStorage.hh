@@ -0,0 +1,128 @@
+// ==========================
+// include/FieldStorage.hh
+// ==========================
+
+#ifndef FieldStorage_h
+#define FieldStorage_h 1
+
+#include "globals.hh"
+#include <cstdint>
+#include <vector>
+
+// Storage policies of FieldMap2DT, the (r^2,z) field map.
+//
+// Axial symmetry leaves four independent components per grid node, Br/r,
+// Bz, Er/r and Ez, and only those are stored. The policy picks their
+// encoding:
+//
+//   DoubleStorage     4 doubles, 32 bytes per node, exact samples
+//   FloatStorage      4 floats, 16 bytes per node, ~6e-8 relative rounding
+//   QuantizedStorage  4 16-bit integers, 8 bytes per node, plus one float
+//                     scale per component for each block of 16 nodes;
+//                     rounding up to 1.5e-5 of the block's largest value
+//
+// A policy has a Node type, Encode to fill nodes and block scales from
+// double samples (4 per node), and Load to decode one node to doubles.
+
+// Scale of each component over a block of nodes
+struct BlockScale
+{
+  G4float value[4];
+};
+
+struct DoubleStorage
+{
+  static constexpr const char* kName = "double";
+  static constexpr std::uint32_t kTypeId = 1;
+  
+  // Two nodes per 64-byte cache line
+  struct alignas(32) Node
+  {
+    G4double value[4];
+  };
+  
+  static void Encode(const std::vector<G4double>& samples,
+                     std::vector<Node>& nodes, std::vector<BlockScale>& scales);
+  
+  static void Load(const Node* nodes, const BlockScale*, std::size_t index, G4double value[4])
+  {
+    const Node& node = nodes[index];
+    value[0] = node.value[0];
+    value[1] = node.value[1];
+    value[2] = node.value[2];
+    value[3] = node.value[3];
+  }
+};
+
+struct FloatStorage
+{
+  static constexpr const char* kName = "float";
+  static constexpr std::uint32_t kTypeId = 2;
+  
+  struct alignas(16) Node
+  {
+    G4float value[4];
+  };
+  
+  static void Encode(const std::vector<G4double>& samples,
+                     std::vector<Node>& nodes, std::vector<BlockScale>& scales);
+  
+  static void Load(const Node* nodes, const BlockScale*, std::size_t index, G4double value[4])
+  {
+    const Node& node = nodes[index];
+    value[0] = node.value[0];
+    value[1] = node.value[1];
+    value[2] = node.value[2];
+    value[3] = node.value[3];
+  }
+};
+
+struct QuantizedStorage
+{
+  static constexpr const char* kName = "int16";
+  static constexpr std::uint32_t kTypeId = 3;
+  
+  // Nodes per block sharing a scale: 16 consecutive nodes along r^2
+  static constexpr G4int kBlockShift = 4;
+  static constexpr std::int32_t kMaxCode = 32767;
+  
+  struct alignas(8) Node
+  {
+    std::int16_t value[4];
+  };
+  
+  static void Encode(const std::vector<G4double>& samples,
+                     std::vector<Node>& nodes, std::vector<BlockScale>& scales);
+  
+  static void Load(const Node* nodes, const BlockScale* scales, std::size_t index,
+                   G4double value[4])
+  {
+    const Node& node = nodes[index];
+    const BlockScale& scale = scales[index >> kBlockShift];
+    value[0] = node.value[0] * static_cast<G4double>(scale.value[0]);
+    value[1] = node.value[1] * static_cast<G4double>(scale.value[1]);
+    value[2] = node.value[2] * static_cast<G4double>(scale.value[2]);
+    value[3] = node.value[3] * static_cast<G4double>(scale.value[3]);
+  }
+};
+
+template <class Storage> class FieldMap2DT;
+
+typedef FieldMap2DT<DoubleStorage> FieldMap2D;
+
+// Storage of the solenoid and RF cavity maps, chosen at build time with
+// the CMake options BEAMTEST_SOLENOID_MAP_STORAGE and BEAMTEST_RF_MAP_STORAGE;
+// /beamTest/field/benchmarkStorage compares the policies for both fields
+#ifndef BEAMTEST_SOLENOID_MAP_STORAGE
+#define BEAMTEST_SOLENOID_MAP_STORAGE DoubleStorage
+#endif
+#ifndef BEAMTEST_RF_MAP_STORAGE
+#define BEAMTEST_RF_MAP_STORAGE DoubleStorage
+#endif
+
+typedef BEAMTEST_SOLENOID_MAP_STORAGE SolenoidMapStorage;
+typedef BEAMTEST_RF_MAP_STORAGE RFMapStorage;
+typedef FieldMap2DT<SolenoidMapStorage> SolenoidFieldMap;
+typedef FieldMap2DT<RFMapStorage> RFFieldMap;
+
+#endif
@@ -0,0 +1,96 @@
+// ======================
+// include/GridAxis.hh
+// ======================
+
+#ifndef GridAxis_h
+#define GridAxis_h 1
+
+#include "globals.hh"
+#include <algorithm>
+#include <vector>
+
+// Grid points along one axis of a field map, evenly spaced within each of
+// a few segments: fine where the field bends, coarse where it is flat.
+//
+// Locate finds the cell holding a coordinate without a search or branch: a
+// uniform table of bins, each at most half as wide as the shortest segment
+// so that at most one segment starts inside it, holds the spacing of the
+// segment at the bin start and of the next one, and one comparison picks
+// between the two. The table is kept as flat arrays so that a loop over
+// points can gather from it in vector registers. A uniform axis skips the
+// table, keeping the lookup as short as a plain division.
+class GridAxis
+{
+  public:
+    // nPoints evenly spaced points from min to max: a single segment
+    GridAxis(G4double min, G4double max, G4int nPoints);
+    
+    // Points in increasing order; runs of equal spacing become segments
+    explicit GridAxis(const std::vector<G4double>& points);
+    
+    // Cell [index, index+1] holding x, with t = 0..1 the fraction across
+    // it; x must lie in [GetMin(), GetMax()]
+    inline void Locate(G4double x, G4int& index, G4double& t) const;
+    
+    G4int GetNPoints() const { return fPoints.size(); }
+    G4double GetPoint(G4int i) const { return fPoints[i]; }
+    const std::vector<G4double>& GetPoints() const { return fPoints; }
+    G4double GetMin() const { return fPoints.front(); }
+    G4double GetMax() const { return fPoints.back(); }
+    
+    G4int GetNSegments() const { return fSegments.size(); }
+    G4bool IsUniform() const { return fSegments.size() == 1; }
+    G4double GetMinSpacing() const;
+    G4double GetMaxSpacing() const;
+  
+  private:
+    void BuildSegments();
+    
+    struct Segment
+    {
+      G4double start;
+      G4double invSpacing;
+      G4int firstPoint;
+      G4int nIntervals;
+    };
+    
+    std::vector<G4double> fPoints;
+    std::vector<Segment> fSegments;
+    
+    // Per bin b, the start of the segment after the one at the bin start,
+    // +infinity past the last; per bin b and segment s = 0, 1 at [2*b + s],
+    // the cell position x*scale + offset = firstPoint + (x - start)/spacing
+    // and the last cell of the segment
+    std::vector<G4double> fBinBoundary;
+    std::vector<G4double> fBinScale;
+    std::vector<G4double> fBinOffset;
+    std::vector<G4int> fBinLastCell;
+    G4double fMin;
+    G4double fInvBinWidth;
+    
+    // Spacing and last cell of a uniform axis
+    G4bool fUniform;
+    G4double fInvSpacing;
+    G4int fLastCell;
+};
+
+inline void GridAxis::Locate(G4double x, G4int& index, G4double& t) const
+{
+  if (fUniform) {
+    G4double f = (x - fMin) * fInvSpacing;
+    index = std::min(static_cast<G4int>(f), fLastCell);
+    t = f - index;
+    return;
+  }
+  
+  G4int bin = static_cast<G4int>((x - fMin) * fInvBinWidth);
+  G4int j = 2*bin + (x >= fBinBoundary[bin]);
+  
+  // A coordinate rounded just across a segment start comes out at t
+  // slightly below 0 or above 1, which interpolates correctly
+  G4double f = x * fBinScale[j] + fBinOffset[j];
+  index = std::min(static_cast<G4int>(f), fBinLastCell[j]);
+  t = f - index;
+}
+
+#endif
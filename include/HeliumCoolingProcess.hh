@@ -0,0 +1,55 @@
+// ==================================
+// include/HeliumCoolingProcess.hh
+// ==================================
+
+#ifndef HeliumCoolingProcess_h
+#define HeliumCoolingProcess_h 1
+
+#include "G4VDiscreteProcess.hh"
+#include "G4ParticleChange.hh"
+#include "globals.hh"
+
+class G4GenericMessenger;
+class VolumeRoleTable;
+class StepTrace;
+
+// Transverse "cooling" in the helium cloud: px and py shrink by
+// exp(-L/coolingLength) over a path length L, so the result does not
+// depend on how the path is split into steps.
+//
+// The factor is applied at the end of every step, to the momentum that
+// transport in the field has already rotated. An along-step change would
+// be a delta from the pre-step momentum, added to the rotated one, which
+// is off by the square of the rotation angle and heats the beam once the
+// track turns far within a step. The process is strongly forced so it
+// runs after every step, and never limits one.
+class HeliumCoolingProcess : public G4VDiscreteProcess
+{
+  public:
+    HeliumCoolingProcess(const G4String& name = "heliumCooling");
+    virtual ~HeliumCoolingProcess();
+    
+    virtual G4bool IsApplicable(const G4ParticleDefinition& particle);
+    
+    virtual G4double PostStepGetPhysicalInteractionLength(const G4Track& track,
+                                                          G4double previousStepSize,
+                                                          G4ForceCondition* condition);
+    
+    virtual G4VParticleChange* PostStepDoIt(const G4Track& track, const G4Step& step);
+    
+  protected:
+    // Not used, as the process is forced
+    virtual G4double GetMeanFreePath(const G4Track& track, G4double previousStepSize,
+                                     G4ForceCondition* condition);
+    
+  private:
+    G4ParticleChange fParticleChange;
+    const VolumeRoleTable* fRoleTable;
+    StepTrace* fStepTrace;
+    
+    G4bool fEnabled;
+    G4double fCoolingLength;   // e-folding length of the transverse momentum
+    G4GenericMessenger* fMessenger;
+};
+
+#endif
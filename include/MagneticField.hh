@@ -7,11 +7,23 @@
 
 #include "G4ElectroMagneticField.hh"
 #include "G4ThreeVector.hh"
+#include "AxisymmetricField.hh"
+#include "FieldBatch.hh"
+#include "FieldStorage.hh"
+#include <memory>
 
-class MagneticField : public G4ElectroMagneticField  // Changed from G4MagneticField
+class FieldStatistics;
+
+class MagneticField : public G4ElectroMagneticField,  // Changed from G4MagneticField
+                      public AxisymmetricField
 {
   public:
     MagneticField();
+    
+    // Solenoid of peak field maxField over [zMin, zMax], ramping linearly over
+    // taperLength at both ends, out to maxRadius
+    MagneticField(G4double maxField, G4double zMin, G4double zMax,
+                  G4double taperLength, G4double maxRadius);
     virtual ~MagneticField();
     
     // Implementation of GetFieldValue from G4ElectroMagneticField
@@ -20,11 +32,28 @@ class MagneticField : public G4ElectroMagneticField  // Changed from G4MagneticF
     // Implementation of pure virtual function from G4ElectroMagneticField
     virtual G4bool DoesFieldChangeEnergy() const { return false; }
     
+    // Batched evaluation of n points, for bulk users outside G4 tracking;
+    // branch-free so the loop vectorises
+    void GetFieldValues(G4int n, const FieldPoints& points, const FieldValues& values) const;
+    
+    // Analytic solenoid model in the (r,z) plane
+    virtual void GetFieldRZ(G4double r, G4double z, G4double fieldRZ[4]) const;
+    virtual G4double GetMaxRadius() const { return fMaxRadius; }
+    virtual G4double GetZMin() const { return fZMin; }
+    virtual G4double GetZMax() const { return fZMax; }
+    
+    // Serve GetFieldValue from a precomputed map instead of the analytic model
+    void SetFieldMap(std::shared_ptr<const SolenoidFieldMap> fieldMap) { fFieldMap = fieldMap; }
+    
   private:
     G4double fMaxField;      // Maximum field strength (7 Tesla)
     G4double fZMin;          // Field start position (-200 cm)
     G4double fZMax;          // Field end position (1000 cm)
     G4double fZTaperLength;  // Tapering length at edges
+    G4double fMaxRadius;     // Maximum radius of the field effect (90 cm)
+    
+    std::shared_ptr<const SolenoidFieldMap> fFieldMap;
+    FieldStatistics* fStatistics;   // Of the thread that owns the field
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,38 @@
+// ========================
+// include/MappedFile.hh
+// ========================
+
+#ifndef MappedFile_h
+#define MappedFile_h 1
+
+#include "globals.hh"
+#include <cstddef>
+#include <vector>
+
+// Read-only view of a whole file. On POSIX systems the file is memory
+// mapped, so its pages are shared by every thread, and every process,
+// that maps it; elsewhere it is read into memory. The data starts on a
+// page boundary when mapped.
+class MappedFile
+{
+  public:
+    explicit MappedFile(const G4String& fileName);
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    G4bool IsValid() const { return fData != nullptr; }
+    G4bool IsMapped() const { return fMapped; }
+    
+    const char* GetData() const { return fData; }
+    std::size_t GetSize() const { return fSize; }
+    
+  private:
+    const char* fData;
+    std::size_t fSize;
+    G4bool fMapped;
+    std::vector<char> fBuffer;   // Contents when the file could not be mapped
+};
+
+#endif
@@ -0,0 +1,50 @@
+// ==========================
+// include/NtupleOutput.hh
+// ==========================
+
+#ifndef NtupleOutput_h
+#define NtupleOutput_h 1
+
+#include "globals.hh"
+#include <cstdint>
+
+class G4GenericAnalysisManager;
+
+// Trajectory and particle rows as G4AnalysisManager ntuples, with the
+// columns of the CSV files.
+//
+// The ntuples are booked on every thread when it is built, so master and
+// workers agree on them, and written to a file of the analysis manager's
+// type: csv, root, xml, or hdf5 when Geant4 was built with HDF5. The
+// analysis manager buffers the rows; with root the workers' rows are
+// merged into the master's file, the other types leave a file per thread.
+class NtupleOutput
+{
+  public:
+    NtupleOutput();
+    
+    // Open <fileName>.<fileType> for a run; false if the type is not available
+    G4bool Open(const G4String& fileName, const G4String& fileType);
+    
+    // Write the rows of this thread, merging them on the master, and close
+    void Close();
+    
+    G4bool IsOpen() const { return fOpen; }
+    
+    void AddTrajectory(G4int eventID, const char* detector, const G4double values[6]);
+    void AddParticle(G4int eventID, const char* detector, const char* particle,
+                     G4double energy);
+    
+    std::uint64_t GetRows(G4int ntuple) const { return fRows[ntuple]; }
+    
+    enum Ntuple { kTrajectory, kParticle, kNumNtuples };
+    static const char* const kNtupleNames[kNumNtuples];
+  
+  private:
+    G4GenericAnalysisManager* fManager;
+    G4int fIDs[kNumNtuples];
+    std::uint64_t fRows[kNumNtuples];
+    G4bool fOpen;
+};
+
+#endif
@@ -0,0 +1,101 @@
+// ==============================
+// include/PhaseSpaceFormat.hh
+// ==============================
+
+#ifndef PhaseSpaceFormat_h
+#define PhaseSpaceFormat_h 1
+
+#include "globals.hh"
+#include <cstddef>
+#include <cstdint>
+
+// Layout of the columnar phase-space files (.bps), written by
+// PhaseSpaceWriter and read by PhaseSpaceReader.
+//
+//   PhaseSpaceFileHeader
+//   dictionary: detector names, then species names, each ending in '\0',
+//               padded to 8 bytes
+//   row groups: PhaseSpaceGroupHeader, then one block per column
+//   offsets of the row groups from the start of the file, uint64 each
+//   PhaseSpaceFooter
+//
+// Each column block of a group holds the group's rows contiguously and
+// starts on an 8-byte boundary, so a mapped file can be read in place.
+// Detector and species are dictionary codes, indices into the names of the
+// dictionary. Positions are in cm and momenta in GeV/c, as in the CSV
+// files, stored as float or double for the whole file. Values are in the
+// byte order of the machine that wrote the file.
+namespace PhaseSpaceFormat {
+  enum Column {
+    kEventID = 0,
+    kDetector,
+    kSpecies,
+    kX,
+    kPX,
+    kY,
+    kPY,
+    kZ,
+    kPZ,
+    kNumColumns
+  };
+  
+  const G4int kNumRealColumns = kNumColumns - kX;
+  
+  extern const char* const kColumnNames[kNumColumns];
+  
+  const char kFileMagic[8] = { 'B', 'T', 'P', 'H', 'A', 'S', 'E', '1' };
+  const char kFooterMagic[8] = { 'B', 'T', 'P', 'H', 'E', 'N', 'D', '1' };
+  const std::uint32_t kVersion = 1;
+  
+  struct FileHeader
+  {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t realSize;         // 4 or 8: float or double values
+    std::uint32_t rowGroupSize;     // Rows per group; the last of each writer may have fewer
+    std::uint32_t nDetectors;
+    std::uint32_t nSpecies;
+    std::uint32_t dictionarySize;   // Bytes, padding included
+  };
+  
+  // Smallest and largest value of a column in a group; codes and event IDs
+  // are stored as doubles too
+  struct Range
+  {
+    double min;
+    double max;
+  };
+  
+  struct GroupHeader
+  {
+    std::uint64_t nRows;
+    std::uint64_t size;             // Bytes of the group, this header included
+    Range ranges[kNumColumns];
+  };
+  
+  struct Footer
+  {
+    std::uint64_t nRows;
+    std::uint64_t nGroups;
+    char magic[8];
+  };
+  
+  inline std::size_t Pad8(std::size_t size) { return (size + 7) & ~std::size_t(7); }
+  
+  // Offsets of the column blocks from the start of a group of nRows rows,
+  // and the size of the group in offsets[kNumColumns]
+  inline void GetColumnOffsets(std::size_t nRows, std::size_t realSize,
+                               std::size_t offsets[kNumColumns + 1])
+  {
+    std::size_t offset = sizeof(GroupHeader);
+    for (G4int column = 0; column < kNumColumns; ++column) {
+      offsets[column] = offset;
+      std::size_t elementSize = (column == kEventID) ? sizeof(std::int32_t)
+                              : (column < kX) ? sizeof(std::uint8_t) : realSize;
+      offset += Pad8(nRows * elementSize);
+    }
+    offsets[kNumColumns] = offset;
+  }
+}
+
+#endif
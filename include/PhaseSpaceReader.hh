@@ -0,0 +1,107 @@
+// ==============================
+// include/PhaseSpaceReader.hh
+// ==============================
+
+#ifndef PhaseSpaceReader_h
+#define PhaseSpaceReader_h 1
+
+#include "globals.hh"
+#include "MappedFile.hh"
+#include "PhaseSpaceFormat.hh"
+#include <cstdint>
+#include <vector>
+
+// Reader of a columnar phase-space file (see PhaseSpaceFormat.hh).
+//
+// The file is mapped, and the columns of each row group are returned as
+// pointers into the mapping, so reading a column copies nothing. The
+// ranges in the group headers let a caller skip groups without touching
+// their columns:
+//
+//   PhaseSpaceReader reader("trajectory_data_run0.bps");
+//   for (std::size_t g = 0; g < reader.GetNGroups(); ++g) {
+//     PhaseSpaceReader::Group group = reader.GetGroup(g);
+//     if (group.GetRange(PhaseSpaceFormat::kPZ).max < 0.2) continue;
+//     const float* pz = group.GetColumn<float>(PhaseSpaceFormat::kPZ);
+//     ...
+//   }
+class PhaseSpaceReader
+{
+  public:
+    // View of one row group
+    class Group
+    {
+      public:
+        Group(const char* data, std::size_t realSize);
+        
+        std::size_t GetNRows() const { return fHeader->nRows; }
+        const PhaseSpaceFormat::Range& GetRange(PhaseSpaceFormat::Column column) const {
+          return fHeader->ranges[column];
+        }
+        
+        const std::int32_t* GetEventIDs() const {
+          return reinterpret_cast<const std::int32_t*>(fData + fOffsets[PhaseSpaceFormat::kEventID]);
+        }
+        const std::uint8_t* GetDetectors() const {
+          return reinterpret_cast<const std::uint8_t*>(fData + fOffsets[PhaseSpaceFormat::kDetector]);
+        }
+        const std::uint8_t* GetSpecies() const {
+          return reinterpret_cast<const std::uint8_t*>(fData + fOffsets[PhaseSpaceFormat::kSpecies]);
+        }
+        
+        // Values of a phase-space column; null unless Real is the stored type
+        template <class Real>
+        const Real* GetColumn(PhaseSpaceFormat::Column column) const {
+          if (column < PhaseSpaceFormat::kX || sizeof(Real) != fRealSize) return nullptr;
+          return reinterpret_cast<const Real*>(fData + fOffsets[column]);
+        }
+        
+        // Any column of one row as a double
+        G4double GetValue(PhaseSpaceFormat::Column column, std::size_t row) const;
+        
+        // The whole group, header included
+        const char* GetData() const { return fData; }
+        std::size_t GetSize() const { return fHeader->size; }
+      
+      private:
+        const char* fData;
+        const PhaseSpaceFormat::GroupHeader* fHeader;
+        std::size_t fRealSize;
+        std::size_t fOffsets[PhaseSpaceFormat::kNumColumns + 1];
+    };
+    
+    // Map and check the file; errors are reported and leave it invalid
+    explicit PhaseSpaceReader(const G4String& fileName);
+    
+    G4bool IsValid() const { return fValid; }
+    
+    const PhaseSpaceFormat::FileHeader& GetHeader() const { return *fHeader; }
+    G4bool IsDoublePrecision() const { return fHeader->realSize == sizeof(double); }
+    
+    std::uint64_t GetNRows() const { return fNRows; }
+    std::size_t GetNGroups() const { return fGroupOffsets.size(); }
+    Group GetGroup(std::size_t index) const {
+      return Group(fFile.GetData() + fGroupOffsets[index], fHeader->realSize);
+    }
+    
+    // Names of the dictionary codes, "unknown" out of range
+    const char* GetDetectorName(G4int code) const;
+    const char* GetSpeciesName(G4int code) const;
+    
+    // The dictionary as stored, padding included
+    const char* GetDictionary() const { return fFile.GetData() + sizeof(PhaseSpaceFormat::FileHeader); }
+    std::size_t GetDictionarySize() const { return fHeader->dictionarySize; }
+  
+  private:
+    G4bool Check(const G4String& fileName);
+    
+    MappedFile fFile;
+    const PhaseSpaceFormat::FileHeader* fHeader;
+    std::vector<const char*> fDetectorNames;
+    std::vector<const char*> fSpeciesNames;
+    std::vector<std::uint64_t> fGroupOffsets;
+    std::uint64_t fNRows;
+    G4bool fValid;
+};
+
+#endif
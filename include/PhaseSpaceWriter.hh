@@ -0,0 +1,85 @@
+// ==============================
+// include/PhaseSpaceWriter.hh
+// ==============================
+
+#ifndef PhaseSpaceWriter_h
+#define PhaseSpaceWriter_h 1
+
+#include "globals.hh"
+#include "BufferedFile.hh"
+#include "PhaseSpaceFormat.hh"
+#include <cstdint>
+#include <vector>
+
+// Writer of a columnar phase-space file (see PhaseSpaceFormat.hh).
+//
+// Rows are collected column by column in memory and written as a row
+// group, with the range of each column, when the group is full; Close
+// writes the last group and the index of the groups. The dictionary holds
+// the detector and species names of VolumeRoleTable.
+class PhaseSpaceWriter
+{
+  public:
+    PhaseSpaceWriter();
+    ~PhaseSpaceWriter();
+    
+    PhaseSpaceWriter(const PhaseSpaceWriter&) = delete;
+    PhaseSpaceWriter& operator=(const PhaseSpaceWriter&) = delete;
+    
+    // Open for writing, truncating the file; false if it cannot be opened
+    G4bool Open(const G4String& fileName, G4int rowGroupSize, G4bool doublePrecision,
+                std::size_t bufferSize);
+    
+    // Write the pending rows and the index, and close the file
+    void Close();
+    
+    G4bool IsOpen() const { return fFile.IsOpen(); }
+    const G4String& GetFileName() const { return fFile.GetFileName(); }
+    
+    // One row: x, px, y, py, z, pz in cm and GeV/c
+    inline void Add(G4int eventID, G4int detector, G4int species, const G4double values[6]);
+    
+    std::uint64_t GetRows() const { return fRows; }
+    std::uint64_t GetBytes() const { return fFile.GetBytes(); }
+    std::uint64_t GetWrites() const { return fFile.GetWrites(); }
+    
+    // Copy the row groups of the given files, which must share their
+    // precision and dictionary, into one file; false if any cannot be read
+    static G4bool Merge(const G4String& fileName, const std::vector<G4String>& inputs,
+                        std::size_t bufferSize);
+  
+  private:
+    void WriteGroup();
+    
+    template <class Real>
+    void WriteRealColumn(const std::vector<G4double>& values);
+    
+    BufferedFile fFile;
+    G4int fRowGroupSize;
+    G4bool fDoublePrecision;
+    
+    // Columns of the group being filled
+    std::vector<std::int32_t> fEventIDs;
+    std::vector<std::uint8_t> fDetectors;
+    std::vector<std::uint8_t> fSpecies;
+    std::vector<G4double> fValues[PhaseSpaceFormat::kNumRealColumns];
+    
+    std::vector<std::uint64_t> fGroupOffsets;
+    std::uint64_t fRows;
+};
+
+inline void PhaseSpaceWriter::Add(G4int eventID, G4int detector, G4int species,
+                                  const G4double values[6])
+{
+  fEventIDs.push_back(eventID);
+  fDetectors.push_back(static_cast<std::uint8_t>(detector));
+  fSpecies.push_back(static_cast<std::uint8_t>(species));
+  for (G4int i = 0; i < PhaseSpaceFormat::kNumRealColumns; ++i) {
+    fValues[i].push_back(values[i]);
+  }
+  if (static_cast<G4int>(fEventIDs.size()) >= fRowGroupSize) {
+    WriteGroup();
+  }
+}
+
+#endif
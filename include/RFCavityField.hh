@@ -7,11 +7,39 @@
 
 #include "G4ElectroMagneticField.hh"
 #include "G4ThreeVector.hh"
+#include "AxisymmetricField.hh"
+#include "FieldBatch.hh"
+#include "FieldStorage.hh"
+#include <memory>
 
-class RFCavityField : public G4ElectroMagneticField
+class BesselTable;
+class FieldStatistics;
+
+// RF cavity field, E(r,z) cos(omega*t + phase), in one of two models:
+//
+//   kGaussian  Ez with a Gaussian radial profile, a standing wave
+//              cos(kz (z - zMin)) along z and linear ramps at the ends;
+//              no magnetic field. The original, empirical model.
+//   kPillbox   The TM010 mode of a pillbox cavity:
+//                Ez   = E0 J0(k r) cos(omega*t + phase)
+//                Bphi = -(E0/c) J1(k r) sin(omega*t + phase)
+//              with k = omega/c, uniform along z between the end walls
+//              and vanishing beyond the side wall at k r = 2.405, or at
+//              maxRadius if that is smaller. J0 and J1 come from a
+//              shared BesselTable. Smooth inside the wall, but Bphi
+//              drops from 0.52 E0/c to zero across it, so the volume
+//              holding the field should end at GetMaxRadius().
+class RFCavityField : public G4ElectroMagneticField,
+                      public AxisymmetricField
 {
   public:
+    enum Model { kGaussian, kPillbox };
+    
     RFCavityField();
+    
+    // Cavity of peak gradient amplitude over [zMin, zMax], out to maxRadius
+    RFCavityField(G4double amplitude, G4double frequency, G4double phase,
+                  G4double zMin, G4double zMax, G4double maxRadius);
     virtual ~RFCavityField();
     
     // Method to compute both electric and magnetic field at a given point
@@ -20,7 +48,56 @@ class RFCavityField : public G4ElectroMagneticField
     // Implementation of pure virtual function from G4ElectroMagneticField
     virtual G4bool DoesFieldChangeEnergy() const { return true; }  // RF field changes energy
     
+    // Batched evaluation of n points, for bulk users outside G4 tracking;
+    // branch-free, and the phase cache is not used
+    void GetFieldValues(G4int n, const FieldPoints& points, const FieldValues& values) const;
+    
+    void SetModel(Model model);
+    Model GetModel() const { return fModel; }
+    
+    // Spatial profile of Ez; the full field is this times cos(omega*t + phase)
+    G4double GetSpatialEz(G4double r, G4double z) const;
+    
+    // The same profile at r^2 as GetFieldValue takes it: from the field
+    // map when one is set, else analytic
+    G4double GetTrackingSpatialEz(G4double r2, G4double z) const;
+    
+    // Time factor cos(omega*t + phase)
+    G4double GetTimeFactor(G4double t) const;
+    
+    G4double GetAmplitude() const { return fAmplitude; }
+    G4double GetAngularFrequency() const { return fOmega; }
+    G4double GetPhase() const { return fPhase; }
+    
+    // Spatial part of the electric field in the (r,z) plane, without the
+    // time factor. Bphi has no place here, so maps carry the electric
+    // field only and the pillbox Bphi always comes from the table.
+    virtual void GetFieldRZ(G4double r, G4double z, G4double fieldRZ[4]) const;
+    virtual G4double GetMaxRadius() const { return fFieldRadius; }
+    virtual G4double GetZMin() const { return fZmin; }
+    virtual G4double GetZMax() const { return fZmax; }
+    
+    // Take the spatial profile from a precomputed map in GetFieldValue
+    void SetFieldMap(std::shared_ptr<const RFFieldMap> fieldMap) { fFieldMap = fieldMap; }
+    
+    // Advance the time factor from the previous call when t has moved little
+    void SetPhaseCache(G4bool enable) { fUsePhaseCache = enable; fPhaseCacheValid = false; }
+    
   private:
+    G4double GetSpatialEzR2(G4double r2, G4double z) const;
+    
+    // cos and sin of omega*t + phase, through the phase cache when enabled
+    void GetPhaseFactors(G4double t, G4double& cosPhase, G4double& sinPhase) const;
+    
+    G4bool InPillbox(G4double r2, G4double z) const {
+      return z >= fZmin && z <= fZmax && r2 <= fFieldRadius*fFieldRadius;
+    }
+    
+    // Pillbox Ez and Bphi/r, the latter per unit of the sine time factor,
+    // at r^2 inside the cavity
+    void GetPillboxProfile(G4double r2, G4double& ez, G4double& bPhiOverR) const;
+    
+    Model fModel;
     G4double fAmplitude;     // Field amplitude
     G4double fFrequency;     // RF frequency
     G4double fPhase;         // RF phase
@@ -28,6 +105,29 @@ class RFCavityField : public G4ElectroMagneticField
     G4double fZmin;          // Start of RF cavity
     G4double fZmax;          // End of RF cavity
     G4double fMaxRadius;     // Maximum radius of field
+    
+    // Derived once from the parameters above
+    G4double fOmega;         // 2 pi f
+    G4double fKz;            // 2 pi / wavelength
+    G4double fRadialCoeff;   // Gaussian exponent per r^2
+    G4double fEdgeWidth;     // Length of the linear ramps at the cavity ends
+    G4double fFieldRadius;   // Radius beyond which the field vanishes
+    
+    // Pillbox mode: x^2 = (k r)^2 per r^2, and Bphi/r per J1(kr)/(kr)
+    const BesselTable* fBessel;
+    G4double fBesselScale;
+    G4double fMagneticCoeff;
+    
+    // Phase recurrence cache: cos and sin of the phase at fPhaseCacheTime
+    G4bool fUsePhaseCache;
+    mutable G4bool fPhaseCacheValid;
+    mutable G4int fPhaseCacheUpdates;   // Recurrence steps since the last exact value
+    mutable G4double fPhaseCacheTime;
+    mutable G4double fPhaseCacheCos;
+    mutable G4double fPhaseCacheSin;
+    
+    std::shared_ptr<const RFFieldMap> fFieldMap;
+    FieldStatistics* fStatistics;   // Of the thread that owns the field
 };
 
 #endif
\ No newline at end of file
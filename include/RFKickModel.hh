@@ -0,0 +1,33 @@
+// ==========================
+// include/RFKickModel.hh
+// ==========================
+
+#ifndef RFKickModel_h
+#define RFKickModel_h 1
+
+#include "G4VFastSimulationModel.hh"
+
+class RFCavityField;
+
+// Thin-cavity model of the RF gap: instead of integrating the oscillating
+// field through the gap, a track entering the region is moved straight to
+// the exit and given the energy gain q*V0*T*cos(phi) once. V0*T and the
+// phase offset come from the spatial profile of RFCavityField along the
+// straight path, with the particle's velocity and arrival time; the profile
+// is the one tracking uses, so with /beamTest/rf/table both read the map.
+class RFKickModel : public G4VFastSimulationModel
+{
+  public:
+    RFKickModel(const G4String& name, G4Region* envelope, const RFCavityField* field);
+    virtual ~RFKickModel();
+    
+    virtual G4bool IsApplicable(const G4ParticleDefinition& particle);
+    virtual G4bool ModelTrigger(const G4FastTrack& fastTrack);
+    virtual void DoIt(const G4FastTrack& fastTrack, G4FastStep& fastStep);
+    
+  private:
+    const RFCavityField* fField;
+    G4int fNIntervals;   // Simpson intervals across the gap
+};
+
+#endif
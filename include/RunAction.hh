@@ -7,8 +7,7 @@
 
 #include "G4UserRunAction.hh"
 #include "globals.hh"
-#include <map>
-#include <string>
+#include "VolumeRoleTable.hh"
 #include <mutex>
 
 class G4Run;
@@ -24,14 +23,14 @@ class RunAction : public G4UserRunAction
     
     // Methods to add particles to the counters
     // Note: This method is thread-safe
-    void AddParticle(const G4String& detectorName, const G4String& particleName, G4double energy);
+    void AddParticle(G4int detectorIndex, Species species, G4double energy);
     
   private:
-    // Map to store particle counts: [detector_name][particle_name] = count
-    std::map<G4String, std::map<G4String, int>> fParticleCounts;
+    // Particle counts: [detector_index][species] = count
+    G4int fParticleCounts[kNumDetectors][kNumSpecies];
     
-    // Map to store total energy: [detector_name][particle_name] = total_energy
-    std::map<G4String, std::map<G4String, G4double>> fTotalEnergy;
+    // Total energy: [detector_index][species] = total_energy
+    G4double fTotalEnergy[kNumDetectors][kNumSpecies];
     
     // Mutex to protect thread access to the maps
     std::mutex fMutex;
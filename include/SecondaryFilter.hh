@@ -0,0 +1,58 @@
+// =============================
+// include/SecondaryFilter.hh
+// =============================
+
+#ifndef SecondaryFilter_h
+#define SecondaryFilter_h 1
+
+#include "globals.hh"
+#include "VolumeRoleTable.hh"
+#include <vector>
+
+class G4Track;
+class G4GenericMessenger;
+
+// Decides at stacking time which new tracks are not worth transporting:
+// species below their kinetic energy threshold, and secondaries that
+// cannot reach any of the recorded detector planes, upstream or
+// downstream of where they are created. One instance is shared
+// read-only by the stacking actions of all threads and is configured
+// from the master thread between runs.
+class SecondaryFilter
+{
+  public:
+    enum Verdict {
+      kKeep = 0,
+      kBelowThreshold,
+      kNoPlaneAhead,
+      kSlowCharged,
+      kOutsideAcceptance
+    };
+    
+    SecondaryFilter();
+    ~SecondaryFilter();
+    
+    // Species lookup goes through the role table of the calling thread
+    Verdict Classify(const G4Track* track, const VolumeRoleTable* roleTable) const;
+    
+    void SetThreshold(Species species, G4double energy) { fThreshold[species] = energy; }
+    
+  private:
+    // Whether the track's line or helix crosses the acceptance radius of a
+    // plane dz away along its direction of travel
+    G4bool CanReachPlane(const G4Track* track, G4double dz) const;
+    void ThresholdCommand(const G4String& value);
+    void PlanesCommand(const G4String& value);
+    
+    G4double fThreshold[kNumSpecies];   // Kinetic energy cut per species
+    
+    G4bool fReachabilityCut;    // Apply the kinematic reachability test to secondaries
+    std::vector<G4double> fPlaneZ;   // Centres of the recorded planes
+    G4double fPlaneRadius;      // Acceptance radius of the planes
+    G4double fSolenoidField;    // Nominal Bz used for the helix estimate
+    G4double fMinChargedPz;     // Charged secondaries slower than this along z spiral out
+    
+    G4GenericMessenger* fMessenger;
+};
+
+#endif
@@ -0,0 +1,73 @@
+// ==========================
+// include/SpscQueue.hh
+// ==========================
+
+#ifndef SpscQueue_h
+#define SpscQueue_h 1
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded queue between one producer thread and one consumer thread,
+// without locks. Each index is written by one side only, and the release
+// store of an index publishes the slots behind it to the other side. The
+// indices sit on separate cache lines, so the two sides do not contend for
+// a line unless the queue is empty or full.
+template <class T>
+class SpscQueue
+{
+  public:
+    // Capacity is rounded up to a power of two
+    explicit SpscQueue(std::size_t capacity)
+    : fMask(0),
+      fHead(0),
+      fTail(0)
+    {
+      std::size_t size = 1;
+      while (size < capacity) size <<= 1;
+      fSlots.resize(size);
+      fMask = size - 1;
+    }
+    
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+    
+    // Producer: false when full
+    bool Push(const T& value)
+    {
+      std::size_t tail = fTail.load(std::memory_order_relaxed);
+      if (tail - fHead.load(std::memory_order_acquire) > fMask) return false;
+      fSlots[tail & fMask] = value;
+      fTail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+    
+    // Consumer: false when empty
+    bool Pop(T& value)
+    {
+      std::size_t head = fHead.load(std::memory_order_relaxed);
+      if (head == fTail.load(std::memory_order_acquire)) return false;
+      value = fSlots[head & fMask];
+      fHead.store(head + 1, std::memory_order_release);
+      return true;
+    }
+    
+    // Entries queued, as of some moment during the call; the head is read
+    // first, so the difference cannot go negative
+    std::size_t GetSize() const
+    {
+      std::size_t head = fHead.load(std::memory_order_acquire);
+      return fTail.load(std::memory_order_acquire) - head;
+    }
+    
+    std::size_t GetCapacity() const { return fMask + 1; }
+  
+  private:
+    std::vector<T> fSlots;
+    std::size_t fMask;
+    alignas(64) std::atomic<std::size_t> fHead;   // Next to pop, written by the consumer
+    alignas(64) std::atomic<std::size_t> fTail;   // Next to push, written by the producer
+};
+
+#endif
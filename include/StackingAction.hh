@@ -0,0 +1,27 @@
+// =============================
+// include/StackingAction.hh
+// =============================
+
+#ifndef StackingAction_h
+#define StackingAction_h 1
+
+#include "G4UserStackingAction.hh"
+#include "globals.hh"
+
+class SecondaryFilter;
+class VolumeRoleTable;
+
+class StackingAction : public G4UserStackingAction
+{
+  public:
+    StackingAction(const SecondaryFilter* filter);
+    virtual ~StackingAction();
+    
+    virtual G4ClassificationOfNewTrack ClassifyNewTrack(const G4Track* track);
+    
+  private:
+    const SecondaryFilter* fFilter;
+    const VolumeRoleTable* fRoleTable;
+};
+
+#endif
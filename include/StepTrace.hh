@@ -0,0 +1,93 @@
+// ========================
+// include/StepTrace.hh
+// ========================
+
+#ifndef StepTrace_h
+#define StepTrace_h 1
+
+#include "globals.hh"
+#include <cstdint>
+#include <vector>
+
+class G4Step;
+class G4GenericMessenger;
+
+// Fixed-size binary record written for each traced step
+struct StepRecord
+{
+  std::int32_t eventID;
+  std::int32_t trackID;
+  std::int32_t pdgCode;
+  std::int32_t volumeID;        // G4LogicalVolume instance ID (pre-step point)
+  std::int32_t processType;     // G4ProcessType of the post-step process, -1 if none
+  std::int32_t processSubType;  // Process sub-type, -1 if none
+  std::int32_t flags;           // StepTrace::Flag bits
+  std::int32_t reserved;
+  G4double kineticEnergy;
+  G4double stepLength;
+  G4double prePosition[3];
+  G4double postPosition[3];
+  G4double momentum[3];
+};
+
+// Per-thread step tracing into a binary ring buffer.
+//
+// Level 0 disables tracing, level 1 records only the steps something acts
+// on, traced where it acts: detector hits by DetectorSD and helium cooling
+// by HeliumCoolingProcess. Level 2 also records every other step, which
+// only the stepping action sees, so it needs /beamTest/actions/stepping.
+// A step traced from several places is kept once, with all their flags.
+// The buffer belongs to one thread only, so recording needs no locking; it
+// is written to disk on demand, on event abort and at end of run.
+class StepTrace
+{
+  public:
+    enum Flag {
+      kNone          = 0,
+      kDetectorHit   = 1 << 0,
+      kCooling       = 1 << 1
+    };
+
+    // Instance owned by the calling thread
+    static StepTrace* Instance();
+
+    G4int GetLevel() const { return fLevel; }
+    void SetLevel(G4int level) { fLevel = level; }
+
+    // Resize the ring buffer (rounded up to a power of two); drops the contents
+    void SetCapacity(G4int nRecords);
+
+    void SetEventID(G4int eventID) { fEventID = eventID; }
+
+    // Record the step if the current level asks for it
+    inline void Trace(const G4Step* step, G4int flags);
+
+    // Append the buffered records to this thread's trace file and clear the buffer
+    void Dump(const G4String& reason);
+
+  private:
+    StepTrace();
+    ~StepTrace();
+
+    void Record(const G4Step* step, G4int flags);
+    void DumpCommand() { Dump("user request"); }
+
+    std::vector<StepRecord> fBuffer;
+    std::uint64_t fMask;
+    std::uint64_t fHead;    // Total number of records written since last dump
+    G4int fLevel;
+    G4int fEventID;
+    G4int fLastTrackID;     // Step of the newest record
+    G4int fLastStepNumber;
+    G4String fFileName;     // Base name, thread ID and ".bin" are appended
+    G4GenericMessenger* fMessenger;
+};
+
+inline void StepTrace::Trace(const G4Step* step, G4int flags)
+{
+  if (fLevel > 1 || (fLevel > 0 && flags != kNone)) {
+    Record(step, flags);
+  }
+}
+
+#endif
@@ -0,0 +1,49 @@
+// ==============================
+// include/StepperComparison.hh
+// ==============================
+
+#ifndef StepperComparison_h
+#define StepperComparison_h 1
+
+#include "globals.hh"
+#include "G4ThreeVector.hh"
+#include <vector>
+
+class FieldIntegration;
+class G4ElectroMagneticField;
+class G4ChordFinder;
+class G4EquationOfMotion;
+
+// Tracks a fixed, seeded set of muons through a magnetic field with every
+// stepper, using the accuracy settings of a FieldIntegration, and reports
+// field calls and wall time per track and the end-point deviation from a
+// tight-tolerance reference. No geometry is involved: each muon is
+// propagated in chord-limited steps over the same path length.
+class StepperComparison
+{
+  public:
+    StepperComparison(const FieldIntegration& integration, G4ElectroMagneticField* field);
+    ~StepperComparison();
+    
+    void Run(G4int nMuons, G4double trackLength);
+    
+  private:
+    struct Muon
+    {
+      G4ThreeVector position;
+      G4ThreeVector direction;
+      G4double kineticEnergy;
+      G4double charge;
+    };
+    
+    // End point of one muon; epsilon <= 0 takes it from the integration settings
+    G4ThreeVector Propagate(G4ChordFinder* chordFinder, G4EquationOfMotion* equation,
+                            const Muon& muon, G4double trackLength, G4double epsilon) const;
+    
+    const FieldIntegration& fIntegration;
+    G4ElectroMagneticField* fField;
+    G4double fMuonMass;
+    std::vector<Muon> fMuons;
+};
+
+#endif
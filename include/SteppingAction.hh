@@ -8,24 +8,24 @@
 #include "G4UserSteppingAction.hh"
 #include "globals.hh"
 
-class EventAction;
-class G4LogicalVolume;
+class StepTrace;
+class VolumeRoleTable;
+class FieldStatistics;
+class G4FieldManager;
 
 class SteppingAction : public G4UserSteppingAction
 {
   public:
-    SteppingAction(EventAction* eventAction);
+    SteppingAction();
     virtual ~SteppingAction();
     
     virtual void UserSteppingAction(const G4Step*);
     
   private:
-    EventAction* fEventAction;
-    G4LogicalVolume* fDetector1LV;
-    G4LogicalVolume* fDetector2LV;
-    G4LogicalVolume* fDetector3LV;
-    G4LogicalVolume* fHeliumCloudLV;
-    G4LogicalVolume* fRFCavityLV;
+    StepTrace* fStepTrace;
+    const VolumeRoleTable* fRoleTable;
+    FieldStatistics* fFieldStatistics;
+    const G4FieldManager* fGlobalFieldManager;
 };
 
 #endif
@@ -0,0 +1,40 @@
+// =====================================
+// include/TrackAccuracyFieldManager.hh
+// =====================================
+
+#ifndef TrackAccuracyFieldManager_h
+#define TrackAccuracyFieldManager_h 1
+
+#include "G4FieldManager.hh"
+#include "FieldIntegration.hh"
+#include "FieldStatistics.hh"
+
+// Field manager that sets the integration accuracy per track from the
+// momentum bands of its FieldIntegration: loose for fast, weakly curving
+// tracks, tight for the slow muons the analysis is after.
+//
+// Transportation calls ConfigureForTrack before every step in the field,
+// so the band is looked up at the track's current momentum and follows
+// it as the track slows down. The lookup is a species table read and a
+// scan of a few bands; the manager is only touched when the band changes.
+// The same call opens the step in FieldStatistics, so the field calls and
+// substeps that follow are booked to the track's species and volume.
+class TrackAccuracyFieldManager : public G4FieldManager
+{
+  public:
+    explicit TrackAccuracyFieldManager(const FieldIntegration& integration);
+    
+    virtual void ConfigureForTrack(const G4Track* track);
+  
+  private:
+    const FieldIntegration& fIntegration;
+    VolumeRoleTable* fRoles;         // Of the thread that built the manager
+    FieldStatistics* fStatistics;
+    
+    // Band applied last, null for the defaults, and the table version it
+    // came from; -1 before the first track
+    const FieldIntegration::TrackAccuracy* fApplied;
+    G4int fAppliedVersion;
+};
+
+#endif
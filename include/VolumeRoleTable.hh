@@ -0,0 +1,85 @@
+// =============================
+// include/VolumeRoleTable.hh
+// =============================
+
+#ifndef VolumeRoleTable_h
+#define VolumeRoleTable_h 1
+
+#include "globals.hh"
+#include "G4LogicalVolume.hh"
+#include "G4ParticleDefinition.hh"
+#include <cstdint>
+#include <vector>
+
+// Role of a logical volume as seen by the user actions
+enum VolumeRole : std::uint8_t {
+  kPassive = 0,
+  kDetector1,
+  kDetector2,
+  kDetector3,
+  kHeliumCloud,
+  kRFCavity
+};
+
+// Compact particle species IDs; muons and pions come first and are contiguous
+enum Species : std::uint8_t {
+  kOtherSpecies = 0,
+  kMuPlus,
+  kMuMinus,
+  kPiPlus,
+  kPiMinus,
+  kPi0,
+  kNeutron,
+  kElectron,
+  kGamma,
+  kNumSpecies
+};
+
+const G4int kNumDetectors = 3;
+
+// Per-thread lookup tables from logical volume and particle definition
+// instance IDs to roles and species, so the stepping hot path needs no
+// string construction or comparison. Rebuilt at the start of every run,
+// once the geometry is closed.
+class VolumeRoleTable
+{
+  public:
+    // Instance owned by the calling thread
+    static VolumeRoleTable* Instance();
+
+    // Fill the tables from the logical volume store and particle table
+    void Build();
+
+    VolumeRole GetRole(const G4LogicalVolume* volume) const {
+      return fRoles[volume->GetInstanceID()];
+    }
+
+    Species GetSpecies(const G4ParticleDefinition* particle) const {
+      std::size_t id = static_cast<std::size_t>(particle->GetInstanceID());
+      return id < fSpecies.size() ? fSpecies[id] : kOtherSpecies;
+    }
+
+    static G4bool IsDetector(VolumeRole role) {
+      return role >= kDetector1 && role <= kDetector3;
+    }
+    static G4int GetDetectorIndex(VolumeRole role) { return role - kDetector1; }
+
+    // Muons and pions are the species recorded in the particle summaries
+    static G4bool IsMuonOrPion(Species species) {
+      return species >= kMuPlus && species <= kPi0;
+    }
+
+    static const char* GetDetectorName(G4int detectorIndex);
+    static const char* GetSpeciesName(Species species);
+    
+    // Species with the given name, kNumSpecies if there is none
+    static Species FindSpecies(const G4String& name);
+
+  private:
+    VolumeRoleTable() {}
+
+    std::vector<VolumeRole> fRoles;    // Indexed by G4LogicalVolume instance ID
+    std::vector<Species> fSpecies;     // Indexed by G4ParticleDefinition instance ID
+};
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "DetectorConstruction.hh"
 #include "ActionInitialization.hh"
+#include "BeamlinePhysics.hh"
 
 #include "G4RunManagerFactory.hh"
 #include "G4SteppingVerbose.hh"
@@ -58,13 +59,16 @@ int main(int argc, char** argv)
   physicsList->RegisterPhysics(new G4IonPhysics());
   physicsList->RegisterPhysics(new G4NeutronTrackingCut());
   
+  // Beamline element effects (helium cloud cooling, RF kick hook)
+  physicsList->RegisterPhysics(new BeamlinePhysics());
+  
   runManager->SetUserInitialization(physicsList);
     
   // User action initialization
   runManager->SetUserInitialization(new ActionInitialization(detConstruction));
   
-  // Initialize G4 kernel
-  runManager->Initialize();
+  // The G4 kernel is initialized by /run/initialize in the macro, so
+  // construction options can be set before it
   
   // Initialize visualization
   G4VisManager* visManager = new G4VisExecutive;
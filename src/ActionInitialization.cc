@@ -7,16 +7,33 @@
 #include "RunAction.hh"
 #include "EventAction.hh"
 #include "SteppingAction.hh"
+#include "StackingAction.hh"
+#include "SecondaryFilter.hh"
 #include "DetectorConstruction.hh"
+#include "G4GenericMessenger.hh"
 
 ActionInitialization::ActionInitialization(DetectorConstruction* detConstruction)
 : G4VUserActionInitialization(),
-  fDetectorConstruction(detConstruction)
+  fDetectorConstruction(detConstruction),
+  fUseSteppingAction(false),
+  fSecondaryFilter(new SecondaryFilter()),
+  fMessenger(nullptr)
 {
+  fMessenger = new G4GenericMessenger(this, "/beamTest/actions/", "User action selection");
+  
+  fMessenger->DeclareProperty("stepping", fUseSteppingAction,
+    "Install the stepping action (needed for level 2 step tracing and the "
+    "looper kill counts). "
+    "Detector hits are recorded without it. Takes effect for worker threads "
+    "built after the command, i.e. it must precede the first /run/beamOn.")
+    .SetParameterName("enable", false)
+    .SetToBeBroadcasted(false);
 }
 
 ActionInitialization::~ActionInitialization()
 {
+  delete fMessenger;
+  delete fSecondaryFilter;
 }
 
 void ActionInitialization::BuildForMaster() const
@@ -34,9 +51,14 @@ void ActionInitialization::Build() const
   SetUserAction(runAction);
   
   // Event action
-  EventAction* eventAction = new EventAction();
+  EventAction* eventAction = new EventAction(runAction);
   SetUserAction(eventAction);
   
-  // Stepping action
-  SetUserAction(new SteppingAction(eventAction));
+  // Stacking action, kills secondaries before they are stacked
+  SetUserAction(new StackingAction(fSecondaryFilter));
+  
+  // Stepping action, only when a run needs its effects
+  if (fUseSteppingAction) {
+    SetUserAction(new SteppingAction());
+  }
 }
@@ -0,0 +1,241 @@
+// ==========================
+// src/AsyncWriter.cc
+// ==========================
+
+#include "AsyncWriter.hh"
+#include "EventOutput.hh"
+#include "G4Threading.hh"
+#include "G4ios.hh"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+namespace {
+  // Sleep of a producer waiting for room, and of the writer between polls
+  // of empty channels; the writer backs off to the longer one when idle
+  const std::chrono::microseconds kWaitSleep(20);
+  const std::chrono::microseconds kIdleSleep(1000);
+  const G4int kIdlePolls = 1000;
+  
+  std::size_t GetEventBytes(const OutputEvent& event)
+  {
+    return sizeof(OutputEvent) + event.hits.capacity() * sizeof(OutputHit);
+  }
+  
+  G4double Seconds(std::chrono::steady_clock::duration duration)
+  {
+    return std::chrono::duration<G4double>(duration).count();
+  }
+}
+
+AsyncChannel::AsyncChannel(EventOutput* owner, std::size_t depth)
+: fOwner(owner),
+  fThreadID(std::max(G4Threading::G4GetThreadId(), 0)),
+  fFull(depth),
+  fEmpty(depth),
+  fWritten(0),
+  fBytesQueued(0),
+  fPushed(0),
+  fBudget(0),
+  fEvents(0),
+  fMaxDepth(0),
+  fPeakBytes(0),
+  fStalls(0),
+  fStallTime(0.),
+  fDrainTime(0.)
+{
+}
+
+AsyncChannel::~AsyncChannel()
+{
+  OutputEvent* event;
+  while (fFull.Pop(event)) delete event;
+  while (fEmpty.Pop(event)) delete event;
+}
+
+void AsyncChannel::ResetStatistics()
+{
+  fEvents = 0;
+  fMaxDepth = 0;
+  fPeakBytes = 0;
+  fStalls = 0;
+  fStallTime = 0.;
+  fDrainTime = 0.;
+}
+
+OutputEvent* AsyncChannel::Acquire()
+{
+  OutputEvent* event;
+  if (!fEmpty.Pop(event)) {
+    event = new OutputEvent();
+  }
+  return event;
+}
+
+void AsyncChannel::Push(OutputEvent* event)
+{
+  std::size_t bytes = GetEventBytes(*event);
+  
+  // An event always fits into an empty queue, however large it is
+  G4bool stalled = false;
+  auto start = std::chrono::steady_clock::now();
+  while (true) {
+    if (fBytesQueued.load(std::memory_order_acquire) + bytes <= fBudget
+        || fWritten.load(std::memory_order_acquire) == fPushed) {
+      fBytesQueued.fetch_add(bytes, std::memory_order_acq_rel);
+      if (fFull.Push(event)) break;
+      fBytesQueued.fetch_sub(bytes, std::memory_order_acq_rel);
+    }
+    if (!stalled) {
+      stalled = true;
+      start = std::chrono::steady_clock::now();
+      ++fStalls;
+    }
+    std::this_thread::sleep_for(kWaitSleep);
+  }
+  if (stalled) {
+    fStallTime += Seconds(std::chrono::steady_clock::now() - start);
+  }
+  
+  ++fPushed;
+  ++fEvents;
+  fMaxDepth = std::max(fMaxDepth, fFull.GetSize());
+  fPeakBytes = std::max(fPeakBytes, fBytesQueued.load(std::memory_order_relaxed));
+}
+
+void AsyncChannel::Drain()
+{
+  if (fWritten.load(std::memory_order_acquire) == fPushed) return;
+  
+  auto start = std::chrono::steady_clock::now();
+  while (fWritten.load(std::memory_order_acquire) != fPushed) {
+    std::this_thread::sleep_for(kWaitSleep);
+  }
+  G4double wait = Seconds(std::chrono::steady_clock::now() - start);
+  fStallTime += wait;
+  fDrainTime += wait;
+}
+
+G4bool AsyncChannel::Service()
+{
+  G4bool any = false;
+  OutputEvent* event;
+  while (fFull.Pop(event)) {
+    fOwner->WriteRecords(*event);
+    
+    // Sized before the producer can reuse it
+    std::size_t bytes = GetEventBytes(*event);
+    if (!fEmpty.Push(event)) delete event;
+    fBytesQueued.fetch_sub(bytes, std::memory_order_acq_rel);
+    fWritten.fetch_add(1, std::memory_order_release);
+    any = true;
+  }
+  return any;
+}
+
+AsyncWriter* AsyncWriter::Instance()
+{
+  static AsyncWriter writer;
+  return &writer;
+}
+
+AsyncWriter::AsyncWriter()
+: fNChannels(0),
+  fStop(false),
+  fBusyNanoseconds(0)
+{
+  for (std::atomic<AsyncChannel*>& channel : fChannels) {
+    channel.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+AsyncWriter::~AsyncWriter()
+{
+  fStop.store(true, std::memory_order_release);
+  if (fThread.joinable()) {
+    fThread.join();
+  }
+  for (std::atomic<AsyncChannel*>& channel : fChannels) {
+    delete channel.load(std::memory_order_acquire);
+  }
+}
+
+AsyncChannel* AsyncWriter::Connect(EventOutput* owner, std::size_t depth)
+{
+  std::lock_guard<std::mutex> lock(fConnectMutex);
+  
+  G4int n = fNChannels.load(std::memory_order_relaxed);
+  if (n == kMaxChannels) {
+    G4cerr << "AsyncWriter: no more than " << kMaxChannels << " channels" << G4endl;
+    return nullptr;
+  }
+  
+  AsyncChannel* channel = new AsyncChannel(owner, depth);
+  fChannels[n].store(channel, std::memory_order_release);
+  fNChannels.store(n + 1, std::memory_order_release);
+  
+  if (!fThread.joinable()) {
+    fThread = std::thread(&AsyncWriter::Run, this);
+  }
+  return channel;
+}
+
+void AsyncWriter::Run()
+{
+  G4int idlePolls = 0;
+  while (!fStop.load(std::memory_order_acquire)) {
+    auto start = std::chrono::steady_clock::now();
+    G4bool any = false;
+    G4int n = fNChannels.load(std::memory_order_acquire);
+    for (G4int i = 0; i < n; ++i) {
+      if (fChannels[i].load(std::memory_order_acquire)->Service()) any = true;
+    }
+    
+    if (any) {
+      auto busy = std::chrono::steady_clock::now() - start;
+      fBusyNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count(),
+                                 std::memory_order_relaxed);
+      idlePolls = 0;
+    } else {
+      std::this_thread::sleep_for((++idlePolls < kIdlePolls) ? kWaitSleep : kIdleSleep);
+    }
+  }
+}
+
+void AsyncWriter::PrintReport()
+{
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "                          ASYNC OUTPUT                          " << G4endl;
+  G4cout << "================================================================" << G4endl;
+  G4cout << std::setw(6) << "Thread" << " | " 
+         << std::setw(8) << "Events" << " | " 
+         << std::setw(11) << "Depth/cap" << " | " 
+         << std::setw(8) << "Peak MB" << " | " 
+         << std::setw(6) << "Stalls" << " | " 
+         << std::setw(9) << "Stall [s]" << " | " 
+         << std::setw(9) << "Drain [s]" << G4endl;
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  
+  G4int n = fNChannels.load(std::memory_order_acquire);
+  for (G4int i = 0; i < n; ++i) {
+    AsyncChannel* channel = fChannels[i].load(std::memory_order_acquire);
+    if (channel->GetEvents() == 0) continue;
+    G4cout << std::setw(6) << channel->GetThreadID() << " | " 
+           << std::setw(8) << channel->GetEvents() << " | " 
+           << std::setw(5) << channel->GetMaxDepth() << "/" 
+           << std::left << std::setw(5) << channel->GetCapacity() << std::right << " | " 
+           << std::setw(8) << channel->GetPeakBytes() / 1048576. << " | " 
+           << std::setw(6) << channel->GetStalls() << " | " 
+           << std::setw(9) << channel->GetStallTime() << " | " 
+           << std::setw(9) << channel->GetDrainTime() << G4endl;
+    
+    // The workers are idle between runs, and count afresh in the next
+    channel->ResetStatistics();
+  }
+  
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  G4cout << "Writer thread busy for "
+         << fBusyNanoseconds.exchange(0, std::memory_order_relaxed) * 1e-9 << " s" << G4endl;
+  G4cout << "================================================================" << G4endl;
+}
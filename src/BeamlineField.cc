@@ -0,0 +1,95 @@
+// ===========================
+// src/BeamlineField.cc
+// ===========================
+
+#include "BeamlineField.hh"
+#include <algorithm>
+
+BeamlineField::BeamlineField()
+: G4ElectroMagneticField(),
+  fChangesEnergy(false),
+  fLastSegment(0)
+{
+}
+
+BeamlineField::~BeamlineField()
+{
+}
+
+void BeamlineField::AddElement(G4ElectroMagneticField* field, G4double zMin, G4double zMax,
+                               G4double maxRadius)
+{
+  fFields.emplace_back(field);
+  fElements.push_back({ zMin, zMax, maxRadius*maxRadius, field });
+  fChangesEnergy = fChangesEnergy || field->DoesFieldChangeEnergy();
+}
+
+void BeamlineField::BuildIndex()
+{
+  fBoundaries.clear();
+  for (const Element& element : fElements) {
+    fBoundaries.push_back(element.zMin);
+    fBoundaries.push_back(element.zMax);
+  }
+  std::sort(fBoundaries.begin(), fBoundaries.end());
+  fBoundaries.erase(std::unique(fBoundaries.begin(), fBoundaries.end()), fBoundaries.end());
+  
+  // An element covers the segments from its zMin boundary up to its zMax one
+  G4int nSegments = std::max<G4int>(0, fBoundaries.size() - 1);
+  std::vector<std::vector<G4int>> covering(nSegments);
+  for (std::size_t e = 0; e < fElements.size(); ++e) {
+    auto first = std::lower_bound(fBoundaries.begin(), fBoundaries.end(), fElements[e].zMin);
+    auto last = std::lower_bound(fBoundaries.begin(), fBoundaries.end(), fElements[e].zMax);
+    for (auto it = first; it != last; ++it) {
+      covering[it - fBoundaries.begin()].push_back(e);
+    }
+  }
+  
+  fSegmentStart.assign(1, 0);
+  fSegmentElements.clear();
+  for (const std::vector<G4int>& elements : covering) {
+    fSegmentElements.insert(fSegmentElements.end(), elements.begin(), elements.end());
+    fSegmentStart.push_back(fSegmentElements.size());
+  }
+  fLastSegment = 0;
+}
+
+void BeamlineField::GetFieldValue(const G4double point[4], G4double* field) const
+{
+  for (G4int i = 0; i < 6; ++i) {
+    field[i] = 0.0;
+  }
+  
+  G4double z = point[2];
+  if (fBoundaries.empty() || z < fBoundaries.front() || z >= fBoundaries.back()) {
+    return;
+  }
+  
+  G4int segment = fLastSegment;
+  if (z < fBoundaries[segment] || z >= fBoundaries[segment + 1]) {
+    segment = std::upper_bound(fBoundaries.begin(), fBoundaries.end(), z) - fBoundaries.begin() - 1;
+    fLastSegment = segment;
+  }
+  G4double r2 = point[0]*point[0] + point[1]*point[1];
+  
+  for (G4int k = fSegmentStart[segment]; k < fSegmentStart[segment + 1]; ++k) {
+    const Element& element = fElements[fSegmentElements[k]];
+    if (r2 > element.maxRadius2) continue;
+    
+    // Pure magnetic elements only fill the first three components
+    G4double value[6] = { 0., 0., 0., 0., 0., 0. };
+    element.field->GetFieldValue(point, value);
+    for (G4int i = 0; i < 6; ++i) {
+      field[i] += value[i];
+    }
+  }
+}
+
+G4double BeamlineField::GetMeanOverlap() const
+{
+  G4double weighted = 0.;
+  for (G4int s = 0; s < GetNumberOfSegments(); ++s) {
+    weighted += (fSegmentStart[s + 1] - fSegmentStart[s]) * (fBoundaries[s + 1] - fBoundaries[s]);
+  }
+  return (GetNumberOfSegments() > 0) ? weighted / (fBoundaries.back() - fBoundaries.front()) : 0.;
+}
@@ -0,0 +1,200 @@
+// =============================
+// src/BeamlineLattice.cc
+// =============================
+
+#include "BeamlineLattice.hh"
+#include "BeamlineField.hh"
+#include "FieldBenchmark.hh"
+#include "MagneticField.hh"
+#include "RFCavityField.hh"
+#include "G4GenericMessenger.hh"
+#include "G4UIcommand.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4ios.hh"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+  // Field ramp at the ends of a solenoid section, as in the default solenoid
+  const G4double kSolenoidTaper = 50.0*cm;
+}
+
+BeamlineLattice::BeamlineLattice()
+: fEnabled(false),
+  fMessenger(nullptr)
+{
+  fMessenger = new G4GenericMessenger(this, "/beamTest/beamline/", "Beamline lattice of field elements");
+  
+  fMessenger->DeclareProperty("enable", fEnabled,
+    "Replace the solenoid and RF cavity fields by the lattice, on the global "
+    "field manager. Set before /run/initialize.")
+    .SetParameterName("enable", false)
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareMethod("add", &BeamlineLattice::AddCommand,
+    "Add an element: 'solenoid <zCentre> <length> <radius> <unit> <Bz> <unit>' or "
+    "'cavity <zCentre> <length> <radius> <unit> <gradient> <unit> <frequency> <unit> <phase> <unit>'")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareMethod("load", &BeamlineLattice::LoadCommand,
+    "Add the elements of a lattice file, one definition per line as for add")
+    .SetParameterName("fileName", false)
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareMethod("clear", &BeamlineLattice::ClearCommand,
+    "Remove all elements")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareMethod("list", &BeamlineLattice::ListCommand,
+    "Print the lattice")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareMethod("benchmark", &BeamlineLattice::BenchmarkCommand,
+    "Time field lookups in generated lattices of growing size")
+    .SetParameterName("nPoints", true)
+    .SetDefaultValue("1000000")
+    .SetRange("nPoints>0")
+    .SetToBeBroadcasted(false);
+}
+
+BeamlineLattice::~BeamlineLattice()
+{
+  delete fMessenger;
+}
+
+BeamlineField* BeamlineLattice::CreateField() const
+{
+  BeamlineField* field = new BeamlineField();
+  
+  if (fElements.empty()) {
+    MagneticField* solenoid = new MagneticField();
+    field->AddElement(solenoid, solenoid->GetZMin(), solenoid->GetZMax(), solenoid->GetMaxRadius());
+    RFCavityField* cavity = new RFCavityField();
+    field->AddElement(cavity, cavity->GetZMin(), cavity->GetZMax(), cavity->GetMaxRadius());
+  }
+  
+  for (const ElementSpec& spec : fElements) {
+    G4double zMin = spec.zCentre - 0.5*spec.length;
+    G4double zMax = spec.zCentre + 0.5*spec.length;
+    if (spec.cavity) {
+      field->AddElement(new RFCavityField(spec.strength, spec.frequency, spec.phase,
+                                          zMin, zMax, spec.radius),
+                        zMin, zMax, spec.radius);
+    } else {
+      G4double taper = std::min(kSolenoidTaper, 0.5*spec.length);
+      field->AddElement(new MagneticField(spec.strength, zMin, zMax, taper, spec.radius),
+                        zMin, zMax, spec.radius);
+    }
+  }
+  
+  field->BuildIndex();
+  return field;
+}
+
+G4bool BeamlineLattice::AddElement(const G4String& line)
+{
+  std::istringstream is(line);
+  G4String type, lengthUnit, strengthUnit;
+  ElementSpec spec = { false, 0., 0., 0., 0., 0., 0. };
+  is >> type >> spec.zCentre >> spec.length >> spec.radius >> lengthUnit
+     >> spec.strength >> strengthUnit;
+  
+  spec.cavity = (type == "cavity");
+  G4String frequencyUnit, phaseUnit;
+  if (spec.cavity) {
+    is >> spec.frequency >> frequencyUnit >> spec.phase >> phaseUnit;
+  }
+  
+  if (is.fail() || (type != "solenoid" && !spec.cavity)) {
+    return false;
+  }
+  
+  G4double lengthScale = G4UIcommand::ValueOf(lengthUnit.c_str());
+  spec.zCentre *= lengthScale;
+  spec.length *= lengthScale;
+  spec.radius *= lengthScale;
+  spec.strength *= G4UIcommand::ValueOf(strengthUnit.c_str());
+  if (spec.cavity) {
+    spec.frequency *= G4UIcommand::ValueOf(frequencyUnit.c_str());
+    spec.phase *= G4UIcommand::ValueOf(phaseUnit.c_str());
+  }
+  
+  if (spec.length <= 0. || spec.radius <= 0.) {
+    return false;
+  }
+  fElements.push_back(spec);
+  return true;
+}
+
+void BeamlineLattice::AddCommand(const G4String& line)
+{
+  if (!AddElement(line)) {
+    G4cerr << "BeamlineLattice: cannot parse element '" << line << "'" << G4endl;
+  }
+}
+
+void BeamlineLattice::LoadCommand(const G4String& fileName)
+{
+  std::ifstream file(fileName);
+  if (!file.is_open()) {
+    G4cerr << "Error opening " << fileName << G4endl;
+    return;
+  }
+  
+  std::string line;
+  G4int lineNumber = 0;
+  G4int nAdded = 0;
+  while (std::getline(file, line)) {
+    ++lineNumber;
+    line = line.substr(0, line.find('#'));
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    
+    if (AddElement(line)) {
+      ++nAdded;
+    } else {
+      G4cerr << "BeamlineLattice: cannot parse " << fileName << ":" << lineNumber
+             << " '" << line << "'" << G4endl;
+    }
+  }
+  
+  G4cout << "BeamlineLattice: " << nAdded << " elements from " << fileName << G4endl;
+}
+
+void BeamlineLattice::ListCommand()
+{
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "                        BEAMLINE LATTICE                         " << G4endl;
+  G4cout << "================================================================" << G4endl;
+  if (fElements.empty()) {
+    G4cout << " No elements defined; the default solenoid and RF cavity are used" << G4endl;
+  }
+  G4cout << std::setw(9) << "Element" << " | " 
+         << std::setw(10) << "z [cm]" << " | " 
+         << std::setw(10) << "L [cm]" << " | " 
+         << std::setw(8) << "R [cm]" << " | " 
+         << std::setw(16) << "Strength" << G4endl;
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  
+  for (const ElementSpec& spec : fElements) {
+    std::ostringstream strength;
+    if (spec.cavity) {
+      strength << spec.strength/(megavolt/m) << " MV/m";
+    } else {
+      strength << spec.strength/tesla << " T";
+    }
+    G4cout << std::setw(9) << (spec.cavity ? "cavity" : "solenoid") << " | " 
+           << std::setw(10) << spec.zCentre/cm << " | " 
+           << std::setw(10) << spec.length/cm << " | " 
+           << std::setw(8) << spec.radius/cm << " | " 
+           << std::setw(16) << strength.str() << G4endl;
+  }
+  G4cout << "================================================================" << G4endl;
+}
+
+void BeamlineLattice::BenchmarkCommand(G4int nPoints)
+{
+  FieldBenchmark::RunBeamline(nPoints);
+}
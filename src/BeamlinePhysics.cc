@@ -0,0 +1,43 @@
+// =============================
+// src/BeamlinePhysics.cc
+// =============================
+
+#include "BeamlinePhysics.hh"
+#include "HeliumCoolingProcess.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4ProcessManager.hh"
+#include "G4FastSimulationManagerProcess.hh"
+
+BeamlinePhysics::BeamlinePhysics(const G4String& name)
+: G4VPhysicsConstructor(name)
+{
+}
+
+BeamlinePhysics::~BeamlinePhysics()
+{
+}
+
+void BeamlinePhysics::ConstructParticle()
+{
+  // Particles are constructed by the reference physics list
+}
+
+void BeamlinePhysics::ConstructProcess()
+{
+  // One cooling process per thread, shared by all charged particles
+  HeliumCoolingProcess* cooling = new HeliumCoolingProcess();
+  
+  // Fast simulation hook for the RF kick model; inactive unless a model
+  // is attached to the RF cavity region
+  G4FastSimulationManagerProcess* fastSim = new G4FastSimulationManagerProcess("fastSimProcess");
+  
+  auto particleIterator = GetParticleIterator();
+  particleIterator->reset();
+  while ((*particleIterator)()) {
+    G4ParticleDefinition* particle = particleIterator->value();
+    if (cooling->IsApplicable(*particle)) {
+      particle->GetProcessManager()->AddDiscreteProcess(cooling);
+      particle->GetProcessManager()->AddDiscreteProcess(fastSim);
+    }
+  }
+}
@@ -0,0 +1,46 @@
+// ==========================
+// src/BesselTable.cc
+// ==========================
+
+#include "BesselTable.hh"
+
+namespace {
+  const G4int kTablePoints = 1024;
+  
+  // Terms of the series; (x/2)^2 <= 1.45 in the tabulated range, so the
+  // last term is below 1e-25
+  const G4int kSeriesTerms = 16;
+}
+
+const BesselTable& BesselTable::Instance()
+{
+  static const BesselTable table;
+  return table;
+}
+
+BesselTable::BesselTable()
+: fNodes(kTablePoints),
+  fInvSpacing((kTablePoints - 1) / (kFirstZero * kFirstZero)),
+  fLastCell(kTablePoints - 2)
+{
+  for (G4int i = 0; i < kTablePoints; ++i) {
+    Series(i / fInvSpacing, fNodes[i].j0, fNodes[i].j1OverX);
+  }
+}
+
+void BesselTable::Series(G4double x2, G4double& j0, G4double& j1OverX)
+{
+  // J0(x)   = sum_m (-q)^m / (m! m!)
+  // J1(x)/x = 1/2 sum_m (-q)^m / (m! (m+1)!),   q = x^2/4
+  G4double q = 0.25 * x2;
+  G4double term0 = 1.;
+  G4double term1 = 0.5;
+  j0 = term0;
+  j1OverX = term1;
+  for (G4int m = 1; m < kSeriesTerms; ++m) {
+    term0 *= -q / (m * m);
+    term1 *= -q / (m * (m + 1));
+    j0 += term0;
+    j1OverX += term1;
+  }
+}
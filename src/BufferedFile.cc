@@ -0,0 +1,143 @@
+// ==========================
+// src/BufferedFile.cc
+// ==========================
+
+#include "BufferedFile.hh"
+#include "G4ios.hh"
+#include "zlib.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+  const std::size_t kCompressedBufferSize = 256 * 1024;
+  
+  // Largest input for one call of deflate, whose sizes are 32-bit
+  const std::size_t kMaxDeflateInput = 1 << 30;
+  
+  // Window bits of deflate; 16 more select the gzip wrapper
+  const G4int kGzipWindowBits = 15 + 16;
+  const G4int kMemoryLevel = 8;
+}
+
+BufferedFile::BufferedFile()
+: fFill(0),
+  fBytesFlushed(0),
+  fWrites(0),
+  fFileBytes(0),
+  fStream(nullptr),
+  fFlushInterval(0),
+  fSinceSync(0),
+  fCompressTime(0.)
+{
+}
+
+BufferedFile::~BufferedFile()
+{
+  Close();
+}
+
+G4bool BufferedFile::Open(const G4String& fileName, std::size_t bufferSize,
+                          G4int compressionLevel, std::size_t flushInterval)
+{
+  Close();
+  
+  // The stream's own buffer would only add a copy
+  fFile.rdbuf()->pubsetbuf(nullptr, 0);
+  fFile.open(fileName, std::ios::binary | std::ios::trunc);
+  if (!fFile.is_open()) return false;
+  
+  fFileName = fileName;
+  fBuffer.resize(bufferSize);
+  fFill = 0;
+  fBytesFlushed = 0;
+  fWrites = 0;
+  fFileBytes = 0;
+  fFlushInterval = flushInterval;
+  fSinceSync = 0;
+  fCompressTime = 0.;
+  
+  if (compressionLevel > 0) {
+    fStream = new z_stream();
+    if (deflateInit2(fStream, std::min(compressionLevel, 9), Z_DEFLATED, kGzipWindowBits,
+                     kMemoryLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+      G4cerr << "BufferedFile: cannot compress " << fileName << ", writing it plain" << G4endl;
+      delete fStream;
+      fStream = nullptr;
+    } else {
+      fCompressed.resize(kCompressedBufferSize);
+    }
+  }
+  return true;
+}
+
+void BufferedFile::Close()
+{
+  if (!fFile.is_open()) return;
+  
+  Flush();
+  if (fStream) {
+    Deflate(Z_FINISH);
+    deflateEnd(fStream);
+    delete fStream;
+    fStream = nullptr;
+  }
+  fFile.close();
+}
+
+void BufferedFile::Flush()
+{
+  if (fFill == 0) return;
+  
+  WriteThrough(fBuffer.data(), fFill);
+  fFill = 0;
+}
+
+void BufferedFile::WriteThrough(const void* data, std::size_t size)
+{
+  fBytesFlushed += size;
+  if (!fStream) {
+    WriteFile(static_cast<const char*>(data), size);
+    return;
+  }
+  
+  const char* input = static_cast<const char*>(data);
+  while (size > 0) {
+    std::size_t chunk = std::min(size, kMaxDeflateInput);
+    fStream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+    fStream->avail_in = static_cast<uInt>(chunk);
+    Deflate(Z_NO_FLUSH);
+    input += chunk;
+    size -= chunk;
+    fSinceSync += chunk;
+  }
+  
+  // Complete the deflate blocks so far, so the file can be read up to here
+  if (fFlushInterval > 0 && fSinceSync >= fFlushInterval) {
+    Deflate(Z_SYNC_FLUSH);
+    fFile.flush();
+    fSinceSync = 0;
+  }
+}
+
+void BufferedFile::Deflate(G4int flush)
+{
+  // Output is written whenever it fills the buffer; the stream is done
+  // with the input, and with the flush, once it leaves room in the buffer
+  do {
+    fStream->next_out = reinterpret_cast<Bytef*>(fCompressed.data());
+    fStream->avail_out = static_cast<uInt>(fCompressed.size());
+    auto start = std::chrono::steady_clock::now();
+    deflate(fStream, flush);
+    fCompressTime += std::chrono::duration<G4double>(std::chrono::steady_clock::now() - start).count();
+    WriteFile(fCompressed.data(), fCompressed.size() - fStream->avail_out);
+  } while (fStream->avail_out == 0);
+}
+
+void BufferedFile::WriteFile(const char* data, std::size_t size)
+{
+  if (size == 0) return;
+  
+  fFile.write(data, size);
+  fFileBytes += size;
+  ++fWrites;
+}
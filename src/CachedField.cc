@@ -0,0 +1,51 @@
+// =========================
+// src/CachedField.cc
+// =========================
+
+#include "CachedField.hh"
+#include "FieldStatistics.hh"
+
+CachedField::CachedField(const G4Field* field, G4double distance)
+: G4ElectroMagneticField(),
+  fField(field),
+  fDistance2(distance * distance),
+  fValid(false),
+  fLastPoint(),
+  fLastValue(),
+  fStatistics(FieldStatistics::Instance())
+{
+}
+
+CachedField::~CachedField()
+{
+}
+
+void CachedField::GetFieldValue(const G4double point[4], G4double* field) const
+{
+  if (fValid) {
+    G4double dx = point[0] - fLastPoint[0];
+    G4double dy = point[1] - fLastPoint[1];
+    G4double dz = point[2] - fLastPoint[2];
+    if (dx*dx + dy*dy + dz*dz <= fDistance2) {
+      fStatistics->CountCacheHit();
+      for (G4int i = 0; i < 6; ++i) {
+        field[i] = fLastValue[i];
+      }
+      return;
+    }
+  }
+  
+  fStatistics->CountCacheMiss();
+  
+  // Magnetic-only sources fill just the first three components
+  fLastValue[3] = fLastValue[4] = fLastValue[5] = 0.0;
+  fField->GetFieldValue(point, fLastValue);
+  fLastPoint[0] = point[0];
+  fLastPoint[1] = point[1];
+  fLastPoint[2] = point[2];
+  fValid = true;
+  
+  for (G4int i = 0; i < 6; ++i) {
+    field[i] = fLastValue[i];
+  }
+}
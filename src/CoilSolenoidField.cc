@@ -0,0 +1,240 @@
+// ==============================
+// src/CoilSolenoidField.cc
+// ==============================
+
+#include "CoilSolenoidField.hh"
+#include "FieldMap2D.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4ios.hh"
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+  // Bump when the field model changes, to invalidate cached maps
+  const std::uint64_t kModelVersion = 1;
+  
+  // Gauss-Legendre nodes and weights on [-1, 1], placing the current
+  // sheets across the thickness of a winding
+  const G4int kRadialNodes = 8;
+  const G4double kNodePositions[kRadialNodes] = {
+    -0.9602898564975363, -0.7966664774136267, -0.5255324099163290, -0.1834346424956498,
+     0.1834346424956498,  0.5255324099163290,  0.7966664774136267,  0.9602898564975363
+  };
+  const G4double kNodeWeights[kRadialNodes] = {
+    0.1012285362903763, 0.2223810344533745, 0.3137066458778873, 0.3626837833783620,
+    0.3626837833783620, 0.3137066458778873, 0.2223810344533745, 0.1012285362903763
+  };
+  
+  // Convergence of the AGM iteration in Cel; the error of the result goes
+  // as its square
+  const G4double kCelTolerance = 1.0e-8;
+  
+  // Floor of the complementary modulus, reached only on a sheet's own edge
+  // where the field diverges
+  const G4double kMinModulus = 1.0e-12;
+  
+  // Bulirsch's generalised complete elliptic integral
+  //   cel(kc, p, c, s) = int_0^pi/2 (c cos^2 + s sin^2)
+  //                      / ((cos^2 + p sin^2) sqrt(cos^2 + kc^2 sin^2)) dphi
+  // by the arithmetic-geometric mean, which converges quadratically
+  G4double Cel(G4double kc, G4double p, G4double c, G4double s)
+  {
+    G4double k = std::abs(kc);
+    G4double pp = p;
+    G4double cc = c;
+    G4double ss = s;
+    G4double em = 1.;
+    if (p > 0.) {
+      pp = std::sqrt(p);
+      ss = s / pp;
+    } else {
+      G4double f = kc * kc;
+      G4double q = 1. - f;
+      G4double g = 1. - pp;
+      f -= pp;
+      q *= ss - c * pp;
+      pp = std::sqrt(f / g);
+      cc = (c - ss) / g;
+      ss = -q / (g * g * pp) + cc * pp;
+    }
+    
+    G4double f = cc;
+    cc += ss / pp;
+    G4double g = k / pp;
+    ss = 2. * (ss + f * g);
+    pp += g;
+    g = em;
+    em += k;
+    G4double kk = k;
+    while (std::abs(g - k) > g * kCelTolerance) {
+      k = 2. * std::sqrt(kk);
+      kk = k * em;
+      f = cc;
+      cc += ss / pp;
+      g = kk / pp;
+      ss = 2. * (ss + f * g);
+      pp += g;
+      g = em;
+      em += k;
+    }
+    return 0.5 * pi * (ss + cc * em) / (em * (em + pp));
+  }
+  
+  // FNV-1a over the fields of the cache key
+  void HashBytes(std::uint64_t& hash, const void* data, std::size_t size)
+  {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+  }
+}
+
+CoilSolenoidField::CoilSolenoidField(G4double maxRadius, G4double zMin, G4double zMax)
+: fMaxRadius(maxRadius),
+  fZMin(zMin),
+  fZMax(zMax)
+{
+}
+
+void CoilSolenoidField::AddCoil(const Coil& coil)
+{
+  fCoils.push_back(coil);
+  
+  // mu0 n I / pi of the whole winding, shared among its sheets
+  G4double scale = mu0 * coil.current / (coil.length * pi);
+  G4double halfThickness = 0.5 * (coil.outerRadius - coil.innerRadius);
+  if (halfThickness <= 0.) {
+    fSheets.push_back({ coil.innerRadius, 0.5 * coil.length, coil.zCenter, scale });
+    return;
+  }
+  
+  G4double midRadius = coil.innerRadius + halfThickness;
+  for (G4int i = 0; i < kRadialNodes; ++i) {
+    fSheets.push_back({ midRadius + halfThickness * kNodePositions[i], 0.5 * coil.length,
+                        coil.zCenter, 0.5 * kNodeWeights[i] * scale });
+  }
+}
+
+void CoilSolenoidField::AddSheetField(const Sheet& sheet, G4double r, G4double z,
+                                      G4double& br, G4double& bz) const
+{
+  // Derby & Olbert, eq. (9)-(10): terms of the two ends at z -/+ b from z
+  G4double a = sheet.radius;
+  G4double sum = a + r;
+  G4double difference = a - r;
+  G4double gamma = difference / sum;
+  
+  G4double radial = 0.;
+  G4double axial = 0.;
+  for (G4int end = 0; end < 2; ++end) {
+    G4double zEnd = (z - sheet.zCenter) + ((end == 0) ? sheet.halfLength : -sheet.halfLength);
+    G4double sign = (end == 0) ? 1. : -1.;
+    G4double distance = std::sqrt(zEnd*zEnd + sum*sum);
+    G4double kc = std::max(kMinModulus, std::sqrt(zEnd*zEnd + difference*difference) / distance);
+    
+    radial += sign * (a / distance) * Cel(kc, 1., 1., -1.);
+    axial += sign * (zEnd / distance) * Cel(kc, gamma*gamma, 1., gamma);
+  }
+  
+  br += sheet.scale * radial;
+  bz += sheet.scale * a / sum * axial;
+}
+
+void CoilSolenoidField::GetFieldRZ(G4double r, G4double z, G4double fieldRZ[4]) const
+{
+  G4double br = 0.;
+  G4double bz = 0.;
+  for (const Sheet& sheet : fSheets) {
+    AddSheetField(sheet, r, z, br, bz);
+  }
+  
+  fieldRZ[0] = br;
+  fieldRZ[1] = bz;
+  fieldRZ[2] = 0.;
+  fieldRZ[3] = 0.;
+}
+
+std::uint64_t CoilSolenoidField::GetParameterKey() const
+{
+  std::uint64_t hash = 14695981039346656037ull;
+  HashBytes(hash, &kModelVersion, sizeof(kModelVersion));
+  HashBytes(hash, &fMaxRadius, sizeof(fMaxRadius));
+  HashBytes(hash, &fZMin, sizeof(fZMin));
+  HashBytes(hash, &fZMax, sizeof(fZMax));
+  for (const Coil& coil : fCoils) {
+    HashBytes(hash, &coil, sizeof(coil));
+  }
+  return hash;
+}
+
+template <class Storage>
+std::shared_ptr<const FieldMap2DT<Storage>> CoilSolenoidField::MakeMap(G4int nR, G4int nZ,
+                                                                     G4double tolerance,
+                                                                     G4int nThreads,
+                                                                     const G4String& cacheDirectory) const
+{
+  // The grid and storage are part of the key, so maps of several
+  // configurations can share the directory
+  std::uint64_t key = GetParameterKey();
+  HashBytes(key, &nR, sizeof(nR));
+  HashBytes(key, &nZ, sizeof(nZ));
+  HashBytes(key, &tolerance, sizeof(tolerance));
+  HashBytes(key, &Storage::kTypeId, sizeof(Storage::kTypeId));
+  
+  std::ostringstream name;
+  name << cacheDirectory << "/coils_" << std::hex << std::setw(16) << std::setfill('0') << key
+       << ".bfm";
+  G4String cacheName = name.str();
+  
+  std::shared_ptr<const FieldMap2DT<Storage>> map = FieldMap2DT<Storage>::ReadCache(cacheName, key);
+  if (map) {
+    G4cout << "CoilSolenoidField: map of " << fCoils.size() << " coils from cache "
+           << cacheName << G4endl;
+    return map;
+  }
+  
+  auto start = std::chrono::steady_clock::now();
+  map = std::make_shared<const FieldMap2DT<Storage>>(*this, nR, nZ, tolerance, nThreads);
+  auto stop = std::chrono::steady_clock::now();
+  
+  G4cout << "CoilSolenoidField: sampled " << nR << " x " << nZ << " map of " << fCoils.size()
+         << " coils on " << nThreads << " threads in "
+         << std::chrono::duration<G4double>(stop - start).count() << " s" << G4endl;
+  
+  // Serve this run from the cache as well, so every run takes the same path
+  if (map->WriteCache(cacheName, key)) {
+    std::shared_ptr<const FieldMap2DT<Storage>> cached =
+      FieldMap2DT<Storage>::ReadCache(cacheName, key);
+    if (cached) {
+      G4cout << "CoilSolenoidField: wrote cache " << cacheName << G4endl;
+      return cached;
+    }
+  }
+  return map;
+}
+
+void CoilSolenoidField::Print() const
+{
+  G4cout << "CoilSolenoidField: " << fCoils.size() << " coils" << G4endl;
+  for (const Coil& coil : fCoils) {
+    G4cout << "  r = " << coil.innerRadius/cm << " to " << coil.outerRadius/cm << " cm, z = "
+           << (coil.zCenter - 0.5*coil.length)/cm << " to " << (coil.zCenter + 0.5*coil.length)/cm
+           << " cm, " << coil.current/ampere << " A-turns" << G4endl;
+  }
+  
+  G4double fieldRZ[4];
+  GetFieldRZ(0., 0.5 * (fZMin + fZMax), fieldRZ);
+  G4cout << "  Bz on axis at z = " << 0.5 * (fZMin + fZMax)/cm << " cm: "
+         << fieldRZ[1]/tesla << " T" << G4endl;
+}
+
+template std::shared_ptr<const FieldMap2D>
+CoilSolenoidField::MakeMap<DoubleStorage>(G4int, G4int, G4double, G4int, const G4String&) const;
+template std::shared_ptr<const FieldMap2DT<FloatStorage>>
+CoilSolenoidField::MakeMap<FloatStorage>(G4int, G4int, G4double, G4int, const G4String&) const;
+template std::shared_ptr<const FieldMap2DT<QuantizedStorage>>
+CoilSolenoidField::MakeMap<QuantizedStorage>(G4int, G4int, G4double, G4int, const G4String&) const;
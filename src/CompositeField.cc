@@ -0,0 +1,37 @@
+// ===========================
+// src/CompositeField.cc
+// ===========================
+
+#include "CompositeField.hh"
+
+CompositeField::CompositeField(const G4Field* first, const G4Field* second)
+: G4ElectroMagneticField(),
+  fFirst(first),
+  fSecond(second)
+{
+}
+
+CompositeField::~CompositeField()
+{
+}
+
+void CompositeField::GetFieldValue(const G4double point[4], G4double* field) const
+{
+  // Pure magnetic fields only fill the first three components
+  G4double second[6] = { 0., 0., 0., 0., 0., 0. };
+  for (G4int i = 0; i < 6; ++i) {
+    field[i] = 0.0;
+  }
+  
+  fFirst->GetFieldValue(point, field);
+  fSecond->GetFieldValue(point, second);
+  
+  for (G4int i = 0; i < 6; ++i) {
+    field[i] += second[i];
+  }
+}
+
+G4bool CompositeField::DoesFieldChangeEnergy() const
+{
+  return fFirst->DoesFieldChangeEnergy() || fSecond->DoesFieldChangeEnergy();
+}
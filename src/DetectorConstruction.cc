@@ -5,6 +5,17 @@
 #include "DetectorConstruction.hh"
 #include "MagneticField.hh"
 #include "RFCavityField.hh"
+#include "RFKickModel.hh"
+#include "FieldMap2D.hh"
+#include "CompositeField.hh"
+#include "CachedField.hh"
+#include "FieldIntegration.hh"
+#include "StepperComparison.hh"
+#include "FieldBenchmark.hh"
+#include "BeamlineField.hh"
+#include "BeamlineLattice.hh"
+#include "DetectorSD.hh"
+#include "VolumeRoleTable.hh"
 
 #include "G4Material.hh"
 #include "G4Element.hh"
@@ -17,36 +28,424 @@
 #include "G4VisAttributes.hh"
 #include "G4Colour.hh"
 #include "G4FieldManager.hh"
-#include "G4TransportationManager.hh"
-#include "G4ChordFinder.hh"
 #include "G4SDManager.hh"
 #include "G4RotationMatrix.hh"
-#include "G4ClassicalRK4.hh"
-#include "G4UniformElectricField.hh"
-#include "G4EqMagElectricField.hh"
-#include "G4MagIntegratorStepper.hh"
-#include "G4MagIntegratorDriver.hh"
+#include "G4Region.hh"
+#include "G4AutoDelete.hh"
+#include "G4GenericMessenger.hh"
+#include "G4UIcommand.hh"
+#include "G4Threading.hh"
+#include <sstream>
+
+G4ThreadLocal MagneticField* DetectorConstruction::fMagneticField = nullptr;
+G4ThreadLocal RFCavityField* DetectorConstruction::fRFField = nullptr;
+
+namespace {
+  // RF map: r < 40 cm in 41 points of r^2, 0.5 mm steps over 50 cm in z
+  const G4int kRFMapPointsR = 41;
+  const G4int kRFMapPointsZ = 1001;
+  
+  // Tolerance of /beamTest/field/benchmarkGrid while the maps are uniform
+  const G4double kBenchmarkGridTolerance = 1.0e-4;
+}
 
 DetectorConstruction::DetectorConstruction()
  : G4VUserDetectorConstruction(),
    fWorldLV(nullptr),
    fCylinderLV(nullptr),
+   fSolenoidLV(nullptr),
    fTungstenBlockLV(nullptr),
    fDetector1LV(nullptr),
    fDetector2LV(nullptr),
    fDetector3LV(nullptr),
    fHeliumCloudLV(nullptr),
    fRFCavityLV(nullptr),
-   fMagneticField(nullptr),
-   fRFField(nullptr),
-   fFieldMgr(nullptr)
+   fRFGapLV(nullptr),
+   fFieldMgr(nullptr),
+   fRFMode("field"),
+   fRFModel("gaussian"),
+   fRFTable(true),
+   fRFPhaseCache(false),
+   fUseEnvelope(true),
+   fSolenoidIntegration(nullptr),
+   fRFIntegration(nullptr),
+   fCacheDistance(0.),
+   fUseFieldMaps(false),
+   fMapPointsR(181),
+   fMapPointsZ(1201),
+   fMapTolerance(0.),
+   fMapUnits({ cm, tesla, megavolt/m }),
+   fCoilCacheDirectory("."),
+   fLattice(nullptr),
+   fMessenger(nullptr),
+   fFieldMessenger(nullptr)
 {
+  DefineCommands();
+  
+  fSolenoidIntegration = new FieldIntegration("solenoid");
+  fRFIntegration = new FieldIntegration("rf");
+  fLattice = new BeamlineLattice();
 }
 
 DetectorConstruction::~DetectorConstruction()
 {
-  delete fMagneticField;
-  delete fRFField;
+  delete fMessenger;
+  delete fFieldMessenger;
+  delete fSolenoidIntegration;
+  delete fRFIntegration;
+  delete fLattice;
+}
+
+void DetectorConstruction::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/beamTest/rf/", "RF cavity model");
+  
+  // Read when the worker geometry is built, so it must precede /run/initialize
+  fMessenger->DeclareProperty("mode", fRFMode,
+    "RF cavity treatment: field = track through the RF field map, "
+    "kick = thin-cavity transit-time kick, off = no RF. Set before /run/initialize.")
+    .SetParameterName("mode", false)
+    .SetCandidates("field kick off")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareProperty("model", fRFModel,
+    "RF cavity field model: gaussian = Gaussian radial profile and cos(kz z) "
+    "standing wave, E only; pillbox = TM010 mode, Ez ~ J0(kr) and Bphi ~ J1(kr) "
+    "from lookup tables, with the RF gap cut to the pillbox wall (4.02 cm at "
+    "2856 MHz). Set before /run/initialize.")
+    .SetParameterName("model", false)
+    .SetCandidates("gaussian pillbox")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareProperty("table", fRFTable,
+    "Take the spatial RF profile from a precomputed (r^2,z) table instead of "
+    "the analytic form, in both the field and kick modes. Set before /run/initialize.")
+    .SetParameterName("enable", false)
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareProperty("phaseCache", fRFPhaseCache,
+    "Advance cos(omega*t + phase) from the previous call by a short series "
+    "when t has moved little, instead of calling cos. Set before /run/initialize.")
+    .SetParameterName("enable", false)
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareMethod("benchmark", &DetectorConstruction::BenchmarkRFField,
+    "Time and validate the analytic, table and phase-cache RF field evaluation, "
+    "and the Gaussian and pillbox models")
+    .SetParameterName("nPoints", true)
+    .SetDefaultValue("1000000")
+    .SetRange("nPoints>0")
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger = new G4GenericMessenger(this, "/beamTest/field/", "Field configuration");
+  
+  fFieldMessenger->DeclareProperty("envelope", fUseEnvelope,
+    "Attach the solenoid field to the solenoid envelope only (true), leaving "
+    "the rest of the hall field-free, or to the whole world (false). "
+    "Set before /run/initialize.")
+    .SetParameterName("enable", false)
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclarePropertyWithUnit("cacheDistance", "mm", fCacheDistance,
+    "Return the previous solenoid field value for queries within this distance "
+    "of the previous point; 0 disables the cache. Set before /run/initialize.")
+    .SetParameterName("distance", false)
+    .SetRange("distance>=0.")
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareProperty("map", fUseFieldMaps,
+    "Evaluate the solenoid field from a precomputed (r^2,z) map. "
+    "Set before /run/initialize.")
+    .SetParameterName("enable", false)
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareProperty("mapPointsR", fMapPointsR,
+    "Solenoid map points along r^2 (set before /run/initialize)")
+    .SetParameterName("nR", false)
+    .SetRange("nR>=2")
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareProperty("mapPointsZ", fMapPointsZ,
+    "Solenoid map points along z (set before /run/initialize)")
+    .SetParameterName("nZ", false)
+    .SetRange("nZ>=2")
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareProperty("mapTolerance", fMapTolerance,
+    "Build the sampled maps on an adaptive z grid, dropping points where "
+    "linear interpolation stays within this fraction of each component's "
+    "peak; 0 keeps the uniform grid. Set before /run/initialize.")
+    .SetParameterName("tolerance", false)
+    .SetRange("tolerance>=0")
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareMethod("solenoidMapFile", &DetectorConstruction::SetSolenoidMapFile,
+    "Import the solenoid field from an ASCII (r,z) grid file instead of the "
+    "analytic model; a binary cache <file>.bfm is written next to it and "
+    "mapped on later runs. Set before /run/initialize.")
+    .SetParameterName("fileName", false)
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareMethod("rfMapFile", &DetectorConstruction::SetRFMapFile,
+    "Import the spatial RF cavity field (peak Er, Ez) from an ASCII (r,z) "
+    "grid file, cached like the solenoid map. Set before /run/initialize.")
+    .SetParameterName("fileName", false)
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareMethod("mapUnits", &DetectorConstruction::SetMapUnits,
+    "Units of the imported map files: '<length> <magnetic> <electric>', "
+    "default 'cm tesla MV/m'")
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareMethod("coil", &DetectorConstruction::AddCoil,
+    "Add a coil to the solenoid: '<innerRadius> <outerRadius> <zCenter> "
+    "<length> <lengthUnit> <ampereTurns>'. With coils, the solenoid map is "
+    "computed from them on all cores, or read from a cache keyed by the coil "
+    "parameters. Set before /run/initialize.")
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareMethod("clearCoils", &DetectorConstruction::ClearCoils,
+    "Remove all coils, returning to the analytic solenoid")
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareProperty("coilCacheDir", fCoilCacheDirectory,
+    "Directory of the cached coil field maps, default the working directory")
+    .SetParameterName("directory", false)
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareMethod("mapReport", &DetectorConstruction::ReportFieldMaps,
+    "Print memory use and interpolation error of the field maps")
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareMethod("benchmarkBatch", &DetectorConstruction::BenchmarkBatchedField,
+    "Time the batched structure-of-arrays field evaluation against the scalar "
+    "loop for the solenoid and RF fields, analytic and mapped")
+    .SetParameterName("nPoints", true)
+    .SetDefaultValue("1000000")
+    .SetRange("nPoints>0")
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareMethod("benchmarkStorage", &DetectorConstruction::BenchmarkMapStorage,
+    "Build the solenoid and RF maps in double, float and 16-bit storage and "
+    "report memory, lookup time and interpolation error of each")
+    .SetParameterName("nPoints", true)
+    .SetDefaultValue("1000000")
+    .SetRange("nPoints>0")
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareMethod("benchmarkGrid", &DetectorConstruction::BenchmarkAdaptiveGrid,
+    "Build the solenoid and RF maps on uniform and adaptive z grids, at "
+    "mapTolerance or 1e-4 if it is 0, and report grid size, memory, lookup "
+    "time and interpolation error of each")
+    .SetParameterName("nPoints", true)
+    .SetDefaultValue("1000000")
+    .SetRange("nPoints>0")
+    .SetToBeBroadcasted(false);
+  
+  fFieldMessenger->DeclareMethod("compare", &DetectorConstruction::CompareSteppers,
+    "Track reference muons through the solenoid field with every stepper and "
+    "report field calls, time per track and end-point deviation")
+    .SetParameterName("nMuons", true)
+    .SetDefaultValue("100")
+    .SetRange("nMuons>0")
+    .SetToBeBroadcasted(false);
+}
+
+std::shared_ptr<const SolenoidFieldMap> DetectorConstruction::GetSolenoidMap()
+{
+  // Called from every thread's ConstructSDandField; the first one fills it
+  std::lock_guard<std::mutex> lock(fFieldMapMutex);
+  
+  if (!fSolenoidMap && !fSolenoidMapFile.empty()) {
+    fSolenoidMap = FieldMapImport::Load<SolenoidMapStorage>(fSolenoidMapFile, fMapUnits);
+    if (!fSolenoidMap) {
+      G4cerr << "Cannot import " << fSolenoidMapFile << ", using the analytic solenoid" << G4endl;
+      fSolenoidMapFile = "";
+    }
+  }
+  if (!fSolenoidMap && !fCoils.empty()) {
+    CoilSolenoidField coils = GetCoilField();
+    coils.Print();
+    fSolenoidMap = coils.MakeMap<SolenoidMapStorage>(fMapPointsR, fMapPointsZ, fMapTolerance,
+                                                     G4Threading::G4GetNumberOfCores(),
+                                                     fCoilCacheDirectory);
+  }
+  if (!fSolenoidMap) {
+    MagneticField solenoid;
+    fSolenoidMap = std::make_shared<const SolenoidFieldMap>(solenoid, fMapPointsR, fMapPointsZ,
+                                                           fMapTolerance);
+  }
+  return fSolenoidMap;
+}
+
+std::shared_ptr<const RFFieldMap> DetectorConstruction::GetRFMap()
+{
+  std::lock_guard<std::mutex> lock(fFieldMapMutex);
+  
+  if (!fRFMap && !fRFMapFile.empty()) {
+    fRFMap = FieldMapImport::Load<RFMapStorage>(fRFMapFile, fMapUnits);
+    if (!fRFMap) {
+      G4cerr << "Cannot import " << fRFMapFile << ", using the analytic RF cavity" << G4endl;
+      fRFMapFile = "";
+    }
+  }
+  if (!fRFMap) {
+    RFCavityField cavity;
+    cavity.SetModel(GetRFModel());
+    fRFMap = std::make_shared<const RFFieldMap>(cavity, kRFMapPointsR, kRFMapPointsZ, fMapTolerance);
+  }
+  return fRFMap;
+}
+
+RFCavityField::Model DetectorConstruction::GetRFModel() const
+{
+  return (fRFModel == "pillbox") ? RFCavityField::kPillbox : RFCavityField::kGaussian;
+}
+
+CoilSolenoidField DetectorConstruction::GetCoilField() const
+{
+  // Sampled over the extent of the analytic solenoid, the field envelope
+  MagneticField solenoid;
+  CoilSolenoidField coils(solenoid.GetMaxRadius(), solenoid.GetZMin(), solenoid.GetZMax());
+  for (const CoilSolenoidField::Coil& coil : fCoils) {
+    coils.AddCoil(coil);
+  }
+  return coils;
+}
+
+void DetectorConstruction::ReportFieldMaps()
+{
+  // Imported maps have no analytic form to check the interpolation against
+  std::shared_ptr<const SolenoidFieldMap> solenoidMap = GetSolenoidMap();
+  if (!fSolenoidMapFile.empty()) {
+    solenoidMap->Report(nullptr, "Solenoid, imported from " + fSolenoidMapFile);
+  } else if (!fCoils.empty()) {
+    CoilSolenoidField coils = GetCoilField();
+    solenoidMap->Report(&coils, "Solenoid, from " + std::to_string(fCoils.size()) + " coils");
+  } else {
+    MagneticField solenoid;
+    solenoidMap->Report(&solenoid, "Solenoid");
+  }
+  
+  std::shared_ptr<const RFFieldMap> rfMap = GetRFMap();
+  RFCavityField cavity;
+  cavity.SetModel(GetRFModel());
+  if (fRFMapFile.empty()) {
+    rfMap->Report(&cavity, "RF cavity");
+  } else {
+    rfMap->Report(nullptr, "RF cavity, imported from " + fRFMapFile);
+  }
+}
+
+void DetectorConstruction::SetSolenoidMapFile(const G4String& fileName)
+{
+  std::lock_guard<std::mutex> lock(fFieldMapMutex);
+  fSolenoidMapFile = fileName;
+  fSolenoidMap.reset();
+  fUseFieldMaps = true;
+}
+
+void DetectorConstruction::SetRFMapFile(const G4String& fileName)
+{
+  std::lock_guard<std::mutex> lock(fFieldMapMutex);
+  fRFMapFile = fileName;
+  fRFMap.reset();
+  fRFTable = true;
+}
+
+void DetectorConstruction::SetMapUnits(const G4String& units)
+{
+  std::istringstream is(units);
+  G4String length, magnetic, electric;
+  is >> length >> magnetic >> electric;
+  if (is.fail()) {
+    G4cerr << "DetectorConstruction: cannot parse map units '" << units << "'" << G4endl;
+    return;
+  }
+  
+  std::lock_guard<std::mutex> lock(fFieldMapMutex);
+  fMapUnits.length = G4UIcommand::ValueOf(length.c_str());
+  fMapUnits.magnetic = G4UIcommand::ValueOf(magnetic.c_str());
+  fMapUnits.electric = G4UIcommand::ValueOf(electric.c_str());
+  
+  // Imported maps are read again with the new units
+  if (!fSolenoidMapFile.empty()) fSolenoidMap.reset();
+  if (!fRFMapFile.empty()) fRFMap.reset();
+}
+
+void DetectorConstruction::AddCoil(const G4String& parameters)
+{
+  std::istringstream is(parameters);
+  CoilSolenoidField::Coil coil;
+  G4String lengthUnit;
+  is >> coil.innerRadius >> coil.outerRadius >> coil.zCenter >> coil.length >> lengthUnit
+     >> coil.current;
+  G4double unit = is.fail() ? 0. : G4UIcommand::ValueOf(lengthUnit.c_str());
+  if (unit <= 0. || coil.length <= 0. || coil.innerRadius <= 0.
+      || coil.outerRadius < coil.innerRadius) {
+    G4cerr << "DetectorConstruction: cannot parse coil '" << parameters << "'" << G4endl;
+    return;
+  }
+  
+  coil.innerRadius *= unit;
+  coil.outerRadius *= unit;
+  coil.zCenter *= unit;
+  coil.length *= unit;
+  coil.current *= ampere;
+  
+  std::lock_guard<std::mutex> lock(fFieldMapMutex);
+  fCoils.push_back(coil);
+  fSolenoidMap.reset();
+  fUseFieldMaps = true;
+}
+
+void DetectorConstruction::ClearCoils()
+{
+  std::lock_guard<std::mutex> lock(fFieldMapMutex);
+  fCoils.clear();
+  fSolenoidMap.reset();
+}
+
+void DetectorConstruction::BenchmarkRFField(G4int nPoints)
+{
+  FieldBenchmark::RunRFCavity(GetRFMap(), GetRFModel(), nPoints);
+  FieldBenchmark::RunRFModels(nPoints);
+}
+
+void DetectorConstruction::BenchmarkBatchedField(G4int nPoints)
+{
+  FieldBenchmark::RunBatched(GetSolenoidMap(), GetRFMap(), nPoints);
+}
+
+void DetectorConstruction::BenchmarkMapStorage(G4int nPoints)
+{
+  FieldBenchmark::RunStorage(fMapPointsR, fMapPointsZ, kRFMapPointsR, kRFMapPointsZ, nPoints);
+}
+
+void DetectorConstruction::BenchmarkAdaptiveGrid(G4int nPoints)
+{
+  G4double tolerance = (fMapTolerance > 0.) ? fMapTolerance : kBenchmarkGridTolerance;
+  FieldBenchmark::RunAdaptiveGrid(fMapPointsR, fMapPointsZ, kRFMapPointsR, kRFMapPointsZ,
+                                  tolerance, nPoints);
+}
+
+void DetectorConstruction::CompareSteppers(G4int nMuons)
+{
+  // Same field as the solenoid field manager gets, with the map if enabled
+  MagneticField solenoid;
+  if (fUseFieldMaps) {
+    solenoid.SetFieldMap(GetSolenoidMap());
+  }
+  
+  // Cached like the tracking field, so its accuracy cost shows up too
+  CachedField cached(&solenoid, fCacheDistance);
+  G4ElectroMagneticField* field = &solenoid;
+  if (fCacheDistance > 0.) {
+    field = &cached;
+  }
+  
+  StepperComparison comparison(*fSolenoidIntegration, field);
+  comparison.Run(nMuons, 10.*m);
 }
 
 void DetectorConstruction::DefineMaterials()
@@ -80,6 +479,11 @@ G4VPhysicalVolume* DetectorConstruction::DefineVolumes()
   G4double cylinder_radius = 100*cm;
   G4double cylinder_length = 5000*cm;
   
+  // Solenoid envelope, matching the extent of MagneticField
+  G4double solenoid_radius = 90*cm;
+  G4double solenoid_zmin = -200*cm;
+  G4double solenoid_zmax = 1000*cm;
+  
   // Updated tungsten block dimensions to 5×5×75 cm
   G4double tungsten_block_sizeX = 5*cm;
   G4double tungsten_block_sizeY = 5*cm;
@@ -110,6 +514,14 @@ G4VPhysicalVolume* DetectorConstruction::DefineVolumes()
   fCylinderLV = new G4LogicalVolume(cylinderS, air, "Cylinder");
   new G4PVPlacement(nullptr, G4ThreeVector(0, 0, 0), fCylinderLV, "Cylinder", fWorldLV, false, 0, true);
   
+  // Solenoid envelope: the only region with magnetic field. Every beamline
+  // element sits inside it; positions below are given in the hall frame and
+  // shifted by the envelope position when placed.
+  G4ThreeVector solenoidPos = G4ThreeVector(0, 0, 0.5*(solenoid_zmin + solenoid_zmax));
+  G4Tubs* solenoidS = new G4Tubs("Solenoid", 0, solenoid_radius, 0.5*(solenoid_zmax - solenoid_zmin), 0.*deg, 360.*deg);
+  fSolenoidLV = new G4LogicalVolume(solenoidS, air, "Solenoid");
+  new G4PVPlacement(nullptr, solenoidPos, fSolenoidLV, "Solenoid", fCylinderLV, false, 0, true);
+  
   // Tungsten Block at origin - updated to rectangular shape with specified dimensions
   G4ThreeVector tungstenBlockPos = G4ThreeVector(0, 0, 0);
   G4Box* tungstenBlockS = new G4Box("TungstenBlock", 
@@ -117,8 +529,8 @@ G4VPhysicalVolume* DetectorConstruction::DefineVolumes()
                                0.5*tungsten_block_sizeY, 
                                0.5*tungsten_block_sizeZ);
   fTungstenBlockLV = new G4LogicalVolume(tungstenBlockS, tungsten, "TungstenBlock");
-  new G4PVPlacement(rotationMatrix, tungstenBlockPos, fTungstenBlockLV, "TungstenBlock", 
-                   fCylinderLV, false, 0, true);
+  new G4PVPlacement(rotationMatrix, tungstenBlockPos - solenoidPos, fTungstenBlockLV, "TungstenBlock", 
+                   fSolenoidLV, false, 0, true);
   
   // Detector 1 (10 cm from block)
   G4ThreeVector detector1Pos = G4ThreeVector(0, 0, 10*cm);
@@ -128,8 +540,8 @@ G4VPhysicalVolume* DetectorConstruction::DefineVolumes()
                              0.5*detector_thickness, // half height
                              0.*deg, 360.*deg); // start and span angles
   fDetector1LV = new G4LogicalVolume(detector1S, silicon, "Detector1");
-  new G4PVPlacement(nullptr, detector1Pos, fDetector1LV, "Detector1", 
-                   fCylinderLV, false, 0, true);
+  new G4PVPlacement(nullptr, detector1Pos - solenoidPos, fDetector1LV, "Detector1", 
+                   fSolenoidLV, false, 0, true);
   
   // Detector 2 (200 cm from block)
   G4ThreeVector detector2Pos = G4ThreeVector(0, 0, 200*cm);
@@ -139,15 +551,15 @@ G4VPhysicalVolume* DetectorConstruction::DefineVolumes()
                              0.5*detector_thickness, // half height
                              0.*deg, 360.*deg); // start and span angles
   fDetector2LV = new G4LogicalVolume(detector2S, silicon, "Detector2");
-  new G4PVPlacement(nullptr, detector2Pos, fDetector2LV, "Detector2", 
-                   fCylinderLV, false, 0, true);
+  new G4PVPlacement(nullptr, detector2Pos - solenoidPos, fDetector2LV, "Detector2", 
+                   fSolenoidLV, false, 0, true);
   
   // Helium Cloud (250-350 cm from block)
   G4ThreeVector heliumCloudPos = G4ThreeVector(0, 0, 300*cm); // center at 300 cm (250-350)
   G4Tubs* heliumCloudS = new G4Tubs("HeliumCloud", 0, cylinder_radius*0.9, 0.5*helium_cloud_length, 0.*deg, 360.*deg);
   fHeliumCloudLV = new G4LogicalVolume(heliumCloudS, helium, "HeliumCloud");
-  new G4PVPlacement(nullptr, heliumCloudPos, fHeliumCloudLV, "HeliumCloud", 
-                   fCylinderLV, false, 0, true);
+  new G4PVPlacement(nullptr, heliumCloudPos - solenoidPos, fHeliumCloudLV, "HeliumCloud", 
+                   fSolenoidLV, false, 0, true);
   
   // RF Cavity (at 350 cm from block)
   G4ThreeVector rfCavityPos = G4ThreeVector(0, 0, 360*cm);
@@ -157,8 +569,34 @@ G4VPhysicalVolume* DetectorConstruction::DefineVolumes()
                              0.5*rf_cavity_length, 
                              0.*deg, 360.*deg);
   fRFCavityLV = new G4LogicalVolume(rfCavityS, copper, "RFCavity");
-  new G4PVPlacement(nullptr, rfCavityPos, fRFCavityLV, "RFCavity", 
-                   fCylinderLV, false, 0, true);
+  new G4PVPlacement(nullptr, rfCavityPos - solenoidPos, fRFCavityLV, "RFCavity", 
+                   fSolenoidLV, false, 0, true);
+  
+  // RF gap: the aperture inside the copper, where the accelerating field is.
+  // The pillbox field ends at its side wall, k r = 2.405, which at S-band is
+  // far inside the copper (4.02 cm at 2856 MHz), and Bphi drops there from
+  // 0.52 E0/c to zero. The gap is cut to the wall, so the jump is a volume
+  // boundary that ends the step; beyond it tracks see the solenoid only.
+  G4double rf_gap_radius = rf_cavity_inner_radius;
+  if (GetRFModel() == RFCavityField::kPillbox) {
+    RFCavityField cavity;
+    cavity.SetModel(RFCavityField::kPillbox);
+    rf_gap_radius = cavity.GetMaxRadius();
+    G4cout << "RF gap cut to the pillbox wall at r = " << rf_gap_radius/cm
+           << " cm; no RF field beyond it" << G4endl;
+  }
+  G4Tubs* rfGapS = new G4Tubs("RFGap", 
+                         0, 
+                         rf_gap_radius, 
+                         0.5*rf_cavity_length, 
+                         0.*deg, 360.*deg);
+  fRFGapLV = new G4LogicalVolume(rfGapS, air, "RFGap");
+  new G4PVPlacement(nullptr, rfCavityPos - solenoidPos, fRFGapLV, "RFGap", 
+                   fSolenoidLV, false, 0, true);
+  
+  // Envelope region for the thin-cavity kick model
+  G4Region* rfRegion = new G4Region("RFCavityRegion");
+  rfRegion->AddRootLogicalVolume(fRFGapLV);
   
   // Detector 3 (500 cm from block)
   G4ThreeVector detector3Pos = G4ThreeVector(0, 0, 500*cm);
@@ -168,8 +606,8 @@ G4VPhysicalVolume* DetectorConstruction::DefineVolumes()
                              0.5*detector_thickness, // half height
                              0.*deg, 360.*deg); // start and span angles
   fDetector3LV = new G4LogicalVolume(detector3S, silicon, "Detector3");
-  new G4PVPlacement(nullptr, detector3Pos, fDetector3LV, "Detector3", 
-                   fCylinderLV, false, 0, true);
+  new G4PVPlacement(nullptr, detector3Pos - solenoidPos, fDetector3LV, "Detector3", 
+                   fSolenoidLV, false, 0, true);
   
   // Visualization attributes
   G4VisAttributes* visAttributes = new G4VisAttributes(G4Colour(1.0, 1.0, 1.0));
@@ -178,6 +616,10 @@ G4VPhysicalVolume* DetectorConstruction::DefineVolumes()
   
   fCylinderLV->SetVisAttributes(new G4VisAttributes(G4Colour(0.9, 0.9, 0.9, 0.1)));
   
+  G4VisAttributes* solenoidVis = new G4VisAttributes(G4Colour(0.9, 0.9, 0.9, 0.1));
+  solenoidVis->SetVisibility(false);
+  fSolenoidLV->SetVisAttributes(solenoidVis);
+  
   fTungstenBlockLV->SetVisAttributes(new G4VisAttributes(G4Colour(0.5, 0.5, 0.5)));
   
   G4VisAttributes* detectorVis = new G4VisAttributes(G4Colour(0.0, 1.0, 0.0));
@@ -189,6 +631,10 @@ G4VPhysicalVolume* DetectorConstruction::DefineVolumes()
   
   fRFCavityLV->SetVisAttributes(new G4VisAttributes(G4Colour(1.0, 0.6, 0.0)));
   
+  G4VisAttributes* rfGapVis = new G4VisAttributes(G4Colour(1.0, 0.6, 0.0, 0.1));
+  rfGapVis->SetVisibility(false);
+  fRFGapLV->SetVisAttributes(rfGapVis);
+  
   return worldPV;
 }
 
@@ -203,34 +649,90 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
 
 void DetectorConstruction::ConstructSDandField()
 {
+  // Sensitive detectors for the three silicon planes
+  G4SDManager* sdManager = G4SDManager::GetSDMpointer();
+  G4LogicalVolume* detectorLVs[kNumDetectors] = {
+    GetDetector1LV(), GetDetector2LV(), GetDetector3LV()
+  };
+  for (G4int i = 0; i < kNumDetectors; ++i) {
+    G4String sdName = G4String(VolumeRoleTable::GetDetectorName(i)) + "SD";
+    DetectorSD* detectorSD = new DetectorSD(sdName, i);
+    sdManager->AddNewDetector(detectorSD);
+    SetSensitiveDetector(detectorLVs[i], detectorSD);
+  }
+  
+  // The lattice covers the whole beamline, so it goes on the world volume
+  // and replaces the solenoid and RF cavity fields below. The field
+  // managers set the accuracy per track, so they are our own rather than
+  // the global one, and the world carries the one covering everything.
+  if (fLattice->IsEnabled()) {
+    BeamlineField* beamlineField = fLattice->CreateField();
+    G4AutoDelete::Register(beamlineField);
+    G4FieldManager* beamlineFieldMgr = fSolenoidIntegration->CreateFieldManager();
+    fWorldLV->SetFieldManager(beamlineFieldMgr, true);
+    fSolenoidIntegration->Configure(beamlineFieldMgr, beamlineField,
+                                    !beamlineField->DoesFieldChangeEnergy());
+    return;
+  }
+  
   // Create global magnetic field
   fMagneticField = new MagneticField();
-  
-  // Create global field manager
-  G4FieldManager* globalFieldMgr = G4TransportationManager::GetTransportationManager()->GetFieldManager();
-  
-  // Configure field manager with a chord finder
-  globalFieldMgr->SetDetectorField(fMagneticField);
-  G4MagIntegratorStepper* stepper = new G4ClassicalRK4(new G4EqMagElectricField(fMagneticField));
-  G4double minStep = 0.01*mm;
-  
-  G4MagInt_Driver* driver = new G4MagInt_Driver(minStep, stepper, stepper->GetNumberOfVariables());
-  G4ChordFinder* chordFinder = new G4ChordFinder(driver);
-  globalFieldMgr->SetChordFinder(chordFinder);
+  G4AutoDelete::Register(fMagneticField);
+  if (fUseFieldMaps) {
+    fMagneticField->SetFieldMap(GetSolenoidMap());
+  }
+  
+  // Solenoid field manager with the configured stepper
+  G4FieldManager* solenoidFieldMgr = fSolenoidIntegration->CreateFieldManager();
+  if (fUseEnvelope) {
+    // Only the envelope and its daughters see the field; elsewhere the
+    // global field manager has no field and tracks go straight
+    fSolenoidLV->SetFieldManager(solenoidFieldMgr, true);
+  } else {
+    fWorldLV->SetFieldManager(solenoidFieldMgr, true);
+  }
+  
+  if (fCacheDistance > 0.) {
+    CachedField* cachedField = new CachedField(fMagneticField, fCacheDistance);
+    G4AutoDelete::Register(cachedField);
+    fSolenoidIntegration->Configure(solenoidFieldMgr, cachedField, true);
+  } else {
+    fSolenoidIntegration->Configure(solenoidFieldMgr, fMagneticField, true);
+  }
+  
+  if (fRFMode == "off") {
+    return;
+  }
   
   // Create RF cavity field
   fRFField = new RFCavityField();
-  
-  // Create local field manager for RF cavity
-  G4FieldManager* rfFieldManager = new G4FieldManager();
-  rfFieldManager->SetDetectorField(fRFField);
-  
-  // Configure RF cavity field manager with appropriate chord finder
-  G4MagIntegratorStepper* rfStepper = new G4ClassicalRK4(new G4EqMagElectricField(fRFField));
-  G4MagInt_Driver* rfDriver = new G4MagInt_Driver(minStep, rfStepper, rfStepper->GetNumberOfVariables());
-  G4ChordFinder* rfChordFinder = new G4ChordFinder(rfDriver);
-  rfFieldManager->SetChordFinder(rfChordFinder);
-  
-  // Assign field manager to RF cavity logical volume
+  G4AutoDelete::Register(fRFField);
+  fRFField->SetModel(GetRFModel());
+  if (fRFTable) {
+    fRFField->SetFieldMap(GetRFMap());
+  }
+  fRFField->SetPhaseCache(fRFPhaseCache);
+  
+  if (fRFMode == "kick") {
+    // One transit-time kick per crossing of the gap instead of tracking
+    // through the oscillating field; the model is owned by the region's
+    // fast simulation manager
+    G4Region* rfRegion = fRFGapLV->GetRegion();
+    new RFKickModel("RFKickModel", rfRegion, fRFField);
+    return;
+  }
+  
+  // The cavity sits inside the solenoid, so its local field manager
+  // carries the sum of both fields
+  CompositeField* cavityField = new CompositeField(fMagneticField, fRFField);
+  G4AutoDelete::Register(cavityField);
+  
+  // Create local field manager for RF cavity, integrating energy and time
+  G4FieldManager* rfFieldManager = fRFIntegration->CreateFieldManager();
+  fRFIntegration->Configure(rfFieldManager, cavityField, false);
+  
+  // Assign field manager to RF cavity and gap logical volumes, overriding
+  // the solenoid manager they inherit from the envelope
   fRFCavityLV->SetFieldManager(rfFieldManager, true);
+  fRFGapLV->SetFieldManager(rfFieldManager, true);
 }
\ No newline at end of file
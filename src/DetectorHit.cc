@@ -0,0 +1,22 @@
+// ==========================
+// src/DetectorHit.cc
+// ==========================
+
+#include "DetectorHit.hh"
+
+G4ThreadLocal G4Allocator<DetectorHit>* DetectorHitAllocator = nullptr;
+
+DetectorHit::DetectorHit()
+: G4VHit(),
+  fTrackID(-1),
+  fSpecies(kOtherSpecies),
+  fKineticEnergy(0.),
+  fPosition(),
+  fMomentum(),
+  fEdep(0.)
+{
+}
+
+DetectorHit::~DetectorHit()
+{
+}
@@ -0,0 +1,68 @@
+// ==========================
+// src/DetectorSD.cc
+// ==========================
+
+#include "DetectorSD.hh"
+#include "StepTrace.hh"
+#include "G4HCofThisEvent.hh"
+#include "G4SDManager.hh"
+#include "G4Step.hh"
+#include "G4StepPoint.hh"
+#include "G4Track.hh"
+
+DetectorSD::DetectorSD(const G4String& name, G4int detectorIndex)
+: G4VSensitiveDetector(name),
+  fDetectorIndex(detectorIndex),
+  fStepTrace(StepTrace::Instance()),
+  fHitsCollectionID(-1),
+  fHitsCollection(nullptr)
+{
+  collectionName.insert("HitsCollection");
+}
+
+DetectorSD::~DetectorSD()
+{
+}
+
+void DetectorSD::Initialize(G4HCofThisEvent* hce)
+{
+  fHitsCollection = new DetectorHitsCollection(SensitiveDetectorName, collectionName[0]);
+  
+  if (fHitsCollectionID < 0) {
+    fHitsCollectionID = G4SDManager::GetSDMpointer()->GetCollectionID(fHitsCollection);
+  }
+  hce->AddHitsCollection(fHitsCollectionID, fHitsCollection);
+  
+  fTrackHits.clear();
+}
+
+G4bool DetectorSD::ProcessHits(G4Step* step, G4TouchableHistory*)
+{
+  fStepTrace->Trace(step, StepTrace::kDetectorHit);
+  
+  G4Track* track = step->GetTrack();
+  G4int trackID = track->GetTrackID();
+  
+  // Later steps of a track already seen only add their deposit
+  auto found = fTrackHits.find(trackID);
+  if (found != fTrackHits.end()) {
+    found->second->AddEdep(step->GetTotalEnergyDeposit());
+    return true;
+  }
+  
+  // First step of this track in the plane: record its entry point
+  G4StepPoint* prePoint = step->GetPreStepPoint();
+  
+  DetectorHit* hit = new DetectorHit();
+  hit->SetTrackID(trackID);
+  hit->SetSpecies(VolumeRoleTable::Instance()->GetSpecies(track->GetDefinition()));
+  hit->SetKineticEnergy(prePoint->GetKineticEnergy());
+  hit->SetPosition(prePoint->GetPosition());
+  hit->SetMomentum(prePoint->GetMomentum());
+  hit->AddEdep(step->GetTotalEnergyDeposit());
+  
+  fHitsCollection->insert(hit);
+  fTrackHits[trackID] = hit;
+  
+  return true;
+}
@@ -0,0 +1,457 @@
+// ==========================
+// src/EventOutput.cc
+// ==========================
+
+#include "EventOutput.hh"
+#include "AsyncWriter.hh"
+#include "G4GenericMessenger.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4Threading.hh"
+#include "G4ios.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+namespace {
+  const char* const kStreamNames[] = { "trajectory_data", "particle_data" };
+  const char* const kHeaders[] = {
+    "EventID,Detector,X,PX,Y,PY,Z,PZ",
+    "EventID,Detector,ParticleName,Energy"
+  };
+  
+  // Room for the longest row: an event ID, two names and six numbers
+  const std::size_t kMaxRow = 256;
+  
+  const G4int kDefaultBufferSize = 1024;
+  const G4int kDefaultRowGroupSize = 65536;
+  const G4int kDefaultQueueDepth = 1024;
+  const G4int kDefaultQueueMemory = 64;
+  const G4int kDefaultFlushInterval = 16;
+  
+  // Shard closed by a worker, waiting for the master
+  struct Shard
+  {
+    G4String fileName;
+    G4int threadID;
+    std::uint64_t rows;
+    std::uint64_t bytes;
+    std::uint64_t writes;
+    G4bool columnar;
+    G4bool compressed;
+    std::uint64_t fileBytes;      // On disk, after compression
+    G4double compressTime;        // In deflate, in seconds
+  };
+  
+  std::mutex gShardsMutex;
+  std::vector<Shard> gShards[2];
+  
+  // The first merge of the session starts the final files over, with their
+  // header; later runs append to them. Plain and gzip files are counted apart
+  G4bool gFinalFileStarted[2][2] = { { false, false }, { false, false } };
+  
+  // Rows written to the ntuples by all threads in the run
+  std::uint64_t gNtupleRows[2] = { 0, 0 };
+  
+  // Append a formatted row, clipped to the space reserved for it
+  template <class... Args>
+  void AppendRow(BufferedFile& file, const char* format, Args... args)
+  {
+    char* row = file.Reserve(kMaxRow);
+    G4int size = std::snprintf(row, kMaxRow, format, args...);
+    file.Commit(std::min(static_cast<std::size_t>(std::max(size, 0)), kMaxRow - 1));
+  }
+}
+
+EventOutput* EventOutput::Instance()
+{
+  static G4ThreadLocal EventOutput* instance = nullptr;
+  if (!instance) {
+    instance = new EventOutput();
+  }
+  return instance;
+}
+
+EventOutput::EventOutput()
+: fChannel(nullptr),
+  fRows(),
+  fRunID(0),
+  fShardsOpened(false),
+  fBufferSize(kDefaultBufferSize),
+  fMerge(true),
+  fFormat("csv"),
+  fRowGroupSize(kDefaultRowGroupSize),
+  fDoublePrecision(false),
+  fNtupleType("root"),
+  fNtupleFile("beamtest_output"),
+  fAsync(false),
+  fQueueDepth(kDefaultQueueDepth),
+  fQueueMemory(kDefaultQueueMemory),
+  fCompression(0),
+  fFlushInterval(kDefaultFlushInterval),
+  fMessenger(nullptr)
+{
+  fMessenger = new G4GenericMessenger(this, "/beamTest/output/", "Event output files");
+  
+  fMessenger->DeclareProperty("bufferSize", fBufferSize,
+    "Write buffer of each per-thread shard file, in kB")
+    .SetParameterName("kB", false)
+    .SetRange("kB>0");
+  
+  fMessenger->DeclareProperty("merge", fMerge,
+    "Merge the per-thread shards into the final files at end of run, "
+    "or keep them and write a manifest listing them")
+    .SetParameterName("merge", false);
+  
+  fMessenger->DeclareProperty("format", fFormat,
+    "Output: csv; columnar binary phase-space files (.bps) for the trajectory "
+    "rows, with the particle file in CSV; or ntuple, both as G4AnalysisManager ntuples")
+    .SetParameterName("format", false)
+    .SetCandidates("csv columnar ntuple");
+  
+  fMessenger->DeclareProperty("rowGroupSize", fRowGroupSize,
+    "Rows per row group of the columnar format")
+    .SetParameterName("rows", false)
+    .SetRange("rows>0");
+  
+  fMessenger->DeclareProperty("doublePrecision", fDoublePrecision,
+    "Store the columnar phase-space values as double rather than float")
+    .SetParameterName("double", false);
+  
+  fMessenger->DeclareProperty("ntupleType", fNtupleType,
+    "File type of the ntuple format: csv, root (worker ntuples merged), xml, "
+    "or hdf5 when Geant4 was built with HDF5")
+    .SetParameterName("type", false)
+    .SetCandidates("csv root xml hdf5");
+  
+  fMessenger->DeclareProperty("ntupleFile", fNtupleFile,
+    "Base name of the ntuple files; the run number and type are appended")
+    .SetParameterName("name", false);
+  
+  fMessenger->DeclareProperty("async", fAsync,
+    "Format and write the csv and columnar output on a writer thread, fed "
+    "by a queue per worker")
+    .SetParameterName("async", false);
+  
+  fMessenger->DeclareProperty("queueDepth", fQueueDepth,
+    "Events per worker queue of the writer thread (rounded up to a power of "
+    "two); fixed once a worker has queued its first event")
+    .SetParameterName("events", false)
+    .SetRange("events>0");
+  
+  fMessenger->DeclareProperty("queueMemory", fQueueMemory,
+    "Memory per worker queue, in MB; a worker waits while its queue holds more")
+    .SetParameterName("MB", false)
+    .SetRange("MB>0");
+  
+  fMessenger->DeclareProperty("compression", fCompression,
+    "gzip level of the csv files, 1 (fastest) to 9 (smallest), or 0 to write "
+    "them plain; takes effect at the next run")
+    .SetParameterName("level", false)
+    .SetRange("level>=0 && level<=9");
+  
+  fMessenger->DeclareProperty("flushInterval", fFlushInterval,
+    "Data written between syncs of each gzip stream to its file, in MB, so a "
+    "crash loses at most this much; 0 syncs only at end of run")
+    .SetParameterName("MB", false)
+    .SetRange("MB>=0");
+}
+
+EventOutput::~EventOutput()
+{
+  delete fMessenger;
+}
+
+void EventOutput::OpenShards()
+{
+  fShardsOpened = true;
+  
+  G4int threadID = std::max(G4Threading::G4GetThreadId(), 0);
+  std::size_t bufferSize = static_cast<std::size_t>(fBufferSize) * 1024;
+  for (G4int s = 0; s < kNumStreams; ++s) {
+    fRows[s] = 0;
+    G4String fileName = G4String(kStreamNames[s]) + "_run" + std::to_string(fRunID)
+                      + "_t" + std::to_string(threadID);
+    
+    G4bool opened;
+    if (s == kTrajectory && fFormat == "columnar") {
+      fileName += ".bps";
+      opened = fPhaseSpace.Open(fileName, fRowGroupSize, fDoublePrecision, bufferSize);
+    } else {
+      fileName += (fCompression > 0) ? ".csv.gz" : ".csv";
+      opened = fShards[s].Open(fileName, bufferSize, fCompression,
+                               static_cast<std::size_t>(fFlushInterval) * 1048576);
+    }
+    if (!opened) {
+      G4cerr << "Error opening " << fileName << G4endl;
+    }
+  }
+}
+
+void EventOutput::WriteEvent(G4int eventID, const DetectorHitsCollection* const hits[kNumDetectors])
+{
+  // Shards are only needed when the ntuples are not in use
+  if (!fShardsOpened && !fNtuples.IsOpen()) OpenShards();
+  
+  G4bool async = fAsync && !fNtuples.IsOpen();
+  if (async && !fChannel) {
+    fChannel = AsyncWriter::Instance()->Connect(this, fQueueDepth);
+    if (fChannel) {
+      fChannel->SetBudget(static_cast<std::size_t>(fQueueMemory) * 1048576);
+    }
+  }
+  async = async && fChannel;
+  
+  OutputEvent* event = async ? fChannel->Acquire() : &fEvent;
+  event->eventID = eventID;
+  event->hits.clear();
+  for (G4int i = 0; i < kNumDetectors; ++i) {
+    if (!hits[i]) continue;
+    
+    for (std::size_t h = 0; h < hits[i]->entries(); ++h) {
+      const DetectorHit* hit = (*hits[i])[h];
+      const G4ThreeVector& pos = hit->GetPosition();
+      const G4ThreeVector& mom = hit->GetMomentum();
+      event->hits.push_back({ i, hit->GetSpecies(),
+                              { pos.x()/cm, mom.x()/(GeV/c_light),
+                                pos.y()/cm, mom.y()/(GeV/c_light),
+                                pos.z()/cm, mom.z()/(GeV/c_light) },
+                              hit->GetKineticEnergy()/GeV });
+    }
+  }
+  
+  if (async) {
+    fChannel->Push(event);
+  } else {
+    WriteRecords(*event);
+  }
+}
+
+void EventOutput::WriteRecords(const OutputEvent& event)
+{
+  // Rows are formatted as the streams formatted them, with six significant digits
+  BufferedFile& trajectory = fShards[kTrajectory];
+  BufferedFile& particle = fShards[kParticle];
+  for (const OutputHit& hit : event.hits) {
+    const char* detName = VolumeRoleTable::GetDetectorName(hit.detector);
+    const G4double* values = hit.values;
+    
+    if (trajectory.IsOpen()) {
+      AppendRow(trajectory, "%d,%s,%g,%g,%g,%g,%g,%g\n", event.eventID, detName,
+                values[0], values[1], values[2], values[3], values[4], values[5]);
+      ++fRows[kTrajectory];
+    } else if (fPhaseSpace.IsOpen()) {
+      fPhaseSpace.Add(event.eventID, hit.detector, hit.species, values);
+    } else if (fNtuples.IsOpen()) {
+      fNtuples.AddTrajectory(event.eventID, detName, values);
+    }
+    
+    // Only muons and pions go to the particle file
+    if (!VolumeRoleTable::IsMuonOrPion(hit.species)) continue;
+    const char* particleName = VolumeRoleTable::GetSpeciesName(hit.species);
+    if (particle.IsOpen()) {
+      AppendRow(particle, "%d,%s,%s,%g\n", event.eventID, detName, particleName, hit.energy);
+      ++fRows[kParticle];
+    } else if (fNtuples.IsOpen()) {
+      fNtuples.AddParticle(event.eventID, detName, particleName, hit.energy);
+    }
+  }
+}
+
+void EventOutput::BeginOfRun(G4int runID)
+{
+  fRunID = runID;
+  
+  if (fChannel) {
+    fChannel->SetBudget(static_cast<std::size_t>(fQueueMemory) * 1048576);
+    fChannel->ResetStatistics();
+  }
+  
+  // The master opens the ntuple file too, to receive the merged rows
+  if (fFormat == "ntuple") {
+    fNtuples.Open(fNtupleFile + "_run" + std::to_string(runID), fNtupleType);
+  }
+}
+
+void EventOutput::EndOfRun()
+{
+  if (fNtuples.IsOpen()) {
+    {
+      std::lock_guard<std::mutex> lock(gShardsMutex);
+      for (G4int s = 0; s < kNumStreams; ++s) {
+        gNtupleRows[s] += fNtuples.GetRows(s);
+      }
+    }
+    fNtuples.Close();
+  }
+  
+  if (!fShardsOpened) return;
+  fShardsOpened = false;
+  
+  // The writer thread is done with the shards once the queue is drained
+  if (fChannel) {
+    fChannel->Drain();
+  }
+  
+  G4int threadID = std::max(G4Threading::G4GetThreadId(), 0);
+  std::lock_guard<std::mutex> lock(gShardsMutex);
+  for (G4int s = 0; s < kNumStreams; ++s) {
+    if (fShards[s].IsOpen()) {
+      G4bool compressed = fShards[s].IsCompressed();
+      fShards[s].Close();
+      gShards[s].push_back({ fShards[s].GetFileName(), threadID, fRows[s],
+                             fShards[s].GetBytes(), fShards[s].GetWrites(), false,
+                             compressed, fShards[s].GetFileBytes(),
+                             fShards[s].GetCompressTime() });
+    }
+  }
+  if (fPhaseSpace.IsOpen()) {
+    fPhaseSpace.Close();
+    gShards[kTrajectory].push_back({ fPhaseSpace.GetFileName(), threadID, fPhaseSpace.GetRows(),
+                                     fPhaseSpace.GetBytes(), fPhaseSpace.GetWrites(), true,
+                                     false, fPhaseSpace.GetBytes(), 0. });
+  }
+}
+
+void EventOutput::MergeShards(G4int runID)
+{
+  std::lock_guard<std::mutex> lock(gShardsMutex);
+  
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "                          EVENT OUTPUT                          " << G4endl;
+  G4cout << "================================================================" << G4endl;
+  G4cout << std::setw(15) << "Stream" << " | " 
+         << std::setw(6) << "Shards" << " | " 
+         << std::setw(10) << "Rows" << " | " 
+         << std::setw(8) << "MB" << " | " 
+         << std::setw(7) << "Writes" << " | " 
+         << std::setw(9) << "Merge [s]" << G4endl;
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  
+  for (G4int s = 0; s < kNumStreams; ++s) {
+    std::vector<Shard>& shards = gShards[s];
+    
+    // Rows that went to the ntuples; their files are the analysis manager's
+    if (shards.empty() && fFormat == "ntuple") {
+      G4cout << std::setw(15) << kStreamNames[s] << " | " 
+             << std::setw(6) << "-" << " | " 
+             << std::setw(10) << gNtupleRows[s] << G4endl;
+      G4cout << std::setw(15) << "" << "   -> ntuple " << NtupleOutput::kNtupleNames[s] << " in "
+             << fNtupleFile << "_run" << runID << "." << fNtupleType << G4endl;
+      gNtupleRows[s] = 0;
+      continue;
+    }
+    
+    std::sort(shards.begin(), shards.end(),
+      [](const Shard& a, const Shard& b) { return a.threadID < b.threadID; });
+    
+    G4bool columnar = !shards.empty() && shards.front().columnar;
+    G4bool compressed = !shards.empty() && shards.front().compressed;
+    
+    auto start = std::chrono::steady_clock::now();
+    G4String target;
+    if (fMerge && columnar) {
+      // Row groups are copied as they are, under a new index
+      target = G4String(kStreamNames[s]) + "_run" + std::to_string(runID) + ".bps";
+      std::vector<G4String> inputs;
+      for (const Shard& shard : shards) {
+        inputs.push_back(shard.fileName);
+      }
+      if (!PhaseSpaceWriter::Merge(target, inputs, static_cast<std::size_t>(fBufferSize) * 1024)) {
+        G4cerr << "Error merging into " << target << ", shards kept" << G4endl;
+        shards.clear();
+        continue;
+      }
+      for (const Shard& shard : shards) {
+        std::remove(shard.fileName.c_str());
+      }
+    } else if (fMerge) {
+      // gzip members concatenate into one gzip file, so the shards are
+      // appended as they are behind a header member of their own
+      target = G4String(kStreamNames[s]) + (compressed ? ".csv.gz" : ".csv");
+      G4bool& started = gFinalFileStarted[compressed][s];
+      if (!started) {
+        BufferedFile header;
+        if (header.Open(target, kMaxRow, compressed ? fCompression : 0)) {
+          header.Write(kHeaders[s], std::strlen(kHeaders[s]));
+          header.Write("\n", 1);
+          header.Close();
+          started = true;
+        }
+      }
+      std::ofstream file(target, std::ios::binary | std::ios::app);
+      if (!started || !file.is_open()) {
+        G4cerr << "Error opening " << target << ", shards kept" << G4endl;
+        shards.clear();
+        continue;
+      }
+      for (const Shard& shard : shards) {
+        if (shard.fileBytes > 0) {
+          std::ifstream in(shard.fileName, std::ios::binary);
+          file << in.rdbuf();
+        }
+        std::remove(shard.fileName.c_str());
+      }
+    } else {
+      target = G4String(kStreamNames[s]) + "_run" + std::to_string(runID) + ".manifest";
+      std::ofstream file(target, std::ios::trunc);
+      if (!file.is_open()) {
+        G4cerr << "Error opening " << target << G4endl;
+        shards.clear();
+        continue;
+      }
+      file << "# Shards of " << kStreamNames[s] << " from run " << runID << ", in thread order\n";
+      if (columnar) {
+        file << "format columnar\n";
+      } else {
+        file << (compressed ? "format csv.gz\n" : "format csv\n");
+        file << "header " << kHeaders[s] << '\n';
+      }
+      for (const Shard& shard : shards) {
+        file << "shard " << shard.fileName << ' ' << shard.rows << ' ' << shard.bytes << '\n';
+      }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    
+    std::uint64_t rows = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t writes = 0;
+    std::uint64_t fileBytes = 0;
+    G4double compressTime = 0.;
+    for (const Shard& shard : shards) {
+      rows += shard.rows;
+      bytes += shard.bytes;
+      writes += shard.writes;
+      fileBytes += shard.fileBytes;
+      compressTime += shard.compressTime;
+    }
+    G4cout << std::setw(15) << kStreamNames[s] << " | " 
+           << std::setw(6) << shards.size() << " | " 
+           << std::setw(10) << rows << " | " 
+           << std::setw(8) << bytes / 1048576. << " | " 
+           << std::setw(7) << writes << " | " 
+           << std::setw(9) << std::chrono::duration<G4double>(stop - start).count() << G4endl;
+    G4cout << std::setw(15) << "" << "   -> " << target << G4endl;
+    if (compressed) {
+      // Deflate time summed over the threads, and the rate of one thread
+      G4cout << std::setw(15) << "" << "   gzip: " << bytes / 1048576. << " MB -> "
+             << fileBytes / 1048576. << " MB, ratio "
+             << (fileBytes > 0 ? static_cast<G4double>(bytes) / fileBytes : 0.)
+             << ", deflate " << compressTime << " s ("
+             << (compressTime > 0. ? bytes / 1048576. / compressTime : 0.) << " MB/s)" << G4endl;
+    }
+    
+    shards.clear();
+  }
+  G4cout << "================================================================" << G4endl;
+  
+  if (fAsync) {
+    AsyncWriter::Instance()->PrintReport();
+  }
+}
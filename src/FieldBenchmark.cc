@@ -0,0 +1,668 @@
+// ===========================
+// src/FieldBenchmark.cc
+// ===========================
+
+#include "FieldBenchmark.hh"
+#include "BeamlineField.hh"
+#include "BesselTable.hh"
+#include "MagneticField.hh"
+#include "RFCavityField.hh"
+#include "FieldMap2D.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4ios.hh"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+namespace {
+  typedef std::array<G4double, 4> Point;
+  
+  const unsigned int kPointSeed = 20240917;
+  
+  // Sampling step along a track, about what RK substeps in the gap take
+  const G4double kTrackStep = 1.0*mm;
+  
+  // Points per GetFieldValues call, about what a batched stepper would pass
+  const G4int kBatchSize = 256;
+  
+  // Points of the batched benchmark, evaluated over and over; small enough
+  // that inputs and outputs stay in cache, as a stepper's batches would
+  const G4int kWorkingSet = 4096;
+  
+  // Points along straight, near-luminal tracks crossing the z range, with
+  // time advancing along each track as it does during integration
+  std::vector<Point> MakeTrackPoints(G4int nPoints, G4double rMax, G4double zMin, G4double zMax,
+                                     G4double period)
+  {
+    std::mt19937 engine(kPointSeed);
+    std::uniform_real_distribution<G4double> flat(0., 1.);
+    
+    std::vector<Point> points;
+    points.reserve(nPoints);
+    while (static_cast<G4int>(points.size()) < nPoints) {
+      G4double r0 = 0.9 * rMax * std::sqrt(flat(engine));
+      G4double phi = 2.*M_PI * flat(engine);
+      G4double slopeX = 0.05 * (2.*flat(engine) - 1.);
+      G4double slopeY = 0.05 * (2.*flat(engine) - 1.);
+      G4double beta = 0.9 + 0.1 * flat(engine);
+      G4double t0 = period * flat(engine);
+      G4double dsdz = std::sqrt(1. + slopeX*slopeX + slopeY*slopeY);
+      
+      for (G4double z = zMin; z < zMax && static_cast<G4int>(points.size()) < nPoints; z += kTrackStep) {
+        G4double dz = z - zMin;
+        Point point = {
+          r0*std::cos(phi) + slopeX*dz,
+          r0*std::sin(phi) + slopeY*dz,
+          z,
+          t0 + dz*dsdz/(beta*c_light)
+        };
+        points.push_back(point);
+      }
+    }
+    return points;
+  }
+  
+  // Ez at every point, and the time per call in ns
+  G4double TimeField(const G4ElectroMagneticField& field, const std::vector<Point>& points,
+                     std::vector<G4double>& ez)
+  {
+    ez.resize(points.size());
+    G4double value[6];
+    
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < points.size(); ++i) {
+      field.GetFieldValue(points[i].data(), value);
+      ez[i] = value[5];
+    }
+    auto stop = std::chrono::steady_clock::now();
+    
+    return std::chrono::duration<G4double, std::nano>(stop - start).count() / points.size();
+  }
+  
+  // Points and field values of a whole benchmark in structure-of-arrays layout
+  struct BatchData
+  {
+    std::vector<G4double> x, y, z, t;
+    std::vector<G4double> field[6];
+    
+    explicit BatchData(G4int n) : x(n), y(n), z(n), t(n) {
+      for (std::vector<G4double>& component : field) component.resize(n);
+    }
+    
+    FieldPoints Points(G4int offset) const {
+      return { &x[offset], &y[offset], &z[offset], &t[offset] };
+    }
+    FieldValues Values(G4int offset) {
+      return { &field[0][offset], &field[1][offset], &field[2][offset],
+               &field[3][offset], &field[4][offset], &field[5][offset] };
+    }
+  };
+  
+  // Uniform in a box around the beamline, so that the batches mix points
+  // inside and outside every field volume
+  void FillScattered(BatchData& data, G4double period)
+  {
+    std::mt19937 engine(kPointSeed);
+    std::uniform_real_distribution<G4double> transverse(-100.*cm, 100.*cm);
+    std::uniform_real_distribution<G4double> longitudinal(-300.*cm, 1100.*cm);
+    std::uniform_real_distribution<G4double> time(0., period);
+    
+    for (std::size_t i = 0; i < data.x.size(); ++i) {
+      data.x[i] = transverse(engine);
+      data.y[i] = transverse(engine);
+      data.z[i] = longitudinal(engine);
+      data.t[i] = time(engine);
+    }
+  }
+  
+  // Uniform over the volume of an axisymmetric field, so that lookups
+  // reach every part of its map
+  void FillInside(BatchData& data, const AxisymmetricField& source)
+  {
+    std::mt19937 engine(kPointSeed);
+    std::uniform_real_distribution<G4double> flat(0., 1.);
+    G4double rMax = source.GetMaxRadius();
+    
+    for (std::size_t i = 0; i < data.x.size(); ++i) {
+      G4double r = rMax * std::sqrt(flat(engine));
+      G4double phi = 2.*M_PI * flat(engine);
+      data.x[i] = r * std::cos(phi);
+      data.y[i] = r * std::sin(phi);
+      data.z[i] = source.GetZMin() + (source.GetZMax() - source.GetZMin()) * flat(engine);
+      data.t[i] = 0.;
+    }
+  }
+  
+  // One GetFieldValue call per point, nPasses over the data; time per point in ns
+  template <class Field>
+  G4double TimeScalar(const Field& field, BatchData& data, G4int nPasses)
+  {
+    G4int n = data.x.size();
+    G4double point[4];
+    G4double value[6];
+    
+    auto start = std::chrono::steady_clock::now();
+    for (G4int pass = 0; pass < nPasses; ++pass) {
+      for (G4int i = 0; i < n; ++i) {
+        point[0] = data.x[i];
+        point[1] = data.y[i];
+        point[2] = data.z[i];
+        point[3] = data.t[i];
+        field.GetFieldValue(point, value);
+        for (G4int c = 0; c < 6; ++c) {
+          data.field[c][i] = value[c];
+        }
+      }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    
+    return std::chrono::duration<G4double, std::nano>(stop - start).count() / (G4double(n) * nPasses);
+  }
+  
+  // GetFieldValues on consecutive batches, nPasses over the data; time per point in ns
+  template <class Field>
+  G4double TimeBatched(const Field& field, BatchData& data, G4int nPasses)
+  {
+    G4int n = data.x.size();
+    
+    auto start = std::chrono::steady_clock::now();
+    for (G4int pass = 0; pass < nPasses; ++pass) {
+      for (G4int offset = 0; offset < n; offset += kBatchSize) {
+        field.GetFieldValues(std::min(kBatchSize, n - offset), data.Points(offset), data.Values(offset));
+      }
+    }
+    auto stop = std::chrono::steady_clock::now();
+    
+    return std::chrono::duration<G4double, std::nano>(stop - start).count() / (G4double(n) * nPasses);
+  }
+  
+  // Largest component difference relative to the largest field magnitude
+  G4double MaxDeviation(const BatchData& reference, const BatchData& data)
+  {
+    G4double peak = 0.;
+    G4double maxDeviation = 0.;
+    for (G4int c = 0; c < 6; ++c) {
+      for (std::size_t i = 0; i < reference.field[c].size(); ++i) {
+        peak = std::max(peak, std::abs(reference.field[c][i]));
+        maxDeviation = std::max(maxDeviation, std::abs(data.field[c][i] - reference.field[c][i]));
+      }
+    }
+    return (peak > 0.) ? maxDeviation / peak : 0.;
+  }
+  
+  template <class Field>
+  void PrintBatchedRow(const char* name, const Field& field, BatchData& scalar, BatchData& batched,
+                       G4int nPasses)
+  {
+    // One untimed pass each, so neither path pays for cold caches
+    TimeScalar(field, scalar, 1);
+    G4double scalarTime = TimeScalar(field, scalar, nPasses);
+    TimeBatched(field, batched, 1);
+    G4double batchedTime = TimeBatched(field, batched, nPasses);
+    
+    G4cout << std::setw(18) << name << " | " 
+           << std::setw(10) << scalarTime << " | " 
+           << std::setw(10) << batchedTime << " | " 
+           << std::setw(8) << scalarTime / batchedTime << " | " 
+           << std::setw(10) << MaxDeviation(scalar, batched) << G4endl;
+  }
+  
+  // Map of the source in one storage policy: footprint, lookup times, the
+  // largest interpolation error of any component relative to its peak, and
+  // the deviation from the double map's values at the benchmark points
+  template <class Storage>
+  void PrintStorageRow(const char* name, const AxisymmetricField& source, G4int nR, G4int nZ,
+                       BatchData& data, const BatchData& reference)
+  {
+    FieldMap2DT<Storage> map(source, nR, nZ);
+    
+    TimeScalar(map, data, 1);
+    G4double scalarTime = TimeScalar(map, data, 1);
+    TimeBatched(map, data, 1);
+    G4double batchedTime = TimeBatched(map, data, 1);
+    
+    G4double peak[4];
+    G4double maxError[4];
+    G4double rmsError[4];
+    map.GetPeakValues(peak);
+    map.GetInterpolationError(source, maxError, rmsError);
+    G4double error = 0.;
+    for (G4int c = 0; c < 4; ++c) {
+      if (peak[c] > 0.) error = std::max(error, maxError[c] / peak[c]);
+    }
+    
+    G4cout << std::setw(8) << name << " | " 
+           << std::setw(7) << Storage::kName << " | " 
+           << std::setw(8) << map.GetMemoryUsage()/1024. << " | " 
+           << std::setw(7) << scalarTime << " | " 
+           << std::setw(8) << batchedTime << " | " 
+           << std::setw(9) << 100. * error << " | " 
+           << std::setw(9) << MaxDeviation(reference, data) << G4endl;
+  }
+  
+  // Root mean square component difference relative to the largest field magnitude
+  G4double RmsDeviation(const BatchData& reference, const BatchData& data)
+  {
+    G4double peak = 0.;
+    G4double sum2 = 0.;
+    for (G4int c = 0; c < 6; ++c) {
+      for (std::size_t i = 0; i < reference.field[c].size(); ++i) {
+        G4double deviation = data.field[c][i] - reference.field[c][i];
+        peak = std::max(peak, std::abs(reference.field[c][i]));
+        sum2 += deviation * deviation;
+      }
+    }
+    G4double rms = std::sqrt(sum2 / (6. * reference.x.size()));
+    return (peak > 0.) ? rms / peak : 0.;
+  }
+  
+  // The source's static field at the points, from its (r,z) components
+  void FillAnalytic(BatchData& data, const AxisymmetricField& source)
+  {
+    for (std::size_t i = 0; i < data.x.size(); ++i) {
+      G4double r = std::sqrt(data.x[i]*data.x[i] + data.y[i]*data.y[i]);
+      G4double cosPhi = (r > 0.) ? data.x[i] / r : 1.;
+      G4double sinPhi = (r > 0.) ? data.y[i] / r : 0.;
+      G4double fieldRZ[4];
+      source.GetFieldRZ(r, data.z[i], fieldRZ);
+      data.field[0][i] = fieldRZ[0] * cosPhi;
+      data.field[1][i] = fieldRZ[0] * sinPhi;
+      data.field[2][i] = fieldRZ[1];
+      data.field[3][i] = fieldRZ[2] * cosPhi;
+      data.field[4][i] = fieldRZ[2] * sinPhi;
+      data.field[5][i] = fieldRZ[3];
+    }
+  }
+  
+  // Map of the source on a uniform or adaptive z grid: grid size, footprint,
+  // lookup times, the rms error against the analytic field and the largest
+  // deviation from the reference map's values, both at the benchmark points
+  void PrintGridRow(const char* name, const char* grid, const AxisymmetricField& source,
+                    G4int nR, G4int nZ, G4double tolerance, BatchData& data,
+                    const BatchData& analytic, const BatchData& reference)
+  {
+    FieldMap2D map(source, nR, nZ, tolerance);
+    
+    TimeScalar(map, data, 1);
+    G4double scalarTime = TimeScalar(map, data, 1);
+    TimeBatched(map, data, 1);
+    G4double batchedTime = TimeBatched(map, data, 1);
+    
+    G4cout << std::setw(8) << name << " | " 
+           << std::setw(8) << grid << " | " 
+           << std::setw(5) << map.GetNPointsZ() << " | " 
+           << std::setw(4) << map.GetAxisZ().GetNSegments() << " | " 
+           << std::setw(8) << map.GetMemoryUsage()/1024. << " | " 
+           << std::setw(6) << scalarTime << " | " 
+           << std::setw(8) << batchedTime << " | " 
+           << std::setw(9) << 100. * RmsDeviation(analytic, data) << " | " 
+           << std::setw(9) << MaxDeviation(reference, data) << G4endl;
+  }
+  
+  // Points over the source's volume and the double map's values there
+  void FillStorageReference(BatchData& reference, const AxisymmetricField& source,
+                            G4int nR, G4int nZ)
+  {
+    FillInside(reference, source);
+    FieldMap2D map(source, nR, nZ);
+    TimeBatched(map, reference, 1);
+  }
+}
+
+void FieldBenchmark::RunRFCavity(std::shared_ptr<const RFFieldMap> table, RFCavityField::Model model,
+                                 G4int nPoints)
+{
+  RFCavityField analytic;
+  RFCavityField tabulated;
+  analytic.SetModel(model);
+  tabulated.SetModel(model);
+  tabulated.SetFieldMap(table);
+  
+  std::vector<Point> points = MakeTrackPoints(nPoints, analytic.GetMaxRadius(),
+                                              analytic.GetZMin(), analytic.GetZMax(),
+                                              2.*M_PI / analytic.GetAngularFrequency());
+  
+  struct Variant
+  {
+    const char* name;
+    RFCavityField* field;
+    G4bool phaseCache;
+  };
+  const Variant variants[] = {
+    { "analytic, cos",        &analytic,  false },
+    { "table, cos",           &tabulated, false },
+    { "analytic, recurrence", &analytic,  true },
+    { "table, recurrence",    &tabulated, true }
+  };
+  
+  // Warm up caches and the branch predictor on the reference path
+  std::vector<G4double> reference;
+  TimeField(analytic, points, reference);
+  G4double referenceTime = TimeField(analytic, points, reference);
+  G4double peak = 0.;
+  for (G4double value : reference) {
+    peak = std::max(peak, std::abs(value));
+  }
+  
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "                   RF FIELD EVALUATION BENCHMARK                 " << G4endl;
+  G4cout << "================================================================" << G4endl;
+  G4cout << " " << points.size() << " points along tracks, " << kTrackStep/mm
+         << " mm apart; deviation relative to peak |Ez|" << G4endl;
+  G4cout << std::setw(22) << "Variant" << " | " 
+         << std::setw(10) << "ns/call" << " | " 
+         << std::setw(10) << "Speedup" << " | " 
+         << std::setw(12) << "Max dev" << G4endl;
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  
+  std::vector<G4double> ez;
+  for (const Variant& variant : variants) {
+    variant.field->SetPhaseCache(variant.phaseCache);
+    G4double time = TimeField(*variant.field, points, ez);
+    
+    G4double maxDeviation = 0.;
+    for (std::size_t i = 0; i < ez.size(); ++i) {
+      maxDeviation = std::max(maxDeviation, std::abs(ez[i] - reference[i]));
+    }
+    
+    G4cout << std::setw(22) << variant.name << " | " 
+           << std::setw(10) << time << " | " 
+           << std::setw(10) << referenceTime / time << " | " 
+           << std::setw(12) << ((peak > 0.) ? maxDeviation / peak : 0.) << G4endl;
+  }
+  G4cout << "================================================================" << G4endl;
+}
+
+void FieldBenchmark::RunBatched(std::shared_ptr<const SolenoidFieldMap> solenoidMap,
+                                std::shared_ptr<const RFFieldMap> rfMap, G4int nPoints)
+{
+  MagneticField solenoid;
+  MagneticField solenoidMapped;
+  solenoidMapped.SetFieldMap(solenoidMap);
+  RFCavityField cavity;
+  RFCavityField cavityMapped;
+  cavityMapped.SetFieldMap(rfMap);
+  RFCavityField pillbox;
+  pillbox.SetModel(RFCavityField::kPillbox);
+  
+  BatchData scalar(std::min(nPoints, kWorkingSet));
+  FillScattered(scalar, 2.*M_PI / cavity.GetAngularFrequency());
+  BatchData batched = scalar;
+  G4int nPasses = std::max(1, nPoints / kWorkingSet);
+  
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "                 BATCHED FIELD EVALUATION BENCHMARK              " << G4endl;
+  G4cout << "================================================================" << G4endl;
+  G4cout << " " << scalar.x.size() << " scattered points x " << nPasses << " passes, batches of "
+         << kBatchSize << "; deviation relative to peak field" << G4endl;
+  G4cout << std::setw(18) << "Field" << " | " 
+         << std::setw(10) << "Scalar ns" << " | " 
+         << std::setw(10) << "Batch ns" << " | " 
+         << std::setw(8) << "Speedup" << " | " 
+         << std::setw(10) << "Max dev" << G4endl;
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  
+  PrintBatchedRow("solenoid analytic", solenoid, scalar, batched, nPasses);
+  PrintBatchedRow("solenoid map", solenoidMapped, scalar, batched, nPasses);
+  PrintBatchedRow("RF analytic", cavity, scalar, batched, nPasses);
+  PrintBatchedRow("RF table", cavityMapped, scalar, batched, nPasses);
+  PrintBatchedRow("RF pillbox", pillbox, scalar, batched, nPasses);
+  G4cout << "================================================================" << G4endl;
+}
+
+void FieldBenchmark::RunRFModels(G4int nPoints)
+{
+  RFCavityField gaussian;
+  RFCavityField pillbox;
+  pillbox.SetModel(RFCavityField::kPillbox);
+  
+  // Inside the pillbox, which is the narrower of the two
+  std::vector<Point> points = MakeTrackPoints(nPoints, pillbox.GetMaxRadius(),
+                                              pillbox.GetZMin(), pillbox.GetZMax(),
+                                              2.*M_PI / pillbox.GetAngularFrequency());
+  std::vector<G4double> ez;
+  TimeField(gaussian, points, ez);
+  G4double gaussianTime = TimeField(gaussian, points, ez);
+  
+  // The pillbox field with J0 and J1 from their series, the reference
+  G4double k = pillbox.GetAngularFrequency() / c_light;
+  G4double radius2 = pillbox.GetMaxRadius() * pillbox.GetMaxRadius();
+  std::vector<std::array<G4double, 6>> reference(points.size());
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < points.size(); ++i) {
+    const Point& point = points[i];
+    std::array<G4double, 6>& field = reference[i];
+    field.fill(0.);
+    G4double r2 = point[0]*point[0] + point[1]*point[1];
+    if (r2 > radius2 || point[2] < pillbox.GetZMin() || point[2] > pillbox.GetZMax()) continue;
+    
+    G4double j0;
+    G4double j1OverX;
+    BesselTable::Series(k*k*r2, j0, j1OverX);
+    G4double phase = pillbox.GetAngularFrequency() * point[3] + pillbox.GetPhase();
+    G4double bPhiOverR = -pillbox.GetAmplitude() * k / c_light * j1OverX * std::sin(phase);
+    field[0] = -bPhiOverR * point[1];
+    field[1] = bPhiOverR * point[0];
+    field[5] = pillbox.GetAmplitude() * j0 * std::cos(phase);
+  }
+  auto stop = std::chrono::steady_clock::now();
+  G4double seriesTime = std::chrono::duration<G4double, std::nano>(stop - start).count() / points.size();
+  
+  // Tabulated, timed as above, then compared field by field
+  TimeField(pillbox, points, ez);
+  G4double tableTime = TimeField(pillbox, points, ez);
+  G4double peakE = 0.;
+  G4double peakB = 0.;
+  G4double deviationE = 0.;
+  G4double deviationB = 0.;
+  G4double value[6];
+  for (std::size_t i = 0; i < points.size(); ++i) {
+    pillbox.GetFieldValue(points[i].data(), value);
+    const std::array<G4double, 6>& field = reference[i];
+    peakE = std::max(peakE, std::abs(field[5]));
+    peakB = std::max(peakB, std::hypot(field[0], field[1]));
+    deviationE = std::max(deviationE, std::abs(value[5] - field[5]));
+    deviationB = std::max(deviationB, std::hypot(value[0] - field[0], value[1] - field[1]));
+  }
+  
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "                    RF CAVITY MODEL BENCHMARK                    " << G4endl;
+  G4cout << "================================================================" << G4endl;
+  G4cout << " " << points.size() << " points along tracks, " << kTrackStep/mm
+         << " mm apart, within the pillbox radius of " << pillbox.GetMaxRadius()/cm << " cm;"
+         << G4endl;
+  G4cout << " BesselTable of " << BesselTable::Instance().GetNPoints()
+         << " points; deviation relative to peak |E| and |B|" << G4endl;
+  G4cout << std::setw(18) << "Model" << " | " 
+         << std::setw(10) << "ns/call" << " | " 
+         << std::setw(12) << "Max dev E" << " | " 
+         << std::setw(12) << "Max dev B" << G4endl;
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  G4cout << std::setw(18) << "gaussian" << " | " 
+         << std::setw(10) << gaussianTime << " | " 
+         << std::setw(12) << "-" << " | " 
+         << std::setw(12) << "-" << G4endl;
+  G4cout << std::setw(18) << "pillbox, series" << " | " 
+         << std::setw(10) << seriesTime << " | " 
+         << std::setw(12) << 0. << " | " 
+         << std::setw(12) << 0. << G4endl;
+  G4cout << std::setw(18) << "pillbox, table" << " | " 
+         << std::setw(10) << tableTime << " | " 
+         << std::setw(12) << ((peakE > 0.) ? deviationE / peakE : 0.) << " | " 
+         << std::setw(12) << ((peakB > 0.) ? deviationB / peakB : 0.) << G4endl;
+  G4cout << "================================================================" << G4endl;
+}
+
+void FieldBenchmark::RunBeamline(G4int nPoints)
+{
+  // Each cell holds a solenoid section overlapping its neighbours' by 20 cm
+  // and an RF cavity between sections
+  const G4double cellLength = 200.*cm;
+  const G4int cellCounts[] = { 1, 10, 100, 1000 };
+  
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "                 BEAMLINE FIELD LOOKUP BENCHMARK                 " << G4endl;
+  G4cout << "================================================================" << G4endl;
+  G4cout << " " << nPoints << " points per lattice within r < 30 cm, in random z order"
+         << " and in z order as along a track" << G4endl;
+  G4cout << std::setw(6) << "Cells" << " | " 
+         << std::setw(8) << "Elements" << " | " 
+         << std::setw(8) << "Segments" << " | " 
+         << std::setw(8) << "Overlap" << " | " 
+         << std::setw(10) << "Random ns" << " | " 
+         << std::setw(10) << "Track ns" << G4endl;
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  
+  for (G4int nCells : cellCounts) {
+    BeamlineField beamline;
+    for (G4int cell = 0; cell < nCells; ++cell) {
+      G4double zCentre = (cell + 0.5) * cellLength;
+      beamline.AddElement(new MagneticField(2.*tesla, zCentre - 110.*cm, zCentre + 110.*cm,
+                                            20.*cm, 60.*cm),
+                          zCentre - 110.*cm, zCentre + 110.*cm, 60.*cm);
+      G4double zCavity = (cell + 1) * cellLength;
+      beamline.AddElement(new RFCavityField(1.*megavolt/m, 201.*megahertz, 0.,
+                                            zCavity - 15.*cm, zCavity + 15.*cm, 40.*cm),
+                          zCavity - 15.*cm, zCavity + 15.*cm, 40.*cm);
+    }
+    beamline.BuildIndex();
+    
+    std::mt19937 engine(kPointSeed);
+    std::uniform_real_distribution<G4double> flat(0., 1.);
+    std::vector<Point> points(nPoints);
+    for (Point& point : points) {
+      G4double r = 30.*cm * std::sqrt(flat(engine));
+      G4double phi = 2.*M_PI * flat(engine);
+      point = { r*std::cos(phi), r*std::sin(phi), nCells * cellLength * flat(engine), 0. };
+    }
+    
+    // Untimed pass first, as for the other benchmarks
+    std::vector<G4double> ez;
+    TimeField(beamline, points, ez);
+    G4double randomTime = TimeField(beamline, points, ez);
+    
+    std::sort(points.begin(), points.end(),
+              [](const Point& a, const Point& b) { return a[2] < b[2]; });
+    G4double trackTime = TimeField(beamline, points, ez);
+    
+    G4cout << std::setw(6) << nCells << " | " 
+           << std::setw(8) << beamline.GetNumberOfElements() << " | " 
+           << std::setw(8) << beamline.GetNumberOfSegments() << " | " 
+           << std::setw(8) << beamline.GetMeanOverlap() << " | " 
+           << std::setw(10) << randomTime << " | " 
+           << std::setw(10) << trackTime << G4endl;
+  }
+  G4cout << "================================================================" << G4endl;
+}
+
+void FieldBenchmark::RunStorage(G4int solenoidPointsR, G4int solenoidPointsZ,
+                                G4int rfPointsR, G4int rfPointsZ, G4int nPoints)
+{
+  MagneticField solenoid;
+  RFCavityField cavity;
+  
+  BatchData solenoidReference(nPoints);
+  FillStorageReference(solenoidReference, solenoid, solenoidPointsR, solenoidPointsZ);
+  BatchData solenoidPoints = solenoidReference;
+  BatchData cavityReference(nPoints);
+  FillStorageReference(cavityReference, cavity, rfPointsR, rfPointsZ);
+  BatchData cavityPoints = cavityReference;
+  
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "                  FIELD MAP STORAGE BENCHMARK                   " << G4endl;
+  G4cout << "================================================================" << G4endl;
+  G4cout << " " << nPoints << " points uniform over each map" << G4endl
+         << " Error: largest error at the cell centres against the analytic field," << G4endl
+         << "   of any component, relative to its peak" << G4endl
+         << " Vs double: largest deviation from the double map at the points," << G4endl
+         << "   relative to the peak field" << G4endl;
+  G4cout << std::setw(8) << "Field" << " | " 
+         << std::setw(7) << "Storage" << " | " 
+         << std::setw(8) << "kB" << " | " 
+         << std::setw(7) << "ns" << " | " 
+         << std::setw(8) << "Batch ns" << " | " 
+         << std::setw(9) << "Error %" << " | " 
+         << std::setw(9) << "Vs double" << G4endl;
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  
+  PrintStorageRow<DoubleStorage>("solenoid", solenoid, solenoidPointsR, solenoidPointsZ,
+                                 solenoidPoints, solenoidReference);
+  PrintStorageRow<FloatStorage>("solenoid", solenoid, solenoidPointsR, solenoidPointsZ,
+                                solenoidPoints, solenoidReference);
+  PrintStorageRow<QuantizedStorage>("solenoid", solenoid, solenoidPointsR, solenoidPointsZ,
+                                    solenoidPoints, solenoidReference);
+  PrintStorageRow<DoubleStorage>("RF", cavity, rfPointsR, rfPointsZ, cavityPoints, cavityReference);
+  PrintStorageRow<FloatStorage>("RF", cavity, rfPointsR, rfPointsZ, cavityPoints, cavityReference);
+  PrintStorageRow<QuantizedStorage>("RF", cavity, rfPointsR, rfPointsZ, cavityPoints, cavityReference);
+  G4cout << "================================================================" << G4endl;
+}
+
+void FieldBenchmark::RunAdaptiveGrid(G4int solenoidPointsR, G4int solenoidPointsZ,
+                                     G4int rfPointsR, G4int rfPointsZ, G4double tolerance,
+                                     G4int nPoints)
+{
+  MagneticField solenoid;
+  RFCavityField cavity;
+  
+  BatchData solenoidReference(nPoints);
+  FillStorageReference(solenoidReference, solenoid, solenoidPointsR, solenoidPointsZ);
+  BatchData solenoidPoints = solenoidReference;
+  BatchData cavityReference(nPoints);
+  FillStorageReference(cavityReference, cavity, rfPointsR, rfPointsZ);
+  BatchData cavityPoints = cavityReference;
+  BatchData solenoidAnalytic = solenoidReference;
+  FillAnalytic(solenoidAnalytic, solenoid);
+  BatchData cavityAnalytic = cavityReference;
+  FillAnalytic(cavityAnalytic, cavity);
+  
+  // Uniform grids with as many z points as the adaptive ones, for the error
+  // the same memory buys without adapting
+  G4int solenoidCoarseZ
+    = FieldMap2D(solenoid, solenoidPointsR, solenoidPointsZ, tolerance).GetNPointsZ();
+  G4int cavityCoarseZ = FieldMap2D(cavity, rfPointsR, rfPointsZ, tolerance).GetNPointsZ();
+  
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "               ADAPTIVE FIELD MAP GRID BENCHMARK                " << G4endl;
+  G4cout << "================================================================" << G4endl;
+  G4cout << " " << nPoints << " points uniform over each map, adaptive tolerance "
+         << tolerance << G4endl
+         << " Rms error: against the analytic static field at the points," << G4endl
+         << "   relative to the peak field" << G4endl
+         << " Vs fine: largest deviation from the fine uniform map at the points," << G4endl
+         << "   relative to the peak field" << G4endl;
+  G4cout << std::setw(8) << "Field" << " | " 
+         << std::setw(8) << "Grid" << " | " 
+         << std::setw(5) << "z pts" << " | " 
+         << std::setw(4) << "Segs" << " | " 
+         << std::setw(8) << "kB" << " | " 
+         << std::setw(6) << "ns" << " | " 
+         << std::setw(8) << "Batch ns" << " | " 
+         << std::setw(9) << "Rms err %" << " | " 
+         << std::setw(9) << "Vs fine" << G4endl;
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  
+  PrintGridRow("solenoid", "uniform", solenoid, solenoidPointsR, solenoidPointsZ, 0.,
+               solenoidPoints, solenoidAnalytic, solenoidReference);
+  PrintGridRow("solenoid", "adaptive", solenoid, solenoidPointsR, solenoidPointsZ, tolerance,
+               solenoidPoints, solenoidAnalytic, solenoidReference);
+  PrintGridRow("solenoid", "coarse", solenoid, solenoidPointsR, solenoidCoarseZ, 0.,
+               solenoidPoints, solenoidAnalytic, solenoidReference);
+  PrintGridRow("RF", "uniform", cavity, rfPointsR, rfPointsZ, 0.,
+               cavityPoints, cavityAnalytic, cavityReference);
+  PrintGridRow("RF", "adaptive", cavity, rfPointsR, rfPointsZ, tolerance,
+               cavityPoints, cavityAnalytic, cavityReference);
+  PrintGridRow("RF", "coarse", cavity, rfPointsR, cavityCoarseZ, 0.,
+               cavityPoints, cavityAnalytic, cavityReference);
+  G4cout << "================================================================" << G4endl;
+}
@@ -0,0 +1,296 @@
+// =============================
+// src/FieldIntegration.cc
+// =============================
+
+#include "FieldIntegration.hh"
+#include "TrackAccuracyFieldManager.hh"
+#include "CountingStepper.hh"
+
+#include "G4ElectroMagneticField.hh"
+#include "G4Mag_UsualEqRhs.hh"
+#include "G4EqMagElectricField.hh"
+#include "G4ClassicalRK4.hh"
+#include "G4DormandPrince745.hh"
+#include "G4BogackiShampine45.hh"
+#include "G4ExactHelixStepper.hh"
+#include "G4MagIntegratorDriver.hh"
+#include "G4InterpolationDriver.hh"
+#include "G4ChordFinder.hh"
+#include "G4FieldManager.hh"
+#include "G4GenericMessenger.hh"
+#include "G4UIcommand.hh"
+#include "G4SystemOfUnits.hh"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+const char* const FieldIntegration::kStepperNames[] = {
+  "ClassicalRK4", "DormandPrince745", "BogackiShampine45", "ExactHelix"
+};
+const G4int FieldIntegration::kNumSteppers = 4;
+
+FieldIntegration::FieldIntegration(const G4String& name)
+: fName(name),
+  fStepperName("ClassicalRK4"),
+  fMinStep(0.01*mm),
+  // Geant4 defaults
+  fDeltaChord(0.25*mm),
+  fDeltaOneStep(0.01*mm),
+  fDeltaIntersection(0.001*mm),
+  fEpsilonMin(5.0e-5),
+  fEpsilonMax(1.0e-3),
+  fPerTrackAccuracy(false),
+  fTableVersion(0),
+  fMessenger(nullptr)
+{
+  G4String directory = "/beamTest/field/" + name + "/";
+  fMessenger = new G4GenericMessenger(this, directory, "Integration in the " + name + " field");
+  
+  // Read when the field managers are built, so all of these must precede /run/initialize
+  G4String candidates;
+  for (G4int i = 0; i < kNumSteppers; ++i) {
+    if (i > 0) candidates += " ";
+    candidates += kStepperNames[i];
+  }
+  fMessenger->DeclareProperty("stepper", fStepperName,
+    "Integration stepper (set before /run/initialize)")
+    .SetParameterName("stepper", false)
+    .SetCandidates(candidates)
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclarePropertyWithUnit("minStep", "mm", fMinStep,
+    "Smallest step the integration driver attempts")
+    .SetParameterName("length", false)
+    .SetRange("length>0.")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclarePropertyWithUnit("deltaChord", "mm", fDeltaChord,
+    "Largest allowed distance between chord and trajectory")
+    .SetParameterName("length", false)
+    .SetRange("length>0.")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclarePropertyWithUnit("deltaOneStep", "mm", fDeltaOneStep,
+    "Position accuracy of the end point of a physics step")
+    .SetParameterName("length", false)
+    .SetRange("length>0.")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclarePropertyWithUnit("deltaIntersection", "mm", fDeltaIntersection,
+    "Accuracy of the intersection with a volume boundary")
+    .SetParameterName("length", false)
+    .SetRange("length>0.")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareProperty("epsilonMin", fEpsilonMin,
+    "Lower bound of the relative accuracy deltaOneStep/stepLength")
+    .SetParameterName("epsilon", false)
+    .SetRange("epsilon>0. && epsilon<1.")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareProperty("epsilonMax", fEpsilonMax,
+    "Upper bound of the relative accuracy deltaOneStep/stepLength")
+    .SetParameterName("epsilon", false)
+    .SetRange("epsilon>0. && epsilon<1.")
+    .SetToBeBroadcasted(false);
+  
+  // Read on every step, so these may change between runs
+  fMessenger->DeclareProperty("perTrackAccuracy", fPerTrackAccuracy,
+    "Take deltaOneStep and the epsilon bounds of each track from the "
+    "trackAccuracy table (field managers are built at /run/initialize)")
+    .SetParameterName("enable", false)
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareMethod("trackAccuracy", &FieldIntegration::TrackAccuracyCommand,
+    "Accuracy of the tracks of a species up to a momentum: '<species> <maxMomentum> "
+    "<unit> <deltaOneStep> <unit> <epsilonMin> <epsilonMax>', e.g. "
+    "'mu+ 300 MeV 0.002 mm 1e-5 1e-4'. Species: mu+ mu- pi+ pi- pi0 neutron e- gamma other")
+    .SetParameterName("arguments", false)
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareMethod("clearTrackAccuracy", &FieldIntegration::ClearTrackAccuracies,
+    "Remove all bands of the trackAccuracy table")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareMethod("listTrackAccuracy", &FieldIntegration::PrintTrackAccuracies,
+    "Print the trackAccuracy table")
+    .SetToBeBroadcasted(false);
+}
+
+FieldIntegration::~FieldIntegration()
+{
+  delete fMessenger;
+}
+
+G4ChordFinder* FieldIntegration::CreateChordFinder(const G4String& stepperName,
+                                                   G4ElectroMagneticField* field,
+                                                   G4bool pureMagnetic,
+                                                   G4EquationOfMotion** equationOut) const
+{
+  G4String name = stepperName;
+  if (name == "ExactHelix" && !pureMagnetic) {
+    G4cout << "FieldIntegration (" << fName << "): ExactHelix needs a pure magnetic field,"
+           << " using ClassicalRK4" << G4endl;
+    name = "ClassicalRK4";
+  }
+  
+  // Pure magnetic fields need only position and momentum; fields that
+  // change the energy also integrate energy and time
+  G4EquationOfMotion* equation;
+  G4int nVariables;
+  if (pureMagnetic) {
+    equation = new G4Mag_UsualEqRhs(field);
+    nVariables = 6;
+  } else {
+    equation = new G4EqMagElectricField(field);
+    nVariables = 8;
+  }
+  if (equationOut) {
+    *equationOut = equation;
+  }
+  
+  // Steppers book their substeps in FieldStatistics
+  G4VIntegrationDriver* driver;
+  if (name == "DormandPrince745") {
+    // FSAL stepper; the interpolation driver reuses its dense output
+    // instead of re-integrating when the chord is shortened
+    typedef CountingStepper<G4DormandPrince745> Stepper;
+    Stepper* stepper = new Stepper(equation, nVariables);
+    driver = new G4InterpolationDriver<Stepper>(fMinStep, stepper, nVariables);
+  } else {
+    G4MagIntegratorStepper* stepper;
+    if (name == "BogackiShampine45") {
+      stepper = new CountingStepper<G4BogackiShampine45>(equation, nVariables);
+    } else if (name == "ExactHelix") {
+      stepper = new CountingStepper<G4ExactHelixStepper>(static_cast<G4Mag_EqRhs*>(equation));
+    } else {
+      stepper = new CountingStepper<G4ClassicalRK4>(equation, nVariables);
+    }
+    driver = new G4MagInt_Driver(fMinStep, stepper, nVariables);
+  }
+  
+  G4ChordFinder* chordFinder = new G4ChordFinder(driver);
+  chordFinder->SetDeltaChord(fDeltaChord);
+  return chordFinder;
+}
+
+void FieldIntegration::Configure(G4FieldManager* fieldManager,
+                                 G4ElectroMagneticField* field,
+                                 G4bool pureMagnetic) const
+{
+  fieldManager->SetDetectorField(field);
+  fieldManager->SetChordFinder(CreateChordFinder(fStepperName, field, pureMagnetic));
+  
+  fieldManager->SetDeltaOneStep(fDeltaOneStep);
+  fieldManager->SetDeltaIntersection(fDeltaIntersection);
+  
+  // The maximum first, so the minimum is never checked against a smaller one
+  fieldManager->SetMaximumEpsilonStep(fEpsilonMax);
+  if (!fieldManager->SetMinimumEpsilonStep(std::min(fEpsilonMin, fEpsilonMax))) {
+    G4cerr << "FieldIntegration (" << fName << "): epsilonMin " << fEpsilonMin
+           << " rejected" << G4endl;
+  }
+}
+
+G4FieldManager* FieldIntegration::CreateFieldManager() const
+{
+  return new TrackAccuracyFieldManager(*this);
+}
+
+void FieldIntegration::ApplyAccuracy(G4FieldManager* fieldManager,
+                                     const TrackAccuracy* accuracy) const
+{
+  G4double deltaOneStep = accuracy ? accuracy->deltaOneStep : fDeltaOneStep;
+  G4double epsilonMin = accuracy ? accuracy->epsilonMin : std::min(fEpsilonMin, fEpsilonMax);
+  G4double epsilonMax = accuracy ? accuracy->epsilonMax : fEpsilonMax;
+  
+  fieldManager->SetDeltaOneStep(deltaOneStep);
+  
+  // The manager rejects a maximum below its current minimum and a minimum
+  // above its current maximum, so the order depends on where the bounds move
+  if (epsilonMax >= fieldManager->GetMinimumEpsilonStep()) {
+    fieldManager->SetMaximumEpsilonStep(epsilonMax);
+    fieldManager->SetMinimumEpsilonStep(epsilonMin);
+  } else {
+    fieldManager->SetMinimumEpsilonStep(epsilonMin);
+    fieldManager->SetMaximumEpsilonStep(epsilonMax);
+  }
+}
+
+void FieldIntegration::AddTrackAccuracy(Species species, const TrackAccuracy& accuracy)
+{
+  std::vector<TrackAccuracy>& bands = fTrackAccuracies[species];
+  auto position = std::upper_bound(bands.begin(), bands.end(), accuracy,
+    [](const TrackAccuracy& a, const TrackAccuracy& b) { return a.maxMomentum < b.maxMomentum; });
+  bands.insert(position, accuracy);
+  ++fTableVersion;
+}
+
+void FieldIntegration::ClearTrackAccuracies()
+{
+  for (std::vector<TrackAccuracy>& bands : fTrackAccuracies) {
+    bands.clear();
+  }
+  ++fTableVersion;
+}
+
+void FieldIntegration::PrintTrackAccuracies() const
+{
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "  TRACK ACCURACY: " << fName << " field, "
+         << (fPerTrackAccuracy ? "enabled" : "disabled") << G4endl;
+  G4cout << "================================================================" << G4endl;
+  G4cout << std::setw(8) << "Species" << " | " 
+         << std::setw(12) << "p max [MeV]" << " | " 
+         << std::setw(14) << "deltaOne [mm]" << " | " 
+         << std::setw(9) << "epsMin" << " | " 
+         << std::setw(9) << "epsMax" << G4endl;
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  for (G4int s = 0; s < kNumSpecies; ++s) {
+    for (const TrackAccuracy& accuracy : fTrackAccuracies[s]) {
+      G4cout << std::setw(8) << VolumeRoleTable::GetSpeciesName(static_cast<Species>(s)) << " | " 
+             << std::setw(12) << accuracy.maxMomentum/MeV << " | " 
+             << std::setw(14) << accuracy.deltaOneStep/mm << " | " 
+             << std::setw(9) << accuracy.epsilonMin << " | " 
+             << std::setw(9) << accuracy.epsilonMax << G4endl;
+    }
+  }
+  G4cout << std::setw(8) << "others" << " | " 
+         << std::setw(12) << "any" << " | " 
+         << std::setw(14) << fDeltaOneStep/mm << " | " 
+         << std::setw(9) << std::min(fEpsilonMin, fEpsilonMax) << " | " 
+         << std::setw(9) << fEpsilonMax << G4endl;
+  G4cout << "================================================================" << G4endl;
+}
+
+void FieldIntegration::TrackAccuracyCommand(const G4String& value)
+{
+  std::istringstream is(value);
+  G4String name, momentumUnit, lengthUnit;
+  TrackAccuracy accuracy;
+  is >> name >> accuracy.maxMomentum >> momentumUnit >> accuracy.deltaOneStep >> lengthUnit
+     >> accuracy.epsilonMin >> accuracy.epsilonMax;
+  
+  Species species = VolumeRoleTable::FindSpecies(name);
+  G4double momentumScale = is.fail() ? 0. : G4UIcommand::ValueOf(momentumUnit.c_str());
+  G4double lengthScale = is.fail() ? 0. : G4UIcommand::ValueOf(lengthUnit.c_str());
+  if (species == kNumSpecies || momentumScale <= 0. || lengthScale <= 0.
+      || accuracy.maxMomentum <= 0. || accuracy.deltaOneStep <= 0.
+      || accuracy.epsilonMin <= 0. || accuracy.epsilonMin > accuracy.epsilonMax
+      || accuracy.epsilonMax >= 1.) {
+    G4cerr << "FieldIntegration (" << fName << "): cannot parse track accuracy '"
+           << value << "'" << G4endl;
+    return;
+  }
+  
+  accuracy.maxMomentum *= momentumScale;
+  accuracy.deltaOneStep *= lengthScale;
+  AddTrackAccuracy(species, accuracy);
+}
+
+G4double FieldIntegration::GetEpsilon(G4double stepLength) const
+{
+  G4double epsilon = fDeltaOneStep / stepLength;
+  return std::max(fEpsilonMin, std::min(fEpsilonMax, epsilon));
+}
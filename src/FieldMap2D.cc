@@ -0,0 +1,595 @@
+// ==========================
+// src/FieldMap2D.cc
+// ==========================
+
+#include "FieldMap2D.hh"
+#include "AxisymmetricField.hh"
+#include "MappedFile.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4ios.hh"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BEAMTEST_HAVE_MKSTEMP 1
+#endif
+
+namespace {
+  // Radius, in units of the first radial cell, at which radial components
+  // on the axis are sampled to get their limit Br/r for r -> 0
+  const G4double kAxisOffset = 1.0e-3;
+  
+  const char* const kComponentNames[4] = { "Br", "Bz", "Er", "Ez" };
+  
+  // z intervals of the uniform sampling per panel of an adaptive grid; the
+  // point spacing within a panel is a power of two of the sampling step,
+  // so the panel length bounds the coarsest spacing
+  const G4int kPanelIntervals = 64;
+  
+  // Points InterpolateBatch locates before interpolating them
+  const G4int kBatchChunk = 64;
+  
+  // Header at the start of a cache file; the nodes follow at dataOffset,
+  // aligned for the mapping to hand them out in place, then the block
+  // scales at scaleOffset and the z grid points at axisOffset
+  struct FieldMapCacheHeader
+  {
+    char magic[8];                // "BTFMAP2D"
+    std::uint32_t version;
+    std::uint32_t nodeSize;
+    std::uint32_t storage;        // Storage::kTypeId
+    std::uint32_t reserved;
+    std::uint64_t sourceKey;
+    std::uint64_t dataOffset;
+    std::uint64_t scaleOffset;
+    std::uint64_t nScales;
+    std::uint64_t axisOffset;     // z of the nZ grid points
+    std::int32_t nR;
+    std::int32_t nZ;
+    G4double r2Max;
+  };
+  
+  const std::uint32_t kCacheVersion = 3;
+  const std::uint64_t kCacheAlignment = 64;
+  
+  std::uint64_t AlignOffset(std::uint64_t offset)
+  {
+    return (offset + kCacheAlignment - 1) / kCacheAlignment * kCacheAlignment;
+  }
+  
+  // Indices of the z samples an adaptive grid keeps. Samples hold 4 values
+  // per node, z-major with nR nodes per z. In each panel, the largest step
+  // is taken at which linear interpolation between kept samples matches
+  // every dropped one to within tolerance of the component's peak.
+  std::vector<G4int> SelectPointsZ(const std::vector<G4double>& samples, G4int nR, G4int nZ,
+                                   G4double tolerance)
+  {
+    G4double peak[4] = { 0., 0., 0., 0. };
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+      peak[i % 4] = std::max(peak[i % 4], std::abs(samples[i]));
+    }
+    G4double allowed[4];
+    for (G4int c = 0; c < 4; ++c) {
+      allowed[c] = tolerance * peak[c];
+    }
+    
+    std::vector<G4int> kept;
+    for (G4int begin = 0; begin < nZ - 1; begin += kPanelIntervals) {
+      G4int end = std::min(begin + kPanelIntervals, nZ - 1);
+      
+      G4int step = kPanelIntervals;
+      for (; step > 1; step /= 2) {
+        if ((end - begin) % step != 0) continue;
+        
+        G4bool good = true;
+        for (G4int iz = begin + 1; iz < end && good; ++iz) {
+          G4int iz0 = begin + (iz - begin) / step * step;
+          G4double w = G4double(iz - iz0) / step;
+          const G4double* v0 = &samples[4 * static_cast<std::size_t>(iz0) * nR];
+          const G4double* v1 = &samples[4 * static_cast<std::size_t>(iz0 + step) * nR];
+          const G4double* v = &samples[4 * static_cast<std::size_t>(iz) * nR];
+          for (G4int k = 0; k < 4*nR && good; ++k) {
+            good = std::abs((1. - w)*v0[k] + w*v1[k] - v[k]) <= allowed[k % 4];
+          }
+        }
+        if (good) break;
+      }
+      
+      for (G4int iz = begin; iz < end; iz += step) {
+        kept.push_back(iz);
+      }
+    }
+    kept.push_back(nZ - 1);
+    return kept;
+  }
+}
+
+void DoubleStorage::Encode(const std::vector<G4double>& samples,
+                           std::vector<Node>& nodes, std::vector<BlockScale>& scales)
+{
+  nodes.resize(samples.size() / 4);
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    for (G4int c = 0; c < 4; ++c) {
+      nodes[i].value[c] = samples[4*i + c];
+    }
+  }
+  scales.clear();
+}
+
+void FloatStorage::Encode(const std::vector<G4double>& samples,
+                          std::vector<Node>& nodes, std::vector<BlockScale>& scales)
+{
+  nodes.resize(samples.size() / 4);
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    for (G4int c = 0; c < 4; ++c) {
+      nodes[i].value[c] = static_cast<G4float>(samples[4*i + c]);
+    }
+  }
+  scales.clear();
+}
+
+void QuantizedStorage::Encode(const std::vector<G4double>& samples,
+                              std::vector<Node>& nodes, std::vector<BlockScale>& scales)
+{
+  const std::size_t blockSize = std::size_t(1) << kBlockShift;
+  nodes.resize(samples.size() / 4);
+  scales.resize((nodes.size() + blockSize - 1) / blockSize);
+  
+  for (std::size_t block = 0; block < scales.size(); ++block) {
+    std::size_t begin = block * blockSize;
+    std::size_t end = std::min(begin + blockSize, nodes.size());
+    
+    for (G4int c = 0; c < 4; ++c) {
+      G4double maxValue = 0.;
+      for (std::size_t i = begin; i < end; ++i) {
+        maxValue = std::max(maxValue, std::abs(samples[4*i + c]));
+      }
+      
+      // Codes are rounded against the float scale that Load multiplies by
+      G4float scale = static_cast<G4float>(maxValue / kMaxCode);
+      scales[block].value[c] = scale;
+      G4double inverse = (scale > 0.f) ? 1. / scale : 0.;
+      for (std::size_t i = begin; i < end; ++i) {
+        G4double code = std::round(samples[4*i + c] * inverse);
+        code = std::min(std::max(code, G4double(-kMaxCode)), G4double(kMaxCode));
+        nodes[i].value[c] = static_cast<std::int16_t>(code);
+      }
+    }
+  }
+}
+
+template <class Storage>
+FieldMap2DT<Storage>::FieldMap2DT(const AxisymmetricField& source, G4int nR, G4int nZ,
+                                  G4double tolerance, G4int nThreads)
+: fNR(std::max(nR, 2)),
+  fNZ(std::max(nZ, 2)),
+  fR2Max(source.GetMaxRadius() * source.GetMaxRadius()),
+  fZMin(source.GetZMin()),
+  fZMax(source.GetZMax()),
+  fAxisZ(fZMin, fZMax, fNZ)
+{
+  SetSpacing();
+  
+  // Sampled in double, then encoded by the storage policy. Threads take
+  // rows of constant z in turn, as the cost of a row can vary along z.
+  std::vector<G4double> samples(4 * static_cast<std::size_t>(fNR) * fNZ);
+  std::atomic<G4int> nextRow(0);
+  auto sampleRows = [&]() {
+    G4double fieldRZ[4];
+    for (G4int iz = nextRow++; iz < fNZ; iz = nextRow++) {
+      G4double z = fAxisZ.GetPoint(iz);
+      for (G4int ir = 0; ir < fNR; ++ir) {
+        G4double* node = &samples[4 * (static_cast<std::size_t>(iz)*fNR + ir)];
+        
+        G4double r = std::sqrt(ir * fDR2);
+        if (ir == 0) {
+          // Axial components on the axis, radial ones just off it
+          source.GetFieldRZ(0., z, fieldRZ);
+          node[1] = fieldRZ[1];
+          node[3] = fieldRZ[3];
+          r = kAxisOffset * std::sqrt(fDR2);
+          source.GetFieldRZ(r, z, fieldRZ);
+          node[0] = fieldRZ[0] / r;
+          node[2] = fieldRZ[2] / r;
+        } else {
+          source.GetFieldRZ(r, z, fieldRZ);
+          node[0] = fieldRZ[0] / r;
+          node[1] = fieldRZ[1];
+          node[2] = fieldRZ[2] / r;
+          node[3] = fieldRZ[3];
+        }
+      }
+    }
+  };
+  std::vector<std::thread> helpers;
+  for (G4int i = 1; i < std::min(nThreads, fNZ); ++i) {
+    helpers.emplace_back(sampleRows);
+  }
+  sampleRows();
+  for (std::thread& helper : helpers) {
+    helper.join();
+  }
+  
+  if (tolerance > 0.) {
+    // Keep the selected rows of samples, in place
+    std::vector<G4int> kept = SelectPointsZ(samples, fNR, fNZ, tolerance);
+    std::vector<G4double> points(kept.size());
+    std::size_t rowSize = 4 * static_cast<std::size_t>(fNR);
+    for (std::size_t i = 0; i < kept.size(); ++i) {
+      points[i] = fAxisZ.GetPoint(kept[i]);
+      std::copy(samples.begin() + kept[i] * rowSize, samples.begin() + (kept[i] + 1) * rowSize,
+                samples.begin() + i * rowSize);
+    }
+    samples.resize(kept.size() * rowSize);
+    fAxisZ = GridAxis(points);
+    fNZ = fAxisZ.GetNPoints();
+  }
+  
+  Storage::Encode(samples, fNodes, fScales);
+  fData = fNodes.data();
+  fScaleData = fScales.empty() ? nullptr : fScales.data();
+  fNScales = fScales.size();
+}
+
+template <class Storage>
+FieldMap2DT<Storage>::FieldMap2DT(std::unique_ptr<MappedFile> mapping, std::size_t dataOffset,
+                                  std::size_t scaleOffset, std::size_t nScales,
+                                  G4int nR, G4double r2Max, const GridAxis& axisZ)
+: fMapping(std::move(mapping)),
+  fNR(nR),
+  fNZ(axisZ.GetNPoints()),
+  fR2Max(r2Max),
+  fZMin(axisZ.GetMin()),
+  fZMax(axisZ.GetMax()),
+  fAxisZ(axisZ)
+{
+  SetSpacing();
+  
+  const char* data = fMapping->GetData() + dataOffset;
+  const char* scaleData = fMapping->GetData() + scaleOffset;
+  if (reinterpret_cast<std::uintptr_t>(data) % alignof(Node) == 0
+      && reinterpret_cast<std::uintptr_t>(scaleData) % alignof(BlockScale) == 0) {
+    fData = reinterpret_cast<const Node*>(data);
+    fScaleData = (nScales > 0) ? reinterpret_cast<const BlockScale*>(scaleData) : nullptr;
+    fNScales = nScales;
+  } else {
+    // Only when the file was read into an unaligned buffer instead of mapped
+    fNodes.resize(static_cast<std::size_t>(fNR) * fNZ);
+    std::memcpy(fNodes.data(), data, fNodes.size() * sizeof(Node));
+    fScales.resize(nScales);
+    std::memcpy(fScales.data(), scaleData, fScales.size() * sizeof(BlockScale));
+    fData = fNodes.data();
+    fScaleData = fScales.empty() ? nullptr : fScales.data();
+    fNScales = nScales;
+    fMapping.reset();
+  }
+}
+
+template <class Storage>
+FieldMap2DT<Storage>::~FieldMap2DT()
+{
+}
+
+template <class Storage>
+void FieldMap2DT<Storage>::SetSpacing()
+{
+  fDR2 = fR2Max / (fNR - 1);
+  fInvDR2 = 1.0 / fDR2;
+}
+
+template <class Storage>
+G4bool FieldMap2DT<Storage>::WriteCache(const G4String& fileName, std::uint64_t sourceKey) const
+{
+  FieldMapCacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, "BTFMAP2D", sizeof(header.magic));
+  header.version = kCacheVersion;
+  header.nodeSize = sizeof(Node);
+  header.storage = Storage::kTypeId;
+  header.sourceKey = sourceKey;
+  header.dataOffset = AlignOffset(sizeof(header));
+  std::uint64_t dataSize = static_cast<std::uint64_t>(fNR) * fNZ * sizeof(Node);
+  header.scaleOffset = AlignOffset(header.dataOffset + dataSize);
+  header.nScales = fNScales;
+  header.axisOffset = AlignOffset(header.scaleOffset + fNScales * sizeof(BlockScale));
+  header.nR = fNR;
+  header.nZ = fNZ;
+  header.r2Max = fR2Max;
+  
+  // A temporary file of this call alone, beside the cache so the rename
+  // stays within one file system; readable by all, as the cache is shared
+#ifdef BEAMTEST_HAVE_MKSTEMP
+  G4String tempName = fileName + ".XXXXXX";
+  G4int descriptor = mkstemp(&tempName[0]);
+  if (descriptor < 0) {
+    G4cerr << "Error creating a temporary file for " << fileName << G4endl;
+    return false;
+  }
+  fchmod(descriptor, 0644);
+  close(descriptor);
+#else
+  G4String tempName = fileName + "." + std::to_string(std::random_device()()) + ".tmp";
+#endif
+  
+  std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    G4cerr << "Error opening " << tempName << G4endl;
+    std::remove(tempName.c_str());
+    return false;
+  }
+  
+  const char padding[kCacheAlignment] = {};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(padding, header.dataOffset - sizeof(header));
+  file.write(reinterpret_cast<const char*>(fData), dataSize);
+  file.write(padding, header.scaleOffset - header.dataOffset - dataSize);
+  if (fScaleData) {
+    file.write(reinterpret_cast<const char*>(fScaleData), header.nScales * sizeof(BlockScale));
+  }
+  file.write(padding, header.axisOffset - header.scaleOffset - header.nScales * sizeof(BlockScale));
+  file.write(reinterpret_cast<const char*>(fAxisZ.GetPoints().data()), fNZ * sizeof(G4double));
+  file.close();
+  
+  if (!file || std::rename(tempName.c_str(), fileName.c_str()) != 0) {
+    G4cerr << "Error writing field map cache " << fileName << G4endl;
+    std::remove(tempName.c_str());
+    return false;
+  }
+  return true;
+}
+
+template <class Storage>
+std::shared_ptr<const FieldMap2DT<Storage>>
+FieldMap2DT<Storage>::ReadCache(const G4String& fileName, std::uint64_t sourceKey)
+{
+  std::unique_ptr<MappedFile> mapping(new MappedFile(fileName));
+  if (!mapping->IsValid() || mapping->GetSize() < sizeof(FieldMapCacheHeader)) {
+    return nullptr;
+  }
+  
+  FieldMapCacheHeader header;
+  std::memcpy(&header, mapping->GetData(), sizeof(header));
+  if (std::memcmp(header.magic, "BTFMAP2D", sizeof(header.magic)) != 0
+      || header.version != kCacheVersion
+      || header.nodeSize != sizeof(Node)
+      || header.storage != Storage::kTypeId
+      || header.sourceKey != sourceKey
+      || header.nR < 2 || header.nZ < 2
+      || header.dataOffset % kCacheAlignment != 0
+      || header.scaleOffset % kCacheAlignment != 0
+      || header.axisOffset % kCacheAlignment != 0) {
+    return nullptr;
+  }
+  
+  std::uint64_t dataSize = static_cast<std::uint64_t>(header.nR) * header.nZ * sizeof(Node);
+  std::uint64_t scaleSize = header.nScales * sizeof(BlockScale);
+  std::uint64_t axisSize = static_cast<std::uint64_t>(header.nZ) * sizeof(G4double);
+  if (header.scaleOffset < header.dataOffset + dataSize
+      || header.axisOffset < header.scaleOffset + scaleSize
+      || mapping->GetSize() < header.axisOffset + axisSize) {
+    return nullptr;
+  }
+  
+  // The z points are few; copied, as GridAxis builds its segments from them
+  std::vector<G4double> points(header.nZ);
+  std::memcpy(points.data(), mapping->GetData() + header.axisOffset, axisSize);
+  for (G4int iz = 1; iz < header.nZ; ++iz) {
+    if (!(points[iz] > points[iz - 1])) return nullptr;
+  }
+  
+  return std::shared_ptr<const FieldMap2DT>(
+    new FieldMap2DT(std::move(mapping), header.dataOffset, header.scaleOffset, header.nScales,
+                    header.nR, header.r2Max, GridAxis(points)));
+}
+
+template <class Storage>
+void FieldMap2DT<Storage>::GetFieldValues(G4int n, const FieldPoints& points, const FieldValues& values) const
+{
+  InterpolateBatch(n, points.x, points.y, points.z,
+                   values.bx, values.by, values.bz, values.ex, values.ey, values.ez);
+}
+
+template <class Storage>
+void FieldMap2DT<Storage>::InterpolateBatch(G4int n,
+                                            const G4double* __restrict px, const G4double* __restrict py,
+                                            const G4double* __restrict pz,
+                                            G4double* __restrict bx, G4double* __restrict by, G4double* __restrict bz,
+                                            G4double* __restrict ex, G4double* __restrict ey, G4double* __restrict ez) const
+{
+  const Node* nodes = fData;
+  const BlockScale* scales = fScaleData;
+  const G4int nR = fNR;
+  const G4double r2Max = fR2Max;
+  const G4double zMin = fZMin;
+  const G4double zMax = fZMax;
+  const G4double invDR2 = fInvDR2;
+  // Largest r^2 cell position, so a point rounded onto the last node still
+  // interpolates within the last cell
+  const G4double frMax = std::nextafter(G4double(nR - 1), 0.);
+  const GridAxis& axisZ = fAxisZ;
+  
+  // Each chunk takes three passes. The points are sorted, without
+  // branches, into index lists of those on and off the grid, as points
+  // scattered around a beamline mostly lie off a given map. The cells of
+  // the points on the grid are found, then their nodes loaded and blended.
+  // A single pass chains the grid lookup into the loads, and the lookup
+  // through GridAxis is long enough to stall the loop on it; split, the
+  // lookup has no loads from the map and vectorises, with the bins of the
+  // z axis gathered. Points off the grid are zeroed last, so that no output
+  // is written twice.
+  G4int active[kBatchChunk];
+  G4int inactive[kBatchChunk];
+  std::size_t index[kBatchChunk];
+  G4double tr[kBatchChunk];
+  G4double tz[kBatchChunk];
+  for (G4int start = 0; start < n; start += kBatchChunk) {
+    G4int end = std::min(n, start + kBatchChunk);
+    
+    G4int nActive = 0;
+    G4int nInactive = 0;
+    for (G4int i = start; i < end; ++i) {
+      G4double r2 = px[i]*px[i] + py[i]*py[i];
+      G4bool inside = r2 < r2Max && pz[i] >= zMin && pz[i] < zMax;
+      active[nActive] = i;
+      inactive[nInactive] = i;
+      nActive += inside;
+      nInactive += !inside;
+    }
+    
+    for (G4int k = 0; k < nActive; ++k) {
+      G4int i = active[k];
+      G4double fr = std::min(frMax, (px[i]*px[i] + py[i]*py[i]) * invDR2);
+      G4int ir = static_cast<G4int>(fr);
+      G4int iz;
+      axisZ.Locate(pz[i], iz, tz[k]);
+      index[k] = static_cast<std::size_t>(iz)*nR + ir;
+      tr[k] = fr - ir;
+    }
+    
+    for (G4int k = 0; k < nActive; ++k) {
+      G4double v00[4], v01[4], v10[4], v11[4];
+      Storage::Load(nodes, scales, index[k], v00);
+      Storage::Load(nodes, scales, index[k] + 1, v01);
+      Storage::Load(nodes, scales, index[k] + nR, v10);
+      Storage::Load(nodes, scales, index[k] + nR + 1, v11);
+      
+      G4double w00 = (1. - tr[k]) * (1. - tz[k]);
+      G4double w01 = tr[k] * (1. - tz[k]);
+      G4double w10 = (1. - tr[k]) * tz[k];
+      G4double w11 = tr[k] * tz[k];
+      
+      G4int i = active[k];
+      G4double brOverR = w00*v00[0] + w01*v01[0] + w10*v10[0] + w11*v11[0];
+      G4double erOverR = w00*v00[2] + w01*v01[2] + w10*v10[2] + w11*v11[2];
+      bx[i] = brOverR * px[i];
+      by[i] = brOverR * py[i];
+      bz[i] = w00*v00[1] + w01*v01[1] + w10*v10[1] + w11*v11[1];
+      ex[i] = erOverR * px[i];
+      ey[i] = erOverR * py[i];
+      ez[i] = w00*v00[3] + w01*v01[3] + w10*v10[3] + w11*v11[3];
+    }
+    for (G4int k = 0; k < nInactive; ++k) {
+      G4int i = inactive[k];
+      bx[i] = by[i] = bz[i] = 0.;
+      ex[i] = ey[i] = ez[i] = 0.;
+    }
+  }
+}
+
+template <class Storage>
+std::size_t FieldMap2DT<Storage>::GetMemoryUsage() const
+{
+  return static_cast<std::size_t>(fNR) * fNZ * sizeof(Node) + fNScales * sizeof(BlockScale);
+}
+
+template <class Storage>
+void FieldMap2DT<Storage>::GetPeakValues(G4double peak[4]) const
+{
+  peak[0] = peak[1] = peak[2] = peak[3] = 0.;
+  G4double value[4];
+  for (G4int iz = 0; iz < fNZ; ++iz) {
+    for (G4int ir = 0; ir < fNR; ++ir) {
+      Storage::Load(fData, fScaleData, static_cast<std::size_t>(iz)*fNR + ir, value);
+      G4double r = std::sqrt(ir * fDR2);
+      peak[0] = std::max(peak[0], std::abs(value[0] * r));
+      peak[1] = std::max(peak[1], std::abs(value[1]));
+      peak[2] = std::max(peak[2], std::abs(value[2] * r));
+      peak[3] = std::max(peak[3], std::abs(value[3]));
+    }
+  }
+}
+
+template <class Storage>
+void FieldMap2DT<Storage>::GetInterpolationError(const AxisymmetricField& source,
+                                                 G4double maxError[4], G4double rmsError[4]) const
+{
+  G4double sumError2[4] = { 0., 0., 0., 0. };
+  G4double exact[4];
+  G4double values[4];
+  G4int nCells = 0;
+  for (G4int c = 0; c < 4; ++c) {
+    maxError[c] = 0.;
+  }
+  
+  for (G4int iz = 0; iz < fNZ - 1; ++iz) {
+    G4double z = 0.5 * (fAxisZ.GetPoint(iz) + fAxisZ.GetPoint(iz + 1));
+    for (G4int ir = 0; ir < fNR - 1; ++ir) {
+      G4double r2 = (ir + 0.5) * fDR2;
+      G4double r = std::sqrt(r2);
+      source.GetFieldRZ(r, z, exact);
+      Interpolate(r2, z, values);
+      
+      G4double error[4] = {
+        std::abs(values[0] * r - exact[0]),
+        std::abs(values[1] - exact[1]),
+        std::abs(values[2] * r - exact[2]),
+        std::abs(values[3] - exact[3])
+      };
+      for (G4int c = 0; c < 4; ++c) {
+        maxError[c] = std::max(maxError[c], error[c]);
+        sumError2[c] += error[c] * error[c];
+      }
+      ++nCells;
+    }
+  }
+  
+  for (G4int c = 0; c < 4; ++c) {
+    rmsError[c] = std::sqrt(sumError2[c] / nCells);
+  }
+}
+
+template <class Storage>
+void FieldMap2DT<Storage>::Report(const AxisymmetricField* source, const G4String& name) const
+{
+  // Largest magnitude of each component over the grid, for relative errors
+  G4double maxValue[4];
+  GetPeakValues(maxValue);
+  
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "  FIELD MAP: " << name << G4endl;
+  G4cout << "================================================================" << G4endl;
+  G4cout << " Grid: " << fNR << " x " << fNZ << " points in (r^2, z), r < "
+         << std::sqrt(fR2Max)/cm << " cm, " << fZMin/cm << " < z < " << fZMax/cm << " cm" << G4endl
+         << " Spacing: dr^2 = " << fDR2/(cm*cm) << " cm^2, dz = ";
+  if (fAxisZ.IsUniform()) {
+    G4cout << fAxisZ.GetMinSpacing()/mm << " mm" << G4endl;
+  } else {
+    G4cout << fAxisZ.GetMinSpacing()/mm << " to " << fAxisZ.GetMaxSpacing()/mm << " mm in "
+           << fAxisZ.GetNSegments() << " segments" << G4endl;
+  }
+  G4cout << " Memory: " << GetMemoryUsage()/1024. << " kB, " << Storage::kName << " storage"
+         << (IsMapped() ? ", mapped from the cache file" : "") << G4endl
+         << " Peak |B| components: " << maxValue[0]/tesla << " T (Br), " << maxValue[1]/tesla
+         << " T (Bz); |E|: " << maxValue[2]/(megavolt/m) << " MV/m (Er), "
+         << maxValue[3]/(megavolt/m) << " MV/m (Ez)" << G4endl;
+  
+  if (source) {
+    G4double maxError[4];
+    G4double rmsError[4];
+    GetInterpolationError(*source, maxError, rmsError);
+    
+    G4cout << " Interpolation error at cell centres, relative to the largest value:" << G4endl;
+    for (G4int c = 0; c < 4; ++c) {
+      if (maxValue[c] == 0.) continue;
+      G4cout << "   " << kComponentNames[c]
+             << ": max " << 100. * maxError[c] / maxValue[c] << " %"
+             << ", rms " << 100. * rmsError[c] / maxValue[c] << " %" << G4endl;
+    }
+  }
+  G4cout << "================================================================" << G4endl;
+}
+
+template class FieldMap2DT<DoubleStorage>;
+template class FieldMap2DT<FloatStorage>;
+template class FieldMap2DT<QuantizedStorage>;
@@ -0,0 +1,386 @@
+// ===========================
+// src/FieldMapImport.cc
+// ===========================
+
+#include "FieldMapImport.hh"
+#include "AxisymmetricField.hh"
+#include "FieldMap2D.hh"
+#include "G4ios.hh"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace {
+  // Bump when parsing or resampling changes, to invalidate existing caches
+  const std::uint64_t kImportVersion = 1;
+  
+  // Relative spacing tolerance of a regular grid
+  const G4double kGridTolerance = 1.0e-6;
+  
+  enum Column { kR = 0, kZ, kBr, kBz, kEr, kEz, kNumColumns };
+  
+  G4bool IsComment(const std::string& line)
+  {
+    std::size_t first = line.find_first_not_of(" \t\r");
+    return first == std::string::npos || std::strchr("#!%*", line[first]);
+  }
+  
+  // OPERA column description "<index> <name> [unit]"
+  G4bool IsOperaColumn(const std::string& line, long& index, std::string& name)
+  {
+    std::istringstream is(line);
+    std::string first;
+    is >> first >> name;
+    char* end = nullptr;
+    index = std::strtol(first.c_str(), &end, 10);
+    return !first.empty() && *end == '\0' && index > 0 && !name.empty()
+        && std::strtod(name.c_str(), &end) == 0. && end == name.c_str();
+  }
+  
+  // Split a line into numbers; false if any token is not a number
+  G4bool ParseNumbers(const std::string& line, std::vector<G4double>& numbers)
+  {
+    numbers.clear();
+    const char* p = line.c_str();
+    while (true) {
+      while (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r') ++p;
+      if (*p == '\0') break;
+      char* end = nullptr;
+      G4double value = std::strtod(p, &end);
+      if (end == p || (*end != '\0' && !std::strchr(" \t,\r", *end))) return false;
+      numbers.push_back(value);
+      p = end;
+    }
+    return !numbers.empty();
+  }
+  
+  // Column for a header name such as "Bz", "R(cm)" or "EZ [MV/m]"; -1 if unknown
+  G4int ColumnOf(std::string name)
+  {
+    name = name.substr(0, name.find_first_of("([{"));
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return std::toupper(c); });
+    
+    const char* const names[kNumColumns][2] = {
+      { "R", "X" }, { "Z", "Y" }, { "BR", "BX" }, { "BZ", "BY" }, { "ER", "EX" }, { "EZ", "EY" }
+    };
+    for (G4int c = 0; c < kNumColumns; ++c) {
+      if (name == names[c][0] || name == names[c][1]) return c;
+    }
+    return -1;
+  }
+  
+  // Field on the regular (r,z) grid of the file, bilinear in r and z, as
+  // the source for resampling onto the (r^2,z) map
+  class AsciiFieldGrid : public AxisymmetricField
+  {
+    public:
+      G4bool Read(const G4String& fileName, const FieldMapImport::Units& units);
+      
+      virtual void GetFieldRZ(G4double r, G4double z, G4double fieldRZ[4]) const;
+      virtual G4double GetMaxRadius() const { return (fNR - 1) * fDR; }
+      virtual G4double GetZMin() const { return fZMin; }
+      virtual G4double GetZMax() const { return fZMin + (fNZ - 1) * fDZ; }
+      
+      G4int GetNPointsR() const { return fNR; }
+      G4int GetNPointsZ() const { return fNZ; }
+      
+    private:
+      std::vector<G4double> fValues;   // Br, Bz, Er, Ez per point, z-major
+      G4int fNR = 0;
+      G4int fNZ = 0;
+      G4double fDR = 0.;
+      G4double fDZ = 0.;
+      G4double fZMin = 0.;
+  };
+  
+  // Sorted distinct values, merging those closer than the tolerance
+  std::vector<G4double> GridValues(std::vector<G4double> values)
+  {
+    std::sort(values.begin(), values.end());
+    G4double tolerance = kGridTolerance * std::max(1., values.back() - values.front());
+    values.erase(std::unique(values.begin(), values.end(),
+                             [tolerance](G4double a, G4double b) { return b - a < tolerance; }),
+                 values.end());
+    return values;
+  }
+  
+  G4bool IsRegular(const std::vector<G4double>& values)
+  {
+    G4double step = (values.back() - values.front()) / (values.size() - 1);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      if (std::abs(values[i] - values.front() - i*step) > kGridTolerance * step * values.size()) {
+        return false;
+      }
+    }
+    return true;
+  }
+  
+  G4bool AsciiFieldGrid::Read(const G4String& fileName, const FieldMapImport::Units& units)
+  {
+    std::ifstream file(fileName);
+    if (!file.is_open()) {
+      G4cerr << "Error opening " << fileName << G4endl;
+      return false;
+    }
+    
+    // Column of each field in the rows; positional unless a header says otherwise
+    G4int position[kNumColumns] = { 0, 1, 2, 3, 4, 5 };
+    std::vector<std::string> operaNames;
+    std::vector<std::string> lastHeader;
+    G4bool inOperaHeader = false;
+    G4bool haveNames = false;
+    
+    std::vector<G4double> rows;     // kNumColumns values per point
+    std::vector<G4double> numbers;
+    std::size_t nColumns = 0;
+    std::string line;
+    G4int lineNumber = 0;
+    
+    // Lines are read through a one-line pushback, to look ahead past the
+    // first numeric line for an OPERA header
+    std::string pushedBack;
+    G4bool havePushedBack = false;
+    auto nextLine = [&]() {
+      while (true) {
+        if (havePushedBack) {
+          line = pushedBack;
+          havePushedBack = false;
+        } else if (std::getline(file, line)) {
+          ++lineNumber;
+        } else {
+          return false;
+        }
+        if (!IsComment(line)) return true;
+      }
+    };
+    
+    G4bool firstNumeric = true;
+    while (nextLine()) {
+      long index = 0;
+      std::string name;
+      if (!ParseNumbers(line, numbers)) {
+        if (inOperaHeader && IsOperaColumn(line, index, name)) {
+          operaNames.resize(std::max<std::size_t>(operaNames.size(), index));
+          operaNames[index - 1] = name;
+        } else {
+          std::istringstream is(line);
+          lastHeader.clear();
+          for (std::string token; is >> token; ) lastHeader.push_back(token);
+        }
+        continue;
+      }
+      
+      // The "0" closing an OPERA header
+      if (inOperaHeader) {
+        inOperaHeader = false;
+        if (numbers.size() == 1 && numbers[0] == 0.) continue;
+      }
+      
+      // OPERA files open with the grid dimensions, followed by the column
+      // descriptions; otherwise the first numeric line is data
+      if (firstNumeric) {
+        firstNumeric = false;
+        std::string dimensions = line;
+        if (nextLine()) {
+          if (IsOperaColumn(line, index, name)) {
+            inOperaHeader = true;
+            pushedBack = line;
+            havePushedBack = true;
+            continue;
+          }
+          pushedBack = line;
+          havePushedBack = true;
+        }
+        line = dimensions;
+      }
+      
+      if (nColumns == 0) {
+        nColumns = numbers.size();
+        const std::vector<std::string>& names = !operaNames.empty() ? operaNames : lastHeader;
+        if (names.size() == nColumns) {
+          std::fill(position, position + kNumColumns, -1);
+          for (std::size_t i = 0; i < names.size(); ++i) {
+            G4int column = ColumnOf(names[i]);
+            if (column >= 0) position[column] = i;
+          }
+          haveNames = true;
+        } else if (nColumns != 4 && nColumns != 6) {
+          G4cerr << "FieldMapImport: " << fileName << " has " << nColumns
+                 << " columns and no header naming them" << G4endl;
+          return false;
+        } else if (nColumns == 4) {
+          position[kEr] = position[kEz] = -1;
+        }
+        if (position[kR] < 0 || position[kZ] < 0) {
+          G4cerr << "FieldMapImport: no r or z column in " << fileName << G4endl;
+          return false;
+        }
+      }
+      
+      if (numbers.size() != nColumns) {
+        G4cerr << "FieldMapImport: " << fileName << ":" << lineNumber << " has "
+               << numbers.size() << " columns instead of " << nColumns << G4endl;
+        return false;
+      }
+      for (G4int c = 0; c < kNumColumns; ++c) {
+        rows.push_back(position[c] >= 0 ? numbers[position[c]] : 0.);
+      }
+    }
+    
+    std::size_t nPoints = rows.size() / kNumColumns;
+    if (nPoints < 4) {
+      G4cerr << "FieldMapImport: no grid in " << fileName << G4endl;
+      return false;
+    }
+    
+    std::vector<G4double> rValues(nPoints);
+    std::vector<G4double> zValues(nPoints);
+    for (std::size_t i = 0; i < nPoints; ++i) {
+      rValues[i] = rows[i*kNumColumns + kR] * units.length;
+      zValues[i] = rows[i*kNumColumns + kZ] * units.length;
+    }
+    std::vector<G4double> rGrid = GridValues(rValues);
+    std::vector<G4double> zGrid = GridValues(zValues);
+    
+    if (rGrid.size() < 2 || zGrid.size() < 2 || rGrid.size() * zGrid.size() != nPoints
+        || !IsRegular(rGrid) || !IsRegular(zGrid)) {
+      G4cerr << "FieldMapImport: the points of " << fileName << " do not form a regular (r,z) grid"
+             << G4endl;
+      return false;
+    }
+    fNR = rGrid.size();
+    fNZ = zGrid.size();
+    fDR = (rGrid.back() - rGrid.front()) / (fNR - 1);
+    fDZ = (zGrid.back() - zGrid.front()) / (fNZ - 1);
+    fZMin = zGrid.front();
+    if (std::abs(rGrid.front()) > kGridTolerance * fDR) {
+      G4cerr << "FieldMapImport: the grid of " << fileName << " does not start on the axis" << G4endl;
+      return false;
+    }
+    
+    // Points may come in any order
+    const G4double scale[4] = { units.magnetic, units.magnetic, units.electric, units.electric };
+    fValues.assign(4 * nPoints, 0.);
+    for (std::size_t i = 0; i < nPoints; ++i) {
+      G4int ir = static_cast<G4int>(std::lround(rValues[i] / fDR));
+      G4int iz = static_cast<G4int>(std::lround((zValues[i] - fZMin) / fDZ));
+      for (G4int c = 0; c < 4; ++c) {
+        fValues[4*(iz*fNR + ir) + c] = rows[i*kNumColumns + kBr + c] * scale[c];
+      }
+    }
+    
+    if (haveNames && position[kBr] < 0 && position[kBz] < 0 && position[kEr] < 0 && position[kEz] < 0) {
+      G4cerr << "FieldMapImport: no field columns in " << fileName << G4endl;
+      return false;
+    }
+    return true;
+  }
+  
+  void AsciiFieldGrid::GetFieldRZ(G4double r, G4double z, G4double fieldRZ[4]) const
+  {
+    fieldRZ[0] = fieldRZ[1] = fieldRZ[2] = fieldRZ[3] = 0.;
+    
+    G4double fr = r / fDR;
+    G4double fz = (z - fZMin) / fDZ;
+    if (fr < 0. || fr > fNR - 1 || fz < 0. || fz > fNZ - 1) return;
+    
+    // The last cell also serves points on the outer edges
+    G4int ir = std::min(static_cast<G4int>(fr), fNR - 2);
+    G4int iz = std::min(static_cast<G4int>(fz), fNZ - 2);
+    G4double tr = fr - ir;
+    G4double tz = fz - iz;
+    
+    const G4double* v00 = &fValues[4*(iz*fNR + ir)];
+    const G4double* v01 = v00 + 4;
+    const G4double* v10 = v00 + 4*fNR;
+    const G4double* v11 = v10 + 4;
+    for (G4int c = 0; c < 4; ++c) {
+      fieldRZ[c] = (1. - tr) * (1. - tz) * v00[c] + tr * (1. - tz) * v01[c]
+                 + (1. - tr) * tz * v10[c] + tr * tz * v11[c];
+    }
+  }
+  
+  // FNV-1a over the fields of the cache key
+  void HashBytes(std::uint64_t& hash, const void* data, std::size_t size)
+  {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+  }
+  
+  // Key of the cache: the text file's size and modification time, the units
+  // and the import version. 0 if the file cannot be examined.
+  std::uint64_t SourceKey(const G4String& fileName, const FieldMapImport::Units& units)
+  {
+    std::error_code error;
+    std::uintmax_t size = std::filesystem::file_size(fileName.c_str(), error);
+    if (error) return 0;
+    auto modified = std::filesystem::last_write_time(fileName.c_str(), error);
+    if (error) return 0;
+    std::int64_t ticks = modified.time_since_epoch().count();
+    
+    std::uint64_t hash = 14695981039346656037ull;
+    HashBytes(hash, &kImportVersion, sizeof(kImportVersion));
+    HashBytes(hash, &size, sizeof(size));
+    HashBytes(hash, &ticks, sizeof(ticks));
+    HashBytes(hash, &units, sizeof(units));
+    return hash;
+  }
+}
+
+template <class Storage>
+std::shared_ptr<const FieldMap2DT<Storage>> FieldMapImport::Load(const G4String& fileName,
+                                                                 const Units& units)
+{
+  std::uint64_t key = SourceKey(fileName, units);
+  if (key == 0) {
+    G4cerr << "Error opening " << fileName << G4endl;
+    return nullptr;
+  }
+  
+  G4String cacheName = fileName + ".bfm";
+  std::shared_ptr<const FieldMap2DT<Storage>> map = FieldMap2DT<Storage>::ReadCache(cacheName, key);
+  if (map) {
+    G4cout << "FieldMapImport: " << fileName << " from cache " << cacheName << G4endl;
+    return map;
+  }
+  
+  auto start = std::chrono::steady_clock::now();
+  AsciiFieldGrid grid;
+  if (!grid.Read(fileName, units)) {
+    return nullptr;
+  }
+  map = std::make_shared<const FieldMap2DT<Storage>>(grid, grid.GetNPointsR(), grid.GetNPointsZ());
+  auto stop = std::chrono::steady_clock::now();
+  
+  G4cout << "FieldMapImport: parsed " << fileName << " (" << grid.GetNPointsR() << " x "
+         << grid.GetNPointsZ() << " points) in "
+         << std::chrono::duration<G4double>(stop - start).count() << " s" << G4endl;
+  
+  // Serve this run from the cache as well, so every run takes the same path
+  if (map->WriteCache(cacheName, key)) {
+    std::shared_ptr<const FieldMap2DT<Storage>> cached =
+      FieldMap2DT<Storage>::ReadCache(cacheName, key);
+    if (cached) {
+      G4cout << "FieldMapImport: wrote cache " << cacheName << G4endl;
+      return cached;
+    }
+  }
+  return map;
+}
+
+template std::shared_ptr<const FieldMap2D>
+FieldMapImport::Load<DoubleStorage>(const G4String&, const FieldMapImport::Units&);
+template std::shared_ptr<const FieldMap2DT<FloatStorage>>
+FieldMapImport::Load<FloatStorage>(const G4String&, const FieldMapImport::Units&);
+template std::shared_ptr<const FieldMap2DT<QuantizedStorage>>
+FieldMapImport::Load<QuantizedStorage>(const G4String&, const FieldMapImport::Units&);
@@ -0,0 +1,291 @@
+// ============================
+// src/FieldStatistics.cc
+// ============================
+
+#include "FieldStatistics.hh"
+#include "G4LogicalVolume.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4ios.hh"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+
+namespace {
+  struct Totals
+  {
+    G4long fieldCalls = 0;
+    G4long chargedSteps = 0;
+    G4long fieldSteps = 0;
+    G4long cacheHits = 0;
+    G4long cacheMisses = 0;
+    G4long substeps = 0;
+    G4long retriedSubsteps = 0;
+    std::vector<FieldStatistics::Breakdown> breakdown;
+  };
+  
+  Totals gTotals;
+  std::mutex gTotalsMutex;
+  
+  // Field evaluations per event of the last run printed, to show the
+  // effect of settings changed between runs; negative before the first
+  G4double gPreviousCallsPerEvent = -1.;
+  
+  // Rows of the breakdown that saw any work, as (index, breakdown) in
+  // decreasing order of field calls
+  std::vector<std::pair<G4int, FieldStatistics::Breakdown>> ActiveRows(
+    const std::vector<FieldStatistics::Breakdown>& breakdown)
+  {
+    std::vector<std::pair<G4int, FieldStatistics::Breakdown>> rows;
+    for (std::size_t i = 0; i < breakdown.size(); ++i) {
+      const FieldStatistics::Breakdown& entry = breakdown[i];
+      if (entry.steps > 0 || entry.fieldCalls > 0 || entry.looperKills > 0) {
+        rows.push_back(std::make_pair(static_cast<G4int>(i), entry));
+      }
+    }
+    std::stable_sort(rows.begin(), rows.end(),
+      [](const std::pair<G4int, FieldStatistics::Breakdown>& a,
+         const std::pair<G4int, FieldStatistics::Breakdown>& b) {
+        return a.second.fieldCalls > b.second.fieldCalls;
+      });
+    return rows;
+  }
+  
+  // Name of the logical volume with the given instance ID
+  G4String VolumeName(G4int volumeID)
+  {
+    for (const G4LogicalVolume* volume : *G4LogicalVolumeStore::GetInstance()) {
+      if (volume->GetInstanceID() == volumeID) return volume->GetName();
+    }
+    return "unknown";
+  }
+}
+
+FieldStatistics* FieldStatistics::Instance()
+{
+  static G4ThreadLocal FieldStatistics* instance = nullptr;
+  if (!instance) {
+    instance = new FieldStatistics();
+  }
+  return instance;
+}
+
+FieldStatistics::FieldStatistics()
+{
+  Reset();
+}
+
+void FieldStatistics::Reset()
+{
+  fFieldCalls = 0;
+  fChargedSteps = 0;
+  fFieldSteps = 0;
+  fCacheHits = 0;
+  fCacheMisses = 0;
+  fSubsteps = 0;
+  fRetriedSubsteps = 0;
+  fBreakdown.clear();
+  fOpenStep = -1;
+  fOpenStepCalls = 0;
+  fOpenStepSubsteps = 0;
+  fOpenStepRetried = 0;
+}
+
+FieldStatistics::Breakdown& FieldStatistics::GetBreakdown(Species species,
+                                                          const G4LogicalVolume* volume)
+{
+  std::size_t index = static_cast<std::size_t>(volume->GetInstanceID()) * kNumSpecies + species;
+  if (index >= fBreakdown.size()) {
+    fBreakdown.resize(index + 1, Breakdown());
+  }
+  return fBreakdown[index];
+}
+
+void FieldStatistics::CloseFieldStep()
+{
+  if (fOpenStep >= 0) {
+    Breakdown& entry = fBreakdown[fOpenStep];
+    entry.fieldCalls += fFieldCalls - fOpenStepCalls;
+    entry.substeps += fSubsteps - fOpenStepSubsteps;
+    entry.retriedSubsteps += fRetriedSubsteps - fOpenStepRetried;
+  }
+  fOpenStepCalls = fFieldCalls;
+  fOpenStepSubsteps = fSubsteps;
+  fOpenStepRetried = fRetriedSubsteps;
+}
+
+void FieldStatistics::EnterFieldStep(Species species, const G4LogicalVolume* volume)
+{
+  CloseFieldStep();
+  Breakdown& entry = GetBreakdown(species, volume);
+  ++entry.steps;
+  fOpenStep = &entry - fBreakdown.data();
+}
+
+void FieldStatistics::CountLooperKill(Species species, const G4LogicalVolume* volume)
+{
+  ++GetBreakdown(species, volume).looperKills;
+}
+
+void FieldStatistics::Merge()
+{
+  // The last step's work is complete by now
+  CloseFieldStep();
+  fOpenStep = -1;
+  
+  std::lock_guard<std::mutex> lock(gTotalsMutex);
+  gTotals.fieldCalls += fFieldCalls;
+  gTotals.chargedSteps += fChargedSteps;
+  gTotals.fieldSteps += fFieldSteps;
+  gTotals.cacheHits += fCacheHits;
+  gTotals.cacheMisses += fCacheMisses;
+  gTotals.substeps += fSubsteps;
+  gTotals.retriedSubsteps += fRetriedSubsteps;
+  
+  if (gTotals.breakdown.size() < fBreakdown.size()) {
+    gTotals.breakdown.resize(fBreakdown.size(), Breakdown());
+  }
+  for (std::size_t i = 0; i < fBreakdown.size(); ++i) {
+    Breakdown& total = gTotals.breakdown[i];
+    total.steps += fBreakdown[i].steps;
+    total.fieldCalls += fBreakdown[i].fieldCalls;
+    total.substeps += fBreakdown[i].substeps;
+    total.retriedSubsteps += fBreakdown[i].retriedSubsteps;
+    total.looperKills += fBreakdown[i].looperKills;
+  }
+}
+
+void FieldStatistics::WriteTotal(const G4String& fileName, G4int runID, G4int nEvents)
+{
+  std::lock_guard<std::mutex> lock(gTotalsMutex);
+  
+  std::ofstream file(fileName, std::ios::trunc);
+  if (!file) {
+    G4cerr << "FieldStatistics: cannot write " << fileName << G4endl;
+    return;
+  }
+  
+  G4long looperKills = 0;
+  for (const Breakdown& entry : gTotals.breakdown) {
+    looperKills += entry.looperKills;
+  }
+  
+  file << "{\n"
+       << "  \"run\": " << runID << ",\n"
+       << "  \"events\": " << nEvents << ",\n"
+       << "  \"totals\": {\n"
+       << "    \"chargedSteps\": " << gTotals.chargedSteps << ",\n"
+       << "    \"chargedStepsInField\": " << gTotals.fieldSteps << ",\n"
+       << "    \"fieldCalls\": " << gTotals.fieldCalls << ",\n"
+       << "    \"substeps\": " << gTotals.substeps << ",\n"
+       << "    \"retriedSubsteps\": " << gTotals.retriedSubsteps << ",\n"
+       << "    \"looperKills\": " << looperKills << ",\n"
+       << "    \"cacheHits\": " << gTotals.cacheHits << ",\n"
+       << "    \"cacheMisses\": " << gTotals.cacheMisses << "\n"
+       << "  },\n"
+       << "  \"breakdown\": [";
+  
+  // Logical volume names are plain identifiers, so need no escaping
+  std::vector<std::pair<G4int, Breakdown>> rows = ActiveRows(gTotals.breakdown);
+  for (std::size_t i = 0; i < rows.size(); ++i) {
+    const Breakdown& entry = rows[i].second;
+    Species species = static_cast<Species>(rows[i].first % kNumSpecies);
+    file << ((i == 0) ? "\n" : ",\n")
+         << "    {\"species\": \"" << VolumeRoleTable::GetSpeciesName(species) << "\""
+         << ", \"volume\": \"" << VolumeName(rows[i].first / kNumSpecies) << "\""
+         << ", \"steps\": " << entry.steps
+         << ", \"fieldCalls\": " << entry.fieldCalls
+         << ", \"substeps\": " << entry.substeps
+         << ", \"retriedSubsteps\": " << entry.retriedSubsteps
+         << ", \"looperKills\": " << entry.looperKills << "}";
+  }
+  file << (rows.empty() ? "]\n" : "\n  ]\n") << "}\n";
+  
+  G4cout << "FieldStatistics: wrote " << fileName << G4endl;
+}
+
+void FieldStatistics::PrintTotal(G4int nEvents)
+{
+  std::lock_guard<std::mutex> lock(gTotalsMutex);
+  
+  G4long freeSteps = gTotals.chargedSteps - gTotals.fieldSteps;
+  G4double perEvent = (nEvents > 0) ? 1.0 / nEvents : 0.0;
+  G4double fieldFraction = (gTotals.chargedSteps > 0)
+    ? 100.0 * gTotals.fieldSteps / gTotals.chargedSteps : 0.0;
+  
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "                   FIELD TRANSPORT SUMMARY                       " << G4endl;
+  G4cout << "================================================================" << G4endl;
+  G4cout << std::setw(24) << "" << " | " 
+         << std::setw(15) << "Total" << " | " 
+         << std::setw(15) << "Per event" << G4endl;
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  G4cout << std::setw(24) << "Charged steps" << " | " 
+         << std::setw(15) << gTotals.chargedSteps << " | " 
+         << std::setw(15) << gTotals.chargedSteps * perEvent << G4endl;
+  G4cout << std::setw(24) << "  in field volumes" << " | " 
+         << std::setw(15) << gTotals.fieldSteps << " | " 
+         << std::setw(15) << gTotals.fieldSteps * perEvent << G4endl;
+  G4cout << std::setw(24) << "  straight-line" << " | " 
+         << std::setw(15) << freeSteps << " | " 
+         << std::setw(15) << freeSteps * perEvent << G4endl;
+  G4cout << std::setw(24) << "Field evaluations" << " | " 
+         << std::setw(15) << gTotals.fieldCalls << " | " 
+         << std::setw(15) << gTotals.fieldCalls * perEvent << G4endl;
+  G4cout << std::setw(24) << "Integration substeps" << " | " 
+         << std::setw(15) << gTotals.substeps << " | " 
+         << std::setw(15) << gTotals.substeps * perEvent << G4endl;
+  G4cout << std::setw(24) << "  retried" << " | " 
+         << std::setw(15) << gTotals.retriedSubsteps << " | " 
+         << std::setw(15) << gTotals.retriedSubsteps * perEvent << G4endl;
+  G4long cacheQueries = gTotals.cacheHits + gTotals.cacheMisses;
+  if (cacheQueries > 0) {
+    G4cout << std::setw(24) << "Field cache hits" << " | " 
+           << std::setw(15) << gTotals.cacheHits << " | " 
+           << std::setw(15) << gTotals.cacheHits * perEvent << G4endl;
+    G4cout << std::setw(24) << "Field cache misses" << " | " 
+           << std::setw(15) << gTotals.cacheMisses << " | " 
+           << std::setw(15) << gTotals.cacheMisses * perEvent << G4endl;
+  }
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  G4cout << " Charged steps in field volumes: " << fieldFraction << " %" << G4endl;
+  if (cacheQueries > 0) {
+    G4cout << " Field cache hit rate: " << 100.0 * gTotals.cacheHits / cacheQueries << " %" << G4endl;
+  }
+  G4double callsPerEvent = gTotals.fieldCalls * perEvent;
+  if (gPreviousCallsPerEvent > 0.) {
+    G4cout << " Field evaluations per event: " << callsPerEvent << " vs " << gPreviousCallsPerEvent
+           << " in the previous run (" << std::showpos
+           << 100.0 * (callsPerEvent / gPreviousCallsPerEvent - 1.0) << std::noshowpos << " %)"
+           << G4endl;
+  }
+  
+  std::vector<std::pair<G4int, Breakdown>> rows = ActiveRows(gTotals.breakdown);
+  if (!rows.empty()) {
+    G4cout << "----------------------------------------------------------------" << G4endl;
+    G4cout << " Per species and volume, per event; loopers need /beamTest/actions/stepping" << G4endl;
+    G4cout << std::setw(7) << "Species" << " | " 
+           << std::setw(14) << "Volume" << " | " 
+           << std::setw(9) << "Steps" << " | " 
+           << std::setw(10) << "Calls" << " | " 
+           << std::setw(9) << "Substeps" << " | " 
+           << std::setw(8) << "Retried" << " | " 
+           << std::setw(7) << "Loopers" << G4endl;
+    for (const std::pair<G4int, Breakdown>& row : rows) {
+      const Breakdown& entry = row.second;
+      Species species = static_cast<Species>(row.first % kNumSpecies);
+      G4cout << std::setw(7) << VolumeRoleTable::GetSpeciesName(species) << " | " 
+             << std::setw(14) << VolumeName(row.first / kNumSpecies) << " | " 
+             << std::setw(9) << entry.steps * perEvent << " | " 
+             << std::setw(10) << entry.fieldCalls * perEvent << " | " 
+             << std::setw(9) << entry.substeps * perEvent << " | " 
+             << std::setw(8) << entry.retriedSubsteps * perEvent << " | " 
+             << std::setw(7) << entry.looperKills << G4endl;
+    }
+  }
+  G4cout << "================================================================" << G4endl;
+  
+  gPreviousCallsPerEvent = callsPerEvent;
+  gTotals = Totals();
+}
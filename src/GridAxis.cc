@@ -0,0 +1,118 @@
+// ======================
+// src/GridAxis.cc
+// ======================
+
+#include "GridAxis.hh"
+#include <cmath>
+#include <limits>
+
+namespace {
+  // Relative difference below which neighbouring intervals count as equal
+  const G4double kSpacingTolerance = 1.0e-6;
+}
+
+GridAxis::GridAxis(G4double min, G4double max, G4int nPoints)
+: fPoints(std::max(nPoints, 2)),
+  fMin(min),
+  fInvBinWidth(0.),
+  fUniform(false),
+  fInvSpacing(0.),
+  fLastCell(0)
+{
+  G4double spacing = (max - min) / (fPoints.size() - 1);
+  for (std::size_t i = 0; i < fPoints.size(); ++i) {
+    fPoints[i] = min + i * spacing;
+  }
+  fPoints.back() = max;
+  BuildSegments();
+}
+
+GridAxis::GridAxis(const std::vector<G4double>& points)
+: fPoints(points),
+  fMin(points.front()),
+  fInvBinWidth(0.),
+  fUniform(false),
+  fInvSpacing(0.),
+  fLastCell(0)
+{
+  BuildSegments();
+}
+
+void GridAxis::BuildSegments()
+{
+  fSegments.clear();
+  G4int nPoints = fPoints.size();
+  G4int first = 0;
+  while (first < nPoints - 1) {
+    // Extend the segment while the spacing stays the same
+    G4double spacing = fPoints[first + 1] - fPoints[first];
+    G4int last = first + 1;
+    while (last < nPoints - 1
+           && std::abs(fPoints[last + 1] - fPoints[last] - spacing) <= kSpacingTolerance * spacing) {
+      ++last;
+    }
+    
+    Segment segment;
+    segment.start = fPoints[first];
+    segment.nIntervals = last - first;
+    segment.invSpacing = segment.nIntervals / (fPoints[last] - fPoints[first]);
+    segment.firstPoint = first;
+    fSegments.push_back(segment);
+    first = last;
+  }
+  
+  fUniform = (fSegments.size() == 1);
+  fInvSpacing = fSegments.front().invSpacing;
+  fLastCell = fSegments.front().nIntervals - 1;
+  
+  // Bins of at most half the shortest segment hold at most one segment
+  // start each, however the bin edges round
+  G4double length = fPoints.back() - fPoints.front();
+  G4double minLength = length;
+  for (const Segment& segment : fSegments) {
+    minLength = std::min(minLength, segment.nIntervals / segment.invSpacing);
+  }
+  G4int nBins = static_cast<G4int>(std::ceil(2. * length / minLength));
+  fInvBinWidth = nBins / length;
+  
+  // One spare bin for a coordinate at the end of the axis
+  fBinBoundary.resize(nBins + 1);
+  fBinScale.resize(2*(nBins + 1));
+  fBinOffset.resize(2*(nBins + 1));
+  fBinLastCell.resize(2*(nBins + 1));
+  std::size_t s = 0;
+  for (G4int b = 0; b <= nBins; ++b) {
+    G4double binStart = fMin + b / fInvBinWidth;
+    while (s + 1 < fSegments.size() && fSegments[s + 1].start <= binStart) {
+      ++s;
+    }
+    
+    std::size_t next = std::min(s + 1, fSegments.size() - 1);
+    fBinBoundary[b] = (s + 1 < fSegments.size()) ? fSegments[s + 1].start
+                                                  : std::numeric_limits<G4double>::infinity();
+    for (G4int i = 0; i < 2; ++i) {
+      const Segment& segment = fSegments[(i == 0) ? s : next];
+      fBinScale[2*b + i] = segment.invSpacing;
+      fBinOffset[2*b + i] = segment.firstPoint - segment.start * segment.invSpacing;
+      fBinLastCell[2*b + i] = segment.firstPoint + segment.nIntervals - 1;
+    }
+  }
+}
+
+G4double GridAxis::GetMinSpacing() const
+{
+  G4double spacing = std::numeric_limits<G4double>::max();
+  for (const Segment& segment : fSegments) {
+    spacing = std::min(spacing, 1. / segment.invSpacing);
+  }
+  return spacing;
+}
+
+G4double GridAxis::GetMaxSpacing() const
+{
+  G4double spacing = 0.;
+  for (const Segment& segment : fSegments) {
+    spacing = std::max(spacing, 1. / segment.invSpacing);
+  }
+  return spacing;
+}
@@ -0,0 +1,98 @@
+// ==================================
+// src/HeliumCoolingProcess.cc
+// ==================================
+
+#include "HeliumCoolingProcess.hh"
+#include "VolumeRoleTable.hh"
+#include "StepTrace.hh"
+#include "G4Step.hh"
+#include "G4StepPoint.hh"
+#include "G4Track.hh"
+#include "G4DynamicParticle.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4GenericMessenger.hh"
+#include "G4SystemOfUnits.hh"
+#include <cmath>
+
+HeliumCoolingProcess::HeliumCoolingProcess(const G4String& name)
+: G4VDiscreteProcess(name, fGeneral),
+  fRoleTable(VolumeRoleTable::Instance()),
+  fStepTrace(StepTrace::Instance()),
+  fEnabled(true),
+  // A new calibration, 2% per cm of path. The stepping action this replaces
+  // took 2% per step, whatever its length, so it fixed no length scale
+  fCoolingLength(-1.0*cm/std::log(0.98)),
+  fMessenger(nullptr)
+{
+  pParticleChange = &fParticleChange;
+  
+  fMessenger = new G4GenericMessenger(this, "/beamTest/helium/", "Helium cloud transverse cooling");
+  
+  fMessenger->DeclareProperty("enable", fEnabled,
+    "Reduce the transverse momentum of charged tracks in the helium cloud")
+    .SetParameterName("enable", false);
+  
+  fMessenger->DeclarePropertyWithUnit("coolingLength", "cm", fCoolingLength,
+    "Path length over which px and py fall by a factor e")
+    .SetParameterName("length", false)
+    .SetRange("length>0.");
+}
+
+HeliumCoolingProcess::~HeliumCoolingProcess()
+{
+  delete fMessenger;
+}
+
+G4bool HeliumCoolingProcess::IsApplicable(const G4ParticleDefinition& particle)
+{
+  return particle.GetPDGCharge() != 0. && !particle.IsShortLived();
+}
+
+G4double HeliumCoolingProcess::PostStepGetPhysicalInteractionLength(const G4Track&, G4double,
+                                                                    G4ForceCondition* condition)
+{
+  *condition = StronglyForced;
+  return DBL_MAX;
+}
+
+G4double HeliumCoolingProcess::GetMeanFreePath(const G4Track&, G4double, G4ForceCondition*)
+{
+  return DBL_MAX;
+}
+
+G4VParticleChange* HeliumCoolingProcess::PostStepDoIt(const G4Track& track, const G4Step& step)
+{
+  fParticleChange.Initialize(track);
+  
+  // Strongly forced processes also run on tracks another process stopped
+  G4double length = step.GetStepLength();
+  if (!fEnabled || length <= 0. || track.GetTrackStatus() != fAlive) {
+    return &fParticleChange;
+  }
+  
+  const G4StepPoint* prePoint = step.GetPreStepPoint();
+  const G4LogicalVolume* volume = prePoint->GetTouchableHandle()->GetVolume()->GetLogicalVolume();
+  if (fRoleTable->GetRole(volume) != kHeliumCloud) {
+    return &fParticleChange;
+  }
+  
+  fStepTrace->Trace(&step, StepTrace::kCooling);
+  
+  // The track already holds the momentum at the end of the step; the
+  // post-step change sets the scaled one outright
+  G4double factor = std::exp(-length/fCoolingLength);
+  G4ThreeVector momentum = track.GetMomentum();
+  momentum.setX(momentum.x()*factor);
+  momentum.setY(momentum.y()*factor);
+  
+  G4double mass = track.GetDynamicParticle()->GetMass();
+  G4double newMomentumMag = momentum.mag();
+  G4double newEnergy = std::sqrt(newMomentumMag*newMomentumMag + mass*mass) - mass;
+  
+  fParticleChange.ProposeMomentumDirection(momentum.unit());
+  fParticleChange.ProposeEnergy(newEnergy);
+  
+  return &fParticleChange;
+}
@@ -3,16 +3,71 @@
 // ==========================
 
 #include "MagneticField.hh"
+#include "FieldMap2D.hh"
+#include "FieldStatistics.hh"
 #include "G4SystemOfUnits.hh"
 #include "G4GenericMessenger.hh"
+#include <algorithm>
 #include <cmath>
 
+namespace {
+  // Kernel of the batched evaluation: the model of GetFieldRZ with the
+  // branches turned into selects, and Br*x/r written as
+  // -slope*(1/2 - r/(3R))*x, which needs no division. The arrays are
+  // declared not to overlap so the loop vectorises without alias checks.
+  void SolenoidBatch(G4int n,
+                     const G4double* __restrict px, const G4double* __restrict py,
+                     const G4double* __restrict pz,
+                     G4double* __restrict bx, G4double* __restrict by, G4double* __restrict bz,
+                     G4double maxField, G4double zMin, G4double zMax, G4double taperLength,
+                     G4double maxRadius)
+  {
+    const G4double invTaper = 1.0 / taperLength;
+    const G4double invRadius = 1.0 / maxRadius;
+    const G4double maxRadius2 = maxRadius * maxRadius;
+    const G4double taperSlope = maxField / taperLength;
+    
+    for (G4int i = 0; i < n; ++i) {
+      G4double x = px[i];
+      G4double y = py[i];
+      G4double z = pz[i];
+      G4double r2 = x*x + y*y;
+      G4double r = std::sqrt(r2);
+      
+      // Both tapers are computed and the right one selected, since the
+      // compiler will not speculate floating-point arithmetic into a select
+      G4double entryTaper = (z - zMin) * invTaper;
+      G4double exitTaper = (zMax - z) * invTaper;
+      G4bool inEntry = z < zMin + taperLength;
+      G4bool inExit = z > zMax - taperLength;
+      G4double taper = inEntry ? entryTaper : (inExit ? exitTaper : 1.0);
+      G4double slope = inEntry ? taperSlope : (inExit ? -taperSlope : 0.0);
+      
+      G4bool inside = z >= zMin && z <= zMax && r2 <= maxRadius2;
+      G4double mask = inside ? 1.0 : 0.0;
+      
+      G4double brOverR = -slope * (0.5 - r * invRadius / 3.0) * mask;
+      bx[i] = brOverR * x;
+      by[i] = brOverR * y;
+      bz[i] = maxField * taper * (1.0 - r * invRadius) * mask;
+    }
+  }
+}
+
 MagneticField::MagneticField()
+: MagneticField(7.0*tesla, -200.0*cm, 1000.0*cm, 50.0*cm, 90.0*cm)
+{
+}
+
+MagneticField::MagneticField(G4double maxField, G4double zMin, G4double zMax,
+                             G4double taperLength, G4double maxRadius)
 : G4ElectroMagneticField(),  // Change from G4MagneticField to G4ElectroMagneticField
-  fMaxField(7.0*tesla),
-  fZMin(-200.0*cm),
-  fZMax(1000.0*cm),
-  fZTaperLength(50.0*cm)
+  fMaxField(maxField),
+  fZMin(zMin),
+  fZMax(zMax),
+  fZTaperLength(taperLength),
+  fMaxRadius(maxRadius),
+  fStatistics(FieldStatistics::Instance())
 {
 }
 
@@ -22,47 +77,85 @@ MagneticField::~MagneticField()
 
 void MagneticField::GetFieldValue(const G4double point[4], G4double* field) const
 {
+  fStatistics->CountFieldCall();
+  
+  if (fFieldMap) {
+    fFieldMap->GetFieldValue(point, field);
+    return;
+  }
+  
   // Initialize field to zero for all components (both magnetic and electric)
   for (G4int i=0; i<6; i++) {
     field[i] = 0.0;
   }
   
-  // Get position
+  // Check if outside field region before paying for the radius
   G4double z = point[2];
+  if (z < fZMin || z > fZMax) {
+    return;
+  }
+  
+  G4double distFromCenter = std::sqrt(point[0]*point[0] + point[1]*point[1]);
+  G4double fieldRZ[4];
+  GetFieldRZ(distFromCenter, z, fieldRZ);
+  
+  // Note: For G4ElectroMagneticField, the field array has 6 components:
+  // field[0,1,2] = Bx, By, Bz (magnetic field)
+  // field[3,4,5] = Ex, Ey, Ez (electric field)
+  // We're setting only B, leaving the electric field components at zero
+  if (distFromCenter > 0.) {
+    field[0] = fieldRZ[0] * point[0] / distFromCenter;
+    field[1] = fieldRZ[0] * point[1] / distFromCenter;
+  }
+  field[2] = fieldRZ[1];
+}
+
+void MagneticField::GetFieldValues(G4int n, const FieldPoints& points, const FieldValues& values) const
+{
+  fStatistics->CountFieldCalls(n);
+  
+  if (fFieldMap) {
+    fFieldMap->GetFieldValues(n, points, values);
+    return;
+  }
+  
+  SolenoidBatch(n, points.x, points.y, points.z, values.bx, values.by, values.bz,
+                fMaxField, fZMin, fZMax, fZTaperLength, fMaxRadius);
+  std::fill_n(values.ex, n, 0.0);
+  std::fill_n(values.ey, n, 0.0);
+  std::fill_n(values.ez, n, 0.0);
+}
+
+void MagneticField::GetFieldRZ(G4double r, G4double z, G4double fieldRZ[4]) const
+{
+  fieldRZ[0] = fieldRZ[1] = fieldRZ[2] = fieldRZ[3] = 0.0;
   
   // Check if outside field region
-  if (z < fZMin || z > fZMax) {
+  if (z < fZMin || z > fZMax || r > fMaxRadius) {
     return;
   }
   
-  // Calculate field strength based on position (tapering at edges)
+  // Calculate field strength based on position (tapering at edges),
+  // together with its slope along z
   G4double strength = fMaxField;
+  G4double slope = 0.0;
   
   // Linear tapering at start of field region
   if (z < fZMin + fZTaperLength) {
     strength *= (z - fZMin) / fZTaperLength;
+    slope = fMaxField / fZTaperLength;
   }
   // Linear tapering at end of field region
   else if (z > fZMax - fZTaperLength) {
     strength *= (fZMax - z) / fZTaperLength;
+    slope = -fMaxField / fZTaperLength;
   }
   
-  // Set field along z direction with concentric solenoid profile
-  // For simplicity, using a linear increase from edge to center
-  G4double distFromCenter = std::sqrt(point[0]*point[0] + point[1]*point[1]);
-  G4double maxRadius = 90.0*cm; // Maximum radius of the field effect
+  // Concentric solenoid profile, increasing linearly from edge to center
+  G4double radialFactor = 1.0 - r/fMaxRadius;
+  fieldRZ[1] = strength * radialFactor;
   
-  if (distFromCenter <= maxRadius) {
-    // Create a profile with increasing field toward the center
-    G4double radialFactor = 1.0 - distFromCenter/maxRadius;
-    strength *= radialFactor;
-    
-    // Apply the field in the z direction (magnetic field component)
-    field[2] = strength;
-    
-    // Note: For G4ElectroMagneticField, the field array has 6 components:
-    // field[0,1,2] = Bx, By, Bz (magnetic field)
-    // field[3,4,5] = Ex, Ey, Ez (electric field)
-    // We're setting only Bz, leaving the electric field components at zero
-  }
-}
\ No newline at end of file
+  // Radial component from div B = 0 for Bz = B(z)*(1 - r/R):
+  //   Br = -dB/dz * (r/2 - r^2/(3R))
+  fieldRZ[0] = -slope * (0.5*r - r*r/(3.0*fMaxRadius));
+}
@@ -0,0 +1,57 @@
+// ========================
+// src/MappedFile.cc
+// ========================
+
+#include "MappedFile.hh"
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BEAMTEST_HAVE_MMAP 1
+#endif
+
+MappedFile::MappedFile(const G4String& fileName)
+: fData(nullptr),
+  fSize(0),
+  fMapped(false)
+{
+#ifdef BEAMTEST_HAVE_MMAP
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  
+  struct stat status;
+  if (fstat(fd, &status) == 0 && status.st_size > 0) {
+    void* address = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (address != MAP_FAILED) {
+      fData = static_cast<const char*>(address);
+      fSize = status.st_size;
+      fMapped = true;
+    }
+  }
+  // The mapping stays valid after the descriptor is closed
+  close(fd);
+  if (fMapped) return;
+#endif
+  
+  std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) return;
+  
+  fBuffer.resize(file.tellg());
+  file.seekg(0);
+  if (!fBuffer.empty() && file.read(fBuffer.data(), fBuffer.size())) {
+    fData = fBuffer.data();
+    fSize = fBuffer.size();
+  }
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef BEAMTEST_HAVE_MMAP
+  if (fMapped) {
+    munmap(const_cast<char*>(fData), fSize);
+  }
+#endif
+}
@@ -0,0 +1,91 @@
+// ==========================
+// src/NtupleOutput.cc
+// ==========================
+
+#include "NtupleOutput.hh"
+#include "G4AnalysisManager.hh"
+#include "G4Threading.hh"
+#include "G4ios.hh"
+
+namespace {
+  // Columns of the trajectory ntuple after EventID and Detector
+  const char* const kPhaseSpaceColumns[] = { "X", "PX", "Y", "PY", "Z", "PZ" };
+}
+
+const char* const NtupleOutput::kNtupleNames[kNumNtuples] = { "trajectory", "particle" };
+
+NtupleOutput::NtupleOutput()
+: fManager(G4AnalysisManager::Instance()),
+  fIDs(),
+  fRows(),
+  fOpen(false)
+{
+  fManager->SetVerboseLevel(0);
+  
+  fIDs[kTrajectory] = fManager->CreateNtuple(kNtupleNames[kTrajectory], "Phase space at the detector planes");
+  fManager->CreateNtupleIColumn("EventID");
+  fManager->CreateNtupleSColumn("Detector");
+  for (const char* column : kPhaseSpaceColumns) {
+    fManager->CreateNtupleDColumn(column);
+  }
+  fManager->FinishNtuple();
+  
+  fIDs[kParticle] = fManager->CreateNtuple(kNtupleNames[kParticle], "Muons and pions at the detector planes");
+  fManager->CreateNtupleIColumn("EventID");
+  fManager->CreateNtupleSColumn("Detector");
+  fManager->CreateNtupleSColumn("ParticleName");
+  fManager->CreateNtupleDColumn("Energy");
+  fManager->FinishNtuple();
+}
+
+G4bool NtupleOutput::Open(const G4String& fileName, const G4String& fileType)
+{
+  // Only root merges the workers' ntuples; it must be asked for before the
+  // file is opened
+  fManager->SetDefaultFileType(fileType);
+  if (fileType == "root" && G4Threading::IsMultithreadedApplication()) {
+    fManager->SetNtupleMerging(true);
+  }
+  
+  fOpen = fManager->OpenFile(fileName);
+  if (!fOpen) {
+    G4cerr << "NtupleOutput: cannot open " << fileName << " as " << fileType
+           << " (hdf5 needs Geant4 built with HDF5)" << G4endl;
+  }
+  fRows[kTrajectory] = 0;
+  fRows[kParticle] = 0;
+  return fOpen;
+}
+
+void NtupleOutput::Close()
+{
+  if (!fOpen) return;
+  
+  fManager->Write();
+  fManager->CloseFile();
+  fOpen = false;
+}
+
+void NtupleOutput::AddTrajectory(G4int eventID, const char* detector, const G4double values[6])
+{
+  G4int id = fIDs[kTrajectory];
+  fManager->FillNtupleIColumn(id, 0, eventID);
+  fManager->FillNtupleSColumn(id, 1, detector);
+  for (G4int i = 0; i < 6; ++i) {
+    fManager->FillNtupleDColumn(id, 2 + i, values[i]);
+  }
+  fManager->AddNtupleRow(id);
+  ++fRows[kTrajectory];
+}
+
+void NtupleOutput::AddParticle(G4int eventID, const char* detector, const char* particle,
+                               G4double energy)
+{
+  G4int id = fIDs[kParticle];
+  fManager->FillNtupleIColumn(id, 0, eventID);
+  fManager->FillNtupleSColumn(id, 1, detector);
+  fManager->FillNtupleSColumn(id, 2, particle);
+  fManager->FillNtupleDColumn(id, 3, energy);
+  fManager->AddNtupleRow(id);
+  ++fRows[kParticle];
+}
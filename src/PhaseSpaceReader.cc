@@ -0,0 +1,136 @@
+// ==============================
+// src/PhaseSpaceReader.cc
+// ==============================
+
+#include "PhaseSpaceReader.hh"
+#include "G4ios.hh"
+#include <cstring>
+
+using namespace PhaseSpaceFormat;
+
+const char* const PhaseSpaceFormat::kColumnNames[kNumColumns] = {
+  "EventID", "Detector", "Species", "X", "PX", "Y", "PY", "Z", "PZ"
+};
+
+PhaseSpaceReader::Group::Group(const char* data, std::size_t realSize)
+: fData(data),
+  fHeader(reinterpret_cast<const GroupHeader*>(data)),
+  fRealSize(realSize)
+{
+  GetColumnOffsets(fHeader->nRows, realSize, fOffsets);
+}
+
+G4double PhaseSpaceReader::Group::GetValue(Column column, std::size_t row) const
+{
+  switch (column) {
+    case kEventID:  return GetEventIDs()[row];
+    case kDetector: return GetDetectors()[row];
+    case kSpecies:  return GetSpecies()[row];
+    default:
+      return (fRealSize == sizeof(double)) ? GetColumn<double>(column)[row]
+                                           : GetColumn<float>(column)[row];
+  }
+}
+
+PhaseSpaceReader::PhaseSpaceReader(const G4String& fileName)
+: fFile(fileName),
+  fHeader(nullptr),
+  fNRows(0),
+  fValid(false)
+{
+  fValid = Check(fileName);
+  if (!fValid) {
+    fGroupOffsets.clear();
+  }
+}
+
+G4bool PhaseSpaceReader::Check(const G4String& fileName)
+{
+  if (!fFile.IsValid()) {
+    G4cerr << "PhaseSpaceReader: cannot read " << fileName << G4endl;
+    return false;
+  }
+  
+  const char* data = fFile.GetData();
+  std::size_t size = fFile.GetSize();
+  if (size < sizeof(FileHeader) + sizeof(Footer)) {
+    G4cerr << "PhaseSpaceReader: " << fileName << " is too short" << G4endl;
+    return false;
+  }
+  
+  fHeader = reinterpret_cast<const FileHeader*>(data);
+  if (std::memcmp(fHeader->magic, kFileMagic, sizeof(kFileMagic)) != 0
+      || fHeader->version != kVersion
+      || (fHeader->realSize != sizeof(float) && fHeader->realSize != sizeof(double))) {
+    G4cerr << "PhaseSpaceReader: " << fileName << " is not a phase-space file of version "
+           << kVersion << G4endl;
+    return false;
+  }
+  
+  Footer footer;
+  std::memcpy(&footer, data + size - sizeof(Footer), sizeof(Footer));
+  std::size_t dataStart = sizeof(FileHeader) + fHeader->dictionarySize;
+  std::size_t indexSize = footer.nGroups * sizeof(std::uint64_t);
+  if (std::memcmp(footer.magic, kFooterMagic, sizeof(kFooterMagic)) != 0
+      || dataStart + sizeof(Footer) > size
+      || footer.nGroups > (size - dataStart - sizeof(Footer)) / sizeof(std::uint64_t)) {
+    G4cerr << "PhaseSpaceReader: " << fileName << " is truncated" << G4endl;
+    return false;
+  }
+  std::size_t indexStart = size - sizeof(Footer) - indexSize;
+  
+  // Names of the dictionary, each ending in '\0'
+  const char* name = data + sizeof(FileHeader);
+  const char* dictionaryEnd = data + dataStart;
+  for (std::uint32_t i = 0; i < fHeader->nDetectors + fHeader->nSpecies; ++i) {
+    const char* end = static_cast<const char*>(std::memchr(name, '\0', dictionaryEnd - name));
+    if (!end) {
+      G4cerr << "PhaseSpaceReader: " << fileName << " has a broken dictionary" << G4endl;
+      return false;
+    }
+    ((i < fHeader->nDetectors) ? fDetectorNames : fSpeciesNames).push_back(name);
+    name = end + 1;
+  }
+  
+  fGroupOffsets.resize(footer.nGroups);
+  std::memcpy(fGroupOffsets.data(), data + indexStart, indexSize);
+  for (std::uint64_t offset : fGroupOffsets) {
+    GroupHeader header;
+    if (offset < dataStart || offset % 8 != 0 || offset + sizeof(GroupHeader) > indexStart) {
+      G4cerr << "PhaseSpaceReader: " << fileName << " has a broken group index" << G4endl;
+      return false;
+    }
+    std::memcpy(&header, data + offset, sizeof(GroupHeader));
+    if (header.nRows > indexStart - offset) {
+      G4cerr << "PhaseSpaceReader: " << fileName << " has a broken group at " << offset << G4endl;
+      return false;
+    }
+    
+    std::size_t columnOffsets[kNumColumns + 1];
+    GetColumnOffsets(header.nRows, fHeader->realSize, columnOffsets);
+    if (header.size != columnOffsets[kNumColumns] || header.size > indexStart - offset) {
+      G4cerr << "PhaseSpaceReader: " << fileName << " has a broken group at " << offset << G4endl;
+      return false;
+    }
+    fNRows += header.nRows;
+  }
+  
+  if (fNRows != footer.nRows) {
+    G4cerr << "PhaseSpaceReader: " << fileName << " holds " << fNRows << " rows, not "
+           << footer.nRows << G4endl;
+    return false;
+  }
+  return true;
+}
+
+const char* PhaseSpaceReader::GetDetectorName(G4int code) const
+{
+  if (code < 0 || code >= static_cast<G4int>(fDetectorNames.size())) return "unknown";
+  return fDetectorNames[code];
+}
+
+const char* PhaseSpaceReader::GetSpeciesName(G4int code) const
+{
+  if (code < 0 || code >= static_cast<G4int>(fSpeciesNames.size())) return "unknown";
+  return fSpeciesNames[code];
+}
@@ -0,0 +1,200 @@
+// ==============================
+// src/PhaseSpaceWriter.cc
+// ==============================
+
+#include "PhaseSpaceWriter.hh"
+#include "PhaseSpaceReader.hh"
+#include "VolumeRoleTable.hh"
+#include "G4ios.hh"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+using namespace PhaseSpaceFormat;
+
+namespace {
+  const char kZeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  
+  void WritePadded(BufferedFile& file, const void* data, std::size_t size)
+  {
+    file.Write(data, size);
+    file.Write(kZeros, Pad8(size) - size);
+  }
+  
+  template <class T>
+  Range GetRange(const std::vector<T>& values)
+  {
+    auto extremes = std::minmax_element(values.begin(), values.end());
+    return { static_cast<double>(*extremes.first), static_cast<double>(*extremes.second) };
+  }
+  
+  void WriteFooter(BufferedFile& file, const std::vector<std::uint64_t>& groupOffsets,
+                   std::uint64_t nRows)
+  {
+    file.Write(groupOffsets.data(), groupOffsets.size() * sizeof(std::uint64_t));
+    
+    Footer footer;
+    footer.nRows = nRows;
+    footer.nGroups = groupOffsets.size();
+    std::memcpy(footer.magic, kFooterMagic, sizeof(footer.magic));
+    file.Write(&footer, sizeof(footer));
+  }
+}
+
+PhaseSpaceWriter::PhaseSpaceWriter()
+: fRowGroupSize(0),
+  fDoublePrecision(false),
+  fRows(0)
+{
+}
+
+PhaseSpaceWriter::~PhaseSpaceWriter()
+{
+  Close();
+}
+
+G4bool PhaseSpaceWriter::Open(const G4String& fileName, G4int rowGroupSize,
+                              G4bool doublePrecision, std::size_t bufferSize)
+{
+  Close();
+  if (!fFile.Open(fileName, bufferSize)) return false;
+  
+  fRowGroupSize = rowGroupSize;
+  fDoublePrecision = doublePrecision;
+  fGroupOffsets.clear();
+  fRows = 0;
+  
+  fEventIDs.reserve(rowGroupSize);
+  fDetectors.reserve(rowGroupSize);
+  fSpecies.reserve(rowGroupSize);
+  for (std::vector<G4double>& column : fValues) {
+    column.reserve(rowGroupSize);
+  }
+  
+  std::string dictionary;
+  for (G4int i = 0; i < kNumDetectors; ++i) {
+    dictionary += VolumeRoleTable::GetDetectorName(i);
+    dictionary += '\0';
+  }
+  for (G4int s = 0; s < kNumSpecies; ++s) {
+    dictionary += VolumeRoleTable::GetSpeciesName(static_cast<Species>(s));
+    dictionary += '\0';
+  }
+  
+  FileHeader header;
+  std::memcpy(header.magic, kFileMagic, sizeof(header.magic));
+  header.version = kVersion;
+  header.realSize = doublePrecision ? sizeof(double) : sizeof(float);
+  header.rowGroupSize = rowGroupSize;
+  header.nDetectors = kNumDetectors;
+  header.nSpecies = kNumSpecies;
+  header.dictionarySize = Pad8(dictionary.size());
+  fFile.Write(&header, sizeof(header));
+  WritePadded(fFile, dictionary.data(), dictionary.size());
+  return true;
+}
+
+void PhaseSpaceWriter::Close()
+{
+  if (!fFile.IsOpen()) return;
+  
+  WriteGroup();
+  WriteFooter(fFile, fGroupOffsets, fRows);
+  fFile.Close();
+}
+
+void PhaseSpaceWriter::WriteGroup()
+{
+  std::size_t nRows = fEventIDs.size();
+  if (nRows == 0) return;
+  
+  std::size_t offsets[kNumColumns + 1];
+  GetColumnOffsets(nRows, fDoublePrecision ? sizeof(double) : sizeof(float), offsets);
+  
+  GroupHeader header;
+  header.nRows = nRows;
+  header.size = offsets[kNumColumns];
+  header.ranges[kEventID] = GetRange(fEventIDs);
+  header.ranges[kDetector] = GetRange(fDetectors);
+  header.ranges[kSpecies] = GetRange(fSpecies);
+  for (G4int i = 0; i < kNumRealColumns; ++i) {
+    header.ranges[kX + i] = GetRange(fValues[i]);
+  }
+  
+  fGroupOffsets.push_back(fFile.GetBytes());
+  fFile.Write(&header, sizeof(header));
+  WritePadded(fFile, fEventIDs.data(), nRows * sizeof(std::int32_t));
+  WritePadded(fFile, fDetectors.data(), nRows);
+  WritePadded(fFile, fSpecies.data(), nRows);
+  for (const std::vector<G4double>& column : fValues) {
+    if (fDoublePrecision) {
+      WriteRealColumn<double>(column);
+    } else {
+      WriteRealColumn<float>(column);
+    }
+  }
+  fRows += nRows;
+  
+  fEventIDs.clear();
+  fDetectors.clear();
+  fSpecies.clear();
+  for (std::vector<G4double>& column : fValues) {
+    column.clear();
+  }
+}
+
+template <class Real>
+void PhaseSpaceWriter::WriteRealColumn(const std::vector<G4double>& values)
+{
+  // Converted straight into the file's buffer
+  std::size_t size = values.size() * sizeof(Real);
+  char* out = fFile.Reserve(Pad8(size));
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    Real value = static_cast<Real>(values[i]);
+    std::memcpy(out + i * sizeof(Real), &value, sizeof(Real));
+  }
+  std::memset(out + size, 0, Pad8(size) - size);
+  fFile.Commit(Pad8(size));
+}
+
+G4bool PhaseSpaceWriter::Merge(const G4String& fileName, const std::vector<G4String>& inputs,
+                               std::size_t bufferSize)
+{
+  std::vector<std::unique_ptr<PhaseSpaceReader>> readers;
+  for (const G4String& input : inputs) {
+    readers.emplace_back(new PhaseSpaceReader(input));
+    if (!readers.back()->IsValid()) return false;
+    
+    const PhaseSpaceReader& first = *readers.front();
+    const PhaseSpaceReader& reader = *readers.back();
+    if (reader.GetHeader().realSize != first.GetHeader().realSize
+        || reader.GetDictionarySize() != first.GetDictionarySize()
+        || std::memcmp(reader.GetDictionary(), first.GetDictionary(), first.GetDictionarySize()) != 0) {
+      G4cerr << "PhaseSpaceWriter: " << input << " does not match " << inputs.front() << G4endl;
+      return false;
+    }
+  }
+  if (readers.empty()) return false;
+  
+  BufferedFile file;
+  if (!file.Open(fileName, bufferSize)) return false;
+  
+  // Header and dictionary of the first input, then every group as it is
+  const PhaseSpaceReader& first = *readers.front();
+  file.Write(&first.GetHeader(), sizeof(FileHeader));
+  file.Write(first.GetDictionary(), first.GetDictionarySize());
+  
+  std::vector<std::uint64_t> groupOffsets;
+  std::uint64_t nRows = 0;
+  for (const std::unique_ptr<PhaseSpaceReader>& reader : readers) {
+    for (std::size_t g = 0; g < reader->GetNGroups(); ++g) {
+      PhaseSpaceReader::Group group = reader->GetGroup(g);
+      groupOffsets.push_back(file.GetBytes());
+      file.Write(group.GetData(), group.GetSize());
+      nRows += group.GetNRows();
+    }
+  }
+  WriteFooter(file, groupOffsets, nRows);
+  file.Close();
+  return true;
+}
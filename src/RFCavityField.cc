@@ -3,21 +3,79 @@
 // ================================
 
 #include "RFCavityField.hh"
+#include "BesselTable.hh"
+#include "FieldMap2D.hh"
+#include "FieldStatistics.hh"
 #include "G4SystemOfUnits.hh"
 #include "G4PhysicalConstants.hh"  // For c_light
+#include <algorithm>
 #include <cmath>
 
+namespace {
+  // Largest phase advance taken by recurrence; the truncated series below
+  // are accurate to ~1e-13 there
+  const G4double kMaxPhaseStep = 0.1;
+  
+  // Exact cos/sin after this many recurrence steps, to stop round-off drift
+  const G4int kPhaseResync = 64;
+  
+  // Points compacted at a time by GetFieldValues
+  const G4int kBatchChunk = 256;
+}
+
 RFCavityField::RFCavityField()
+: RFCavityField(1.0*megavolt/m,    // Field amplitude - adjust as needed
+                2856*megahertz,    // Standard S-band RF frequency
+                0*deg,             // Initial phase
+                350*cm - 25*cm,    // Start of RF cavity
+                350*cm + 25*cm,    // End of RF cavity
+                40*cm)             // Maximum radius of field
+{
+}
+
+RFCavityField::RFCavityField(G4double amplitude, G4double frequency, G4double phase,
+                             G4double zMin, G4double zMax, G4double maxRadius)
 : G4ElectroMagneticField(),
-  fAmplitude(1.0*megavolt/m),  // Field amplitude - adjust as needed
-  fFrequency(2856*megahertz),  // Standard S-band RF frequency
-  fPhase(0*deg),               // Initial phase
-  fZmin(350*cm - 25*cm),       // Start of RF cavity
-  fZmax(350*cm + 25*cm),       // End of RF cavity
-  fMaxRadius(40*cm)            // Maximum radius of field
+  fModel(kGaussian),
+  fAmplitude(amplitude),
+  fFrequency(frequency),
+  fPhase(phase),
+  fZmin(zMin),
+  fZmax(zMax),
+  fMaxRadius(maxRadius),
+  fEdgeWidth(std::min(5.0*cm, 0.5*(zMax - zMin))),  // Smooth transition at the edges
+  fFieldRadius(maxRadius),
+  fBessel(&BesselTable::Instance()),
+  fUsePhaseCache(false),
+  fPhaseCacheValid(false),
+  fPhaseCacheUpdates(0),
+  fPhaseCacheTime(0.),
+  fPhaseCacheCos(1.),
+  fPhaseCacheSin(0.),
+  fStatistics(FieldStatistics::Instance())
 {
   // Calculate wavelength from frequency
   fWavelength = c_light / fFrequency;
+  
+  // Constants of the evaluation, so no call recomputes them
+  fOmega = 2.0 * M_PI * fFrequency;
+  fKz = 2.0 * M_PI / fWavelength;
+  fRadialCoeff = 1.0 / (2.0*fMaxRadius*fMaxRadius/4.0);
+  
+  // TM010: the radial wave number is omega/c, which puts the side wall at
+  // the first zero of J0
+  G4double k = fOmega / c_light;
+  fBesselScale = k * k;
+  fMagneticCoeff = -fAmplitude * k / c_light;
+}
+
+void RFCavityField::SetModel(Model model)
+{
+  fModel = model;
+  fFieldRadius = fMaxRadius;
+  if (fModel == kPillbox) {
+    fFieldRadius = std::min(fMaxRadius, BesselTable::kFirstZero / std::sqrt(fBesselScale));
+  }
 }
 
 RFCavityField::~RFCavityField()
@@ -26,6 +84,8 @@ RFCavityField::~RFCavityField()
 
 void RFCavityField::GetFieldValue(const G4double point[4], G4double* field) const
 {
+  fStatistics->CountFieldCall();
+  
   // Clear the field array
   for (G4int i=0; i<6; i++) {
     field[i] = 0.0;
@@ -37,51 +97,245 @@ void RFCavityField::GetFieldValue(const G4double point[4], G4double* field) cons
   G4double z = point[2];
   G4double t = point[3];
   
-  // Calculate distance from z-axis
-  G4double r = std::sqrt(x*x + y*y);
+  // Spatial profile, zero outside the cavity; neither path needs the radius.
+  // Only maps, e.g. imported from Superfish, carry a radial component.
+  G4double r2 = x*x + y*y;
+  G4double spatialEz;
+  G4double spatialErOverR = 0.0;
+  G4double spatialBPhiOverR = 0.0;
+  if (fFieldMap) {
+    G4double values[4];
+    fFieldMap->Interpolate(r2, z, values);
+    spatialErOverR = values[2];
+    spatialEz = values[3];
+    if (fModel == kPillbox && InPillbox(r2, z)) {
+      G4double ez;
+      GetPillboxProfile(r2, ez, spatialBPhiOverR);
+    }
+  } else if (fModel == kPillbox) {
+    if (!InPillbox(r2, z)) {
+      return;
+    }
+    GetPillboxProfile(r2, spatialEz, spatialBPhiOverR);
+  } else {
+    spatialEz = GetSpatialEzR2(r2, z);
+  }
+  if (spatialEz == 0.0 && spatialErOverR == 0.0 && spatialBPhiOverR == 0.0) {
+    return;
+  }
+  
+  // The electric field goes as cos of the phase; the pillbox Bphi, a
+  // quarter period behind, as sin
+  G4double timeFactor;
+  if (fModel == kPillbox) {
+    G4double sinPhase;
+    GetPhaseFactors(t, timeFactor, sinPhase);
+    field[0] = -spatialBPhiOverR * y * sinPhase;   // Bx = -Bphi sin(theta)
+    field[1] = spatialBPhiOverR * x * sinPhase;    // By = Bphi cos(theta)
+  } else {
+    timeFactor = GetTimeFactor(t);
+  }
+  
+  // Set the electric field
+  field[3] = spatialErOverR * x * timeFactor;   // Ex
+  field[4] = spatialErOverR * y * timeFactor;   // Ey
+  field[5] = spatialEz * timeFactor;            // Ez
+}
+
+void RFCavityField::GetFieldValues(G4int n, const FieldPoints& points, const FieldValues& values) const
+{
+  fStatistics->CountFieldCalls(n);
   
+  // Spatial part from the table, or zeros to be filled in below. Either way
+  // the magnetic components come out zero; the pillbox Bphi is added below.
+  if (fFieldMap) {
+    fFieldMap->GetFieldValues(n, points, values);
+  } else {
+    for (G4int i = 0; i < n; ++i) {
+      values.bx[i] = 0.0;
+      values.by[i] = 0.0;
+      values.bz[i] = 0.0;
+      values.ex[i] = 0.0;
+      values.ey[i] = 0.0;
+      values.ez[i] = 0.0;
+    }
+  }
+  
+  // cos and exp do not vectorise, and most points of a batch may lie
+  // outside the short cavity, so masking would pay for them on every point.
+  // Instead the points in the field are compacted into an index list,
+  // without branches, and only those are evaluated. A map, possibly
+  // imported, defines its own extent.
+  const G4double zMin = fZmin;
+  const G4double zMax = fZmax;
+  const G4double maxRadius2 = fFieldRadius * fFieldRadius;
+  const G4bool analytic = !fFieldMap;
+  const G4bool pillbox = (fModel == kPillbox);
+  
+  G4int active[kBatchChunk];
+  for (G4int start = 0; start < n; start += kBatchChunk) {
+    G4int end = std::min(n, start + kBatchChunk);
+    
+    G4int nActive = 0;
+    for (G4int i = start; i < end; ++i) {
+      G4double x = points.x[i];
+      G4double y = points.y[i];
+      G4double z = points.z[i];
+      G4bool inCavity = z >= zMin && z <= zMax && x*x + y*y <= maxRadius2;
+      G4bool inMap = values.ez[i] != 0.0 || values.ex[i] != 0.0 || values.ey[i] != 0.0;
+      active[nActive] = i;
+      nActive += analytic ? inCavity : inMap;
+    }
+    
+    if (!pillbox) {
+      for (G4int k = 0; k < nActive; ++k) {
+        G4int i = active[k];
+        G4double spatialEz = values.ez[i];
+        if (analytic) {
+          G4double r2 = points.x[i]*points.x[i] + points.y[i]*points.y[i];
+          spatialEz = GetSpatialEzR2(r2, points.z[i]);
+        }
+        G4double timeFactor = std::cos(fOmega * points.t[i] + fPhase);
+        values.ex[i] *= timeFactor;
+        values.ey[i] *= timeFactor;
+        values.ez[i] = spatialEz * timeFactor;
+      }
+      continue;
+    }
+    
+    // Pillbox: Ez from the table, or from the map, and Bphi from the table
+    for (G4int k = 0; k < nActive; ++k) {
+      G4int i = active[k];
+      G4double x = points.x[i];
+      G4double y = points.y[i];
+      G4double r2 = x*x + y*y;
+      G4double spatialEz = values.ez[i];
+      G4double spatialBPhiOverR = 0.0;
+      if (analytic || InPillbox(r2, points.z[i])) {
+        G4double ez;
+        GetPillboxProfile(r2, ez, spatialBPhiOverR);
+        if (analytic) spatialEz = ez;
+      }
+      G4double phase = fOmega * points.t[i] + fPhase;
+      G4double cosPhase = std::cos(phase);
+      G4double sinPhase = std::sin(phase);
+      values.bx[i] = -spatialBPhiOverR * y * sinPhase;
+      values.by[i] = spatialBPhiOverR * x * sinPhase;
+      values.ex[i] *= cosPhase;
+      values.ey[i] *= cosPhase;
+      values.ez[i] = spatialEz * cosPhase;
+    }
+  }
+}
+
+G4double RFCavityField::GetSpatialEz(G4double r, G4double z) const
+{
+  return GetSpatialEzR2(r*r, z);
+}
+
+G4double RFCavityField::GetTrackingSpatialEz(G4double r2, G4double z) const
+{
+  if (fFieldMap) {
+    G4double values[4];
+    fFieldMap->Interpolate(r2, z, values);
+    return values[3];
+  }
+  return GetSpatialEzR2(r2, z);
+}
+
+G4double RFCavityField::GetSpatialEzR2(G4double r2, G4double z) const
+{
   // Check if point is inside the cavity volume
-  if (z < fZmin || z > fZmax || r > fMaxRadius) {
-    return;
+  if (z < fZmin || z > fZmax || r2 > fFieldRadius*fFieldRadius) {
+    return 0.0;
+  }
+  
+  if (fModel == kPillbox) {
+    G4double ez;
+    G4double bPhiOverR;
+    GetPillboxProfile(r2, ez, bPhiOverR);
+    return ez;
   }
   
   // Apply a smooth transition at the edges (to avoid discontinuities)
   G4double zFactor = 1.0;
-  G4double edgeWidth = 5.0*cm;
-  if (z < fZmin + edgeWidth) {
-    zFactor = (z - fZmin) / edgeWidth;
-  } else if (z > fZmax - edgeWidth) {
-    zFactor = (fZmax - z) / edgeWidth;
+  if (z < fZmin + fEdgeWidth) {
+    zFactor = (z - fZmin) / fEdgeWidth;
+  } else if (z > fZmax - fEdgeWidth) {
+    zFactor = (fZmax - z) / fEdgeWidth;
   }
   
   // Radial attenuation factor
-  G4double rFactor = 1.0;
-  if (r > 0.0) {
-    rFactor = std::exp(-r*r/(2.0*fMaxRadius*fMaxRadius/4.0));
-  }
+  G4double rFactor = std::exp(-r2*fRadialCoeff);
   
   // Standing wave pattern along z
-  G4double kz = 2.0 * M_PI / fWavelength;
   G4double zPosition = z - fZmin;  // Position relative to cavity start
   
-  // Time-dependent phase factor
-  G4double omega = 2.0 * M_PI * fFrequency;
-  G4double phase = omega * t + fPhase;
-  
-  // Electric field - longitudinal component (Ez)
-  G4double Ez = fAmplitude * std::cos(kz * zPosition) * std::cos(phase);
+  return fAmplitude * std::cos(fKz * zPosition) * zFactor * rFactor;
+}
+
+void RFCavityField::GetPillboxProfile(G4double r2, G4double& ez, G4double& bPhiOverR) const
+{
+  G4double j0;
+  G4double j1OverX;
+  fBessel->Evaluate(r2 * fBesselScale, j0, j1OverX);
+  ez = fAmplitude * j0;
+  bPhiOverR = fMagneticCoeff * j1OverX;
+}
+
+G4double RFCavityField::GetTimeFactor(G4double t) const
+{
+  if (!fUsePhaseCache) {
+    return std::cos(fOmega * t + fPhase);
+  }
   
-  // Apply attenuation factors
-  Ez *= zFactor * rFactor;
+  G4double cosPhase;
+  G4double sinPhase;
+  GetPhaseFactors(t, cosPhase, sinPhase);
+  return cosPhase;
+}
+
+void RFCavityField::GetPhaseFactors(G4double t, G4double& cosPhase, G4double& sinPhase) const
+{
+  if (!fUsePhaseCache) {
+    G4double phase = fOmega * t + fPhase;
+    cosPhase = std::cos(phase);
+    sinPhase = std::sin(phase);
+    return;
+  }
   
-  // Set the electric field (Ez along z-axis)
-  field[3] = 0;     // Ex
-  field[4] = 0;     // Ey
-  field[5] = Ez;    // Ez
+  // Within a track, successive calls are close in time, so the phase
+  // moves by a small delta: rotate the cached (cos, sin) by it using
+  // short Taylor series instead of calling cos and sin again
+  G4double delta = fOmega * (t - fPhaseCacheTime);
+  if (fPhaseCacheValid && std::abs(delta) < kMaxPhaseStep && fPhaseCacheUpdates < kPhaseResync) {
+    G4double d2 = delta * delta;
+    G4double cosDelta = 1.0 - d2/2.0 * (1.0 - d2/12.0 * (1.0 - d2/30.0));
+    G4double sinDelta = delta * (1.0 - d2/6.0 * (1.0 - d2/20.0 * (1.0 - d2/42.0)));
+    cosPhase = fPhaseCacheCos * cosDelta - fPhaseCacheSin * sinDelta;
+    sinPhase = fPhaseCacheSin * cosDelta + fPhaseCacheCos * sinDelta;
+    fPhaseCacheCos = cosPhase;
+    fPhaseCacheSin = sinPhase;
+    fPhaseCacheTime = t;
+    ++fPhaseCacheUpdates;
+    return;
+  }
   
-  // Magnetic field components would be derived from Maxwell's equations
-  // For simplicity and optimal acceleration, we're focusing on the electric field
-  field[0] = 0;     // Bx
-  field[1] = 0;     // By
-  field[2] = 0;     // Bz
-}
\ No newline at end of file
+  // Exact value; cos and sin of one argument compile to a single sincos
+  G4double phase = fOmega * t + fPhase;
+  fPhaseCacheCos = std::cos(phase);
+  fPhaseCacheSin = std::sin(phase);
+  fPhaseCacheTime = t;
+  fPhaseCacheUpdates = 0;
+  fPhaseCacheValid = true;
+  cosPhase = fPhaseCacheCos;
+  sinPhase = fPhaseCacheSin;
+}
+
+void RFCavityField::GetFieldRZ(G4double r, G4double z, G4double fieldRZ[4]) const
+{
+  fieldRZ[0] = 0.0;
+  fieldRZ[1] = 0.0;
+  fieldRZ[2] = 0.0;
+  fieldRZ[3] = GetSpatialEz(r, z);
+}
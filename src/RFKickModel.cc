@@ -0,0 +1,107 @@
+// ==========================
+// src/RFKickModel.cc
+// ==========================
+
+#include "RFKickModel.hh"
+#include "RFCavityField.hh"
+#include "G4FastTrack.hh"
+#include "G4FastStep.hh"
+#include "G4Track.hh"
+#include "G4Step.hh"
+#include "G4StepPoint.hh"
+#include "G4DynamicParticle.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4VSolid.hh"
+#include "G4SystemOfUnits.hh"
+#include <cmath>
+
+RFKickModel::RFKickModel(const G4String& name, G4Region* envelope, const RFCavityField* field)
+: G4VFastSimulationModel(name, envelope),
+  fField(field),
+  fNIntervals(32)
+{
+}
+
+RFKickModel::~RFKickModel()
+{
+}
+
+G4bool RFKickModel::IsApplicable(const G4ParticleDefinition& particle)
+{
+  return particle.GetPDGCharge() != 0. && !particle.IsShortLived();
+}
+
+G4bool RFKickModel::ModelTrigger(const G4FastTrack& fastTrack)
+{
+  // Kick once per crossing: only when the track has just entered the gap
+  const G4Track* track = fastTrack.GetPrimaryTrack();
+  if (track->GetCurrentStepNumber() == 0) return false;
+  
+  const G4Step* step = track->GetStep();
+  if (!step || step->GetPostStepPoint()->GetStepStatus() != fGeomBoundary) return false;
+  
+  return fastTrack.GetPrimaryTrackLocalDirection().z() != 0.;
+}
+
+void RFKickModel::DoIt(const G4FastTrack& fastTrack, G4FastStep& fastStep)
+{
+  const G4Track* track = fastTrack.GetPrimaryTrack();
+  
+  // Straight path from the entry point to the far side of the gap
+  G4double pathLength = fastTrack.GetEnvelopeSolid()->DistanceToOut(
+    fastTrack.GetPrimaryTrackLocalPosition(), fastTrack.GetPrimaryTrackLocalDirection());
+  
+  const G4ThreeVector& entry = track->GetPosition();
+  const G4ThreeVector& direction = track->GetMomentumDirection();
+  G4double velocity = track->GetVelocity();
+  G4double halfPath = 0.5 * pathLength;
+  G4double midTime = track->GetGlobalTime() + halfPath / velocity;
+  
+  // Work done by Ez along the path, written relative to the mid-gap time:
+  //   W = q * (C cos(psi) - S sin(psi)),  psi = omega*t_mid + phase,
+  //   C = int Ez(s) cos(omega (s - s_mid)/v) dz,  S = int Ez(s) sin(...) dz,
+  // so V0*T = hypot(C, S) and the arrival phase offset is atan2(S, C)
+  G4double omega = fField->GetAngularFrequency();
+  G4double h = pathLength / fNIntervals;
+  G4double sumC = 0.;
+  G4double sumS = 0.;
+  for (G4int i = 0; i <= fNIntervals; ++i) {
+    G4double s = i * h;
+    G4ThreeVector point = entry + s * direction;
+    G4double ez = fField->GetTrackingSpatialEz(point.perp2(), point.z());
+    
+    // Simpson weights 1, 4, 2, ..., 4, 1
+    G4double weight = (i == 0 || i == fNIntervals) ? 1. : ((i % 2) ? 4. : 2.);
+    G4double delta = omega * (s - halfPath) / velocity;
+    sumC += weight * ez * std::cos(delta);
+    sumS += weight * ez * std::sin(delta);
+  }
+  G4double scale = h / 3. * direction.z();
+  sumC *= scale;
+  sumS *= scale;
+  
+  G4double psi = omega * midTime + fField->GetPhase();
+  G4double voltage = sumC * std::cos(psi) - sumS * std::sin(psi);
+  G4double energyGain = track->GetDynamicParticle()->GetCharge() * voltage;
+  
+  fastStep.ProposePrimaryTrackFinalPosition(entry + pathLength * direction, false);
+  fastStep.ProposePrimaryTrackFinalTime(track->GetGlobalTime() + pathLength / velocity);
+  fastStep.ProposePrimaryTrackPathLength(pathLength);
+  fastStep.ProposeTotalEnergyDeposited(0.);
+  
+  // The longitudinal field changes pz only
+  G4double mass = track->GetDynamicParticle()->GetMass();
+  G4double newEnergy = track->GetKineticEnergy() + energyGain;
+  G4ThreeVector momentum = track->GetMomentum();
+  G4double newMomentum2 = newEnergy * (newEnergy + 2.0 * mass);
+  G4double newPz2 = newMomentum2 - momentum.perp2();
+  if (newEnergy <= 0. || newPz2 <= 0.) {
+    // Stopped in the gap
+    fastStep.KillPrimaryTrack();
+    return;
+  }
+  
+  G4double newPz = std::copysign(std::sqrt(newPz2), momentum.z());
+  G4ThreeVector newDirection = G4ThreeVector(momentum.x(), momentum.y(), newPz).unit();
+  fastStep.ProposePrimaryTrackFinalKineticEnergyAndDirection(newEnergy, newDirection, false);
+}
@@ -3,6 +3,9 @@
 // ========================
 
 #include "RunAction.hh"
+#include "StepTrace.hh"
+#include "FieldStatistics.hh"
+#include "EventOutput.hh"
 #include "G4Run.hh"
 #include "G4RunManager.hh"
 #include "G4UnitsTable.hh"
@@ -15,8 +18,14 @@
 
 
 RunAction::RunAction()
-: G4UserRunAction()
+: G4UserRunAction(),
+  fParticleCounts(),
+  fTotalEnergy()
 {
+  // Create the step trace and event output of this thread so their
+  // commands exist on every thread
+  StepTrace::Instance();
+  EventOutput::Instance();
 }
 
 RunAction::~RunAction()
@@ -28,40 +37,74 @@ void RunAction::BeginOfRunAction(const G4Run* run)
   // Inform the runManager to save random number seed
   G4RunManager::GetRunManager()->SetRandomNumberStore(false);
   
+  // Map volumes and particles to roles and species now that geometry is closed
+  VolumeRoleTable::Instance()->Build();
+  
+  // Field transport counters of this thread
+  FieldStatistics::Instance()->Reset();
+  
+  // Every step reaches the trace only through the stepping action
+  if (G4RunManager::GetRunManager()->GetRunManagerType() != G4RunManager::masterRM
+      && StepTrace::Instance()->GetLevel() > 1
+      && !G4RunManager::GetRunManager()->GetUserSteppingAction()) {
+    G4cerr << "StepTrace: level 2 records every step only with /beamTest/actions/stepping "
+              "true; without it only detector hits and cooling steps are traced" << G4endl;
+  }
+  
+  // Output shards of this thread are opened on its first event
+  EventOutput::Instance()->BeginOfRun(run->GetRunID());
+  
   // Clear particle counters
-  fParticleCounts.clear();
-  fTotalEnergy.clear();
+  for (G4int i = 0; i < kNumDetectors; ++i) {
+    for (G4int s = 0; s < kNumSpecies; ++s) {
+      fParticleCounts[i][s] = 0;
+      fTotalEnergy[i][s] = 0.0;
+    }
+  }
   
   G4cout << "### Run " << run->GetRunID() << " starts." << G4endl;
 }
 
 void RunAction::EndOfRunAction(const G4Run* run)
 {
+  // Flush whatever the step trace of this thread still holds
+  StepTrace::Instance()->Dump("end of run");
+  
+  // Workers merge before the master's end of run, which prints the total
+  FieldStatistics::Instance()->Merge();
+  
+  // Likewise workers hand over their output shards before the master merges them
+  EventOutput::Instance()->EndOfRun();
+  
   G4int nofEvents = run->GetNumberOfEvent();
   if (nofEvents == 0) return;
   
+  if (IsMaster()) {
+    EventOutput::Instance()->MergeShards(run->GetRunID());
+    G4String fileName = "field_statistics_run" + std::to_string(run->GetRunID()) + ".json";
+    FieldStatistics::WriteTotal(fileName, run->GetRunID(), nofEvents);
+    FieldStatistics::PrintTotal(nofEvents);
+  }
+  
   G4cout << "### Run " << run->GetRunID() << " completed." << G4endl;
   
   // Print particle summary
   PrintParticleSummary();
 }
 
-// Then update the AddParticle method
-void RunAction::AddParticle(const G4String& detectorName, const G4String& particleName, G4double energy)
+void RunAction::AddParticle(G4int detectorIndex, Species species, G4double energy)
 {
   // Only count muons and pions
-  if (particleName == "mu+" || particleName == "mu-" || 
-      particleName == "pi+" || particleName == "pi-" || 
-      particleName == "pi0") {
+  if (VolumeRoleTable::IsMuonOrPion(species)) {
     
     // Lock the mutex to ensure thread safety
     std::lock_guard<std::mutex> lock(fMutex);
     
     // Increment count
-    fParticleCounts[detectorName][particleName]++;
+    fParticleCounts[detectorIndex][species]++;
     
     // Add energy
-    fTotalEnergy[detectorName][particleName] += energy;
+    fTotalEnergy[detectorIndex][species] += energy;
   }
 }
 void RunAction::PrintParticleSummary()
@@ -77,28 +120,24 @@ void RunAction::PrintParticleSummary()
          << std::setw(15) << "Average Energy" << G4endl;
   G4cout << "----------------------------------------------------------------" << G4endl;
   
-  // List of detectors to report on
-  std::vector<G4String> detectors = {"Detector1", "Detector2", "Detector3"};
-  
-  // List of particle types to report on
-  std::vector<G4String> particles = {"mu+", "mu-", "pi+", "pi-", "pi0"};
-  
   // Track totals
   int totalParticles = 0;
   G4double totalEnergy = 0.0;
   
   // Loop through detectors
-  for (const auto& detector : detectors) {
+  for (G4int detectorIndex = 0; detectorIndex < kNumDetectors; ++detectorIndex) {
+    const char* detector = VolumeRoleTable::GetDetectorName(detectorIndex);
     bool detectorHasParticles = false;
     int detectorTotal = 0;
     G4double detectorEnergy = 0.0;
     
     // Loop through particle types
-    for (const auto& particle : particles) {
-      int count = fParticleCounts[detector][particle];
+    for (G4int s = kMuPlus; s <= kPi0; ++s) {
+      const char* particle = VolumeRoleTable::GetSpeciesName(static_cast<Species>(s));
+      int count = fParticleCounts[detectorIndex][s];
       if (count > 0) {
         detectorHasParticles = true;
-        G4double energy = fTotalEnergy[detector][particle];
+        G4double energy = fTotalEnergy[detectorIndex][s];
         G4double avgEnergy = (count > 0) ? energy / count : 0.0;
         
         G4cout << std::setw(12) << detector << " | " 
@@ -0,0 +1,191 @@
+// =============================
+// src/SecondaryFilter.cc
+// =============================
+
+#include "SecondaryFilter.hh"
+#include "G4Track.hh"
+#include "G4DynamicParticle.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4GenericMessenger.hh"
+#include "G4UIcommand.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+#include <cmath>
+#include <sstream>
+
+namespace {
+  // Half the thickness of the detector planes
+  const G4double kPlaneHalfThickness = 0.5*cm;
+}
+
+SecondaryFilter::SecondaryFilter()
+: fReachabilityCut(true),
+  fPlaneZ({ 10*cm, 200*cm, 500*cm }),
+  fPlaneRadius(80*cm),
+  fSolenoidField(7.0*tesla),
+  fMinChargedPz(10*MeV),
+  fMessenger(nullptr)
+{
+  // Same cut the stepping action used to apply: neutrons, electrons and
+  // photons below 8 GeV are not followed
+  for (G4int s = 0; s < kNumSpecies; ++s) {
+    fThreshold[s] = 0.;
+  }
+  fThreshold[kNeutron] = 8.0*GeV;
+  fThreshold[kElectron] = 8.0*GeV;
+  fThreshold[kGamma] = 8.0*GeV;
+  
+  fMessenger = new G4GenericMessenger(this, "/beamTest/stack/", "Stacking-time track selection");
+  
+  // The filter lives on the master thread only; workers read it directly
+  fMessenger->DeclareMethod("threshold", &SecondaryFilter::ThresholdCommand,
+    "Kinetic energy below which new tracks of a species are killed, "
+    "e.g. 'threshold neutron 8 GeV'. Species: mu+ mu- pi+ pi- pi0 neutron e- gamma other")
+    .SetParameterName("arguments", false)
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareProperty("reachability", fReachabilityCut,
+    "Kill secondaries that cannot reach any recorded detector plane")
+    .SetParameterName("enable", false)
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclareMethod("planes", &SecondaryFilter::PlanesCommand,
+    "z of the recorded detector planes, e.g. 'planes 10 200 500 cm' "
+    "(Detector1 to Detector3)")
+    .SetParameterName("arguments", false)
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclarePropertyWithUnit("planeRadius", "cm", fPlaneRadius,
+    "Acceptance radius of the detector planes")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclarePropertyWithUnit("solenoidField", "tesla", fSolenoidField,
+    "Nominal solenoid Bz used to estimate charged helices (0 = straight lines)")
+    .SetToBeBroadcasted(false);
+  
+  fMessenger->DeclarePropertyWithUnit("minChargedPz", "MeV", fMinChargedPz,
+    "Charged secondaries with a smaller forward momentum are killed (MeV/c)")
+    .SetToBeBroadcasted(false);
+}
+
+SecondaryFilter::~SecondaryFilter()
+{
+  delete fMessenger;
+}
+
+SecondaryFilter::Verdict SecondaryFilter::Classify(const G4Track* track,
+                                                   const VolumeRoleTable* roleTable) const
+{
+  Species species = roleTable->GetSpecies(track->GetDefinition());
+  if (track->GetKineticEnergy() < fThreshold[species]) {
+    return kBelowThreshold;
+  }
+  
+  // Primaries are always kept
+  if (track->GetParentID() == 0 || !fReachabilityCut) {
+    return kKeep;
+  }
+  
+  // The solenoid field is essentially along z and does not reverse pz, so
+  // only the planes ahead of the track count; a secondary created inside
+  // a plane is recorded there
+  const G4ThreeVector& position = track->GetPosition();
+  G4ThreeVector momentum = track->GetMomentum();
+  G4bool charged = track->GetDefinition()->GetPDGCharge() != 0.;
+  Verdict verdict = kNoPlaneAhead;
+  for (G4double planeZ : fPlaneZ) {
+    G4double dz = planeZ - position.z();
+    if (std::abs(dz) <= kPlaneHalfThickness) {
+      return kKeep;
+    }
+    if (dz * momentum.z() <= 0.) {
+      continue;
+    }
+    
+    // Slow motion along z means many turns in the solenoid before the plane
+    if (charged && std::abs(momentum.z()) < fMinChargedPz) {
+      verdict = kSlowCharged;
+      continue;
+    }
+    
+    if (CanReachPlane(track, dz)) {
+      return kKeep;
+    }
+    verdict = kOutsideAcceptance;
+  }
+  return verdict;
+}
+
+G4bool SecondaryFilter::CanReachPlane(const G4Track* track, G4double dz) const
+{
+  const G4ThreeVector& position = track->GetPosition();
+  G4ThreeVector momentum = track->GetMomentum();
+  G4double charge = track->GetDynamicParticle()->GetCharge();
+  G4double pT = momentum.perp();
+  
+  // Neutral tracks (or no field): straight line to the plane
+  if (charge == 0. || fSolenoidField == 0. || pT == 0.) {
+    G4double x = position.x() + momentum.x()/momentum.z()*dz;
+    G4double y = position.y() + momentum.y()/momentum.z()*dz;
+    return x*x + y*y <= fPlaneRadius*fPlaneRadius;
+  }
+  
+  // Charged tracks in a uniform Bz follow a helix whose distance from the
+  // axis never drops below |d - R|, where d is the distance of the helix
+  // axis from the beam axis and R the helix radius
+  G4double radius = pT/(std::abs(charge)*c_light*fSolenoidField);
+  G4double sign = (charge*fSolenoidField > 0.) ? 1. : -1.;
+  G4double centreX = position.x() + sign*radius*momentum.y()/pT;
+  G4double centreY = position.y() - sign*radius*momentum.x()/pT;
+  G4double centreDistance = std::sqrt(centreX*centreX + centreY*centreY);
+  
+  return std::abs(centreDistance - radius) <= fPlaneRadius;
+}
+
+void SecondaryFilter::ThresholdCommand(const G4String& value)
+{
+  std::istringstream is(value);
+  G4String name, unit;
+  G4double energy = 0.;
+  is >> name >> energy >> unit;
+  
+  Species species = VolumeRoleTable::FindSpecies(name);
+  if (is.fail() || species == kNumSpecies) {
+    G4cerr << "SecondaryFilter: cannot parse threshold '" << value << "'" << G4endl;
+    return;
+  }
+  
+  SetThreshold(species, energy*G4UIcommand::ValueOf(unit.c_str()));
+}
+
+void SecondaryFilter::PlanesCommand(const G4String& value)
+{
+  // Positions followed by one unit
+  std::istringstream is(value);
+  std::vector<G4String> tokens;
+  G4String token;
+  while (is >> token) {
+    tokens.push_back(token);
+  }
+  
+  std::vector<G4double> planes;
+  for (std::size_t i = 0; i + 1 < tokens.size(); ++i) {
+    std::istringstream number(tokens[i]);
+    G4double z = 0.;
+    if (!(number >> z)) {
+      planes.clear();
+      break;
+    }
+    planes.push_back(z);
+  }
+  G4double unit = tokens.empty() ? 0. : G4UIcommand::ValueOf(tokens.back().c_str());
+  if (planes.empty() || unit <= 0.) {
+    G4cerr << "SecondaryFilter: cannot parse planes '" << value << "'" << G4endl;
+    return;
+  }
+  
+  for (G4double& z : planes) {
+    z *= unit;
+  }
+  fPlaneZ = planes;
+}
@@ -0,0 +1,28 @@
+// =============================
+// src/StackingAction.cc
+// =============================
+
+#include "StackingAction.hh"
+#include "SecondaryFilter.hh"
+#include "VolumeRoleTable.hh"
+#include "G4Track.hh"
+
+StackingAction::StackingAction(const SecondaryFilter* filter)
+: G4UserStackingAction(),
+  fFilter(filter),
+  fRoleTable(VolumeRoleTable::Instance())
+{
+}
+
+StackingAction::~StackingAction()
+{
+}
+
+G4ClassificationOfNewTrack StackingAction::ClassifyNewTrack(const G4Track* track)
+{
+  // Killed tracks are never stacked, so their whole sub-tree is skipped
+  if (fFilter->Classify(track, fRoleTable) != SecondaryFilter::kKeep) {
+    return fKill;
+  }
+  return fUrgent;
+}
@@ -0,0 +1,178 @@
+// ========================
+// src/StepTrace.cc
+// ========================
+
+#include "StepTrace.hh"
+#include "G4Step.hh"
+#include "G4StepPoint.hh"
+#include "G4Track.hh"
+#include "G4VProcess.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4GenericMessenger.hh"
+#include "G4Threading.hh"
+#include "G4ios.hh"
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+  // Header written in front of every dumped block of records
+  struct StepTraceHeader
+  {
+    char magic[8];              // "G4STEPTR"
+    std::uint32_t version;
+    std::uint32_t recordSize;
+    std::uint64_t nRecords;
+    std::uint64_t nDropped;     // Records overwritten before the dump
+    std::int32_t threadID;
+    std::int32_t reserved;
+  };
+
+  const std::uint32_t kStepTraceVersion = 1;
+  const G4int kDefaultCapacity = 1 << 16;
+}
+
+StepTrace* StepTrace::Instance()
+{
+  static G4ThreadLocal StepTrace* instance = nullptr;
+  if (!instance) {
+    instance = new StepTrace();
+  }
+  return instance;
+}
+
+StepTrace::StepTrace()
+: fMask(0),
+  fHead(0),
+  fLevel(0),
+  fEventID(-1),
+  fLastTrackID(-1),
+  fLastStepNumber(-1),
+  fFileName("steptrace"),
+  fMessenger(nullptr)
+{
+  SetCapacity(kDefaultCapacity);
+
+  fMessenger = new G4GenericMessenger(this, "/beamTest/trace/", "Binary step tracing");
+
+  fMessenger->DeclareProperty("level", fLevel,
+    "Trace level: 0 = off, 1 = detector hits and helium cooling steps, 2 = all "
+    "steps, which needs the stepping action (/beamTest/actions/stepping true)")
+    .SetParameterName("level", false)
+    .SetRange("level>=0 && level<=2");
+
+  fMessenger->DeclareMethod("capacity", &StepTrace::SetCapacity,
+    "Ring buffer size in records per thread (rounded up to a power of two)")
+    .SetParameterName("nRecords", false)
+    .SetRange("nRecords>0");
+
+  fMessenger->DeclareProperty("file", fFileName,
+    "Base name of the per-thread trace files");
+
+  fMessenger->DeclareMethod("dump", &StepTrace::DumpCommand,
+    "Write the buffered step records to the trace file");
+}
+
+StepTrace::~StepTrace()
+{
+  delete fMessenger;
+}
+
+void StepTrace::SetCapacity(G4int nRecords)
+{
+  std::uint64_t capacity = 1;
+  while (capacity < static_cast<std::uint64_t>(nRecords)) {
+    capacity <<= 1;
+  }
+
+  fBuffer.assign(capacity, StepRecord());
+  fMask = capacity - 1;
+  fHead = 0;
+}
+
+void StepTrace::Record(const G4Step* step, G4int flags)
+{
+  const G4Track* track = step->GetTrack();
+
+  // The same step traced again adds its flags to the newest record
+  if (fHead > 0 && track->GetTrackID() == fLastTrackID
+      && track->GetCurrentStepNumber() == fLastStepNumber
+      && fBuffer[(fHead - 1) & fMask].eventID == fEventID) {
+    fBuffer[(fHead - 1) & fMask].flags |= flags;
+    return;
+  }
+  fLastTrackID = track->GetTrackID();
+  fLastStepNumber = track->GetCurrentStepNumber();
+
+  StepRecord& record = fBuffer[fHead & fMask];
+  ++fHead;
+
+  const G4StepPoint* prePoint = step->GetPreStepPoint();
+  const G4StepPoint* postPoint = step->GetPostStepPoint();
+  const G4VProcess* process = postPoint->GetProcessDefinedStep();
+
+  record.eventID = fEventID;
+  record.trackID = track->GetTrackID();
+  record.pdgCode = track->GetDefinition()->GetPDGEncoding();
+  record.volumeID = prePoint->GetTouchableHandle()->GetVolume()->GetLogicalVolume()->GetInstanceID();
+  record.processType = process ? process->GetProcessType() : -1;
+  record.processSubType = process ? process->GetProcessSubType() : -1;
+  record.flags = flags;
+  record.reserved = 0;
+  record.kineticEnergy = track->GetKineticEnergy();
+  record.stepLength = step->GetStepLength();
+
+  const G4ThreeVector& prePos = prePoint->GetPosition();
+  const G4ThreeVector& postPos = postPoint->GetPosition();
+  const G4ThreeVector momentum = track->GetMomentum();
+  for (G4int i = 0; i < 3; ++i) {
+    record.prePosition[i] = prePos[i];
+    record.postPosition[i] = postPos[i];
+    record.momentum[i] = momentum[i];
+  }
+}
+
+void StepTrace::Dump(const G4String& reason)
+{
+  if (fHead == 0) return;
+
+  G4int threadID = G4Threading::G4GetThreadId();
+  G4String fileName = fFileName + "_t" + std::to_string(threadID) + ".bin";
+
+  std::ofstream file(fileName, std::ios::binary | std::ios::app);
+  if (!file.is_open()) {
+    G4cerr << "Error opening " << fileName << G4endl;
+    return;
+  }
+
+  // Records are written oldest first
+  std::uint64_t capacity = fMask + 1;
+  std::uint64_t nRecords = (fHead < capacity) ? fHead : capacity;
+  std::uint64_t first = fHead - nRecords;
+
+  StepTraceHeader header;
+  std::memcpy(header.magic, "G4STEPTR", sizeof(header.magic));
+  header.version = kStepTraceVersion;
+  header.recordSize = sizeof(StepRecord);
+  header.nRecords = nRecords;
+  header.nDropped = first;
+  header.threadID = threadID;
+  header.reserved = 0;
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  // The ring may wrap, in which case it is written in two pieces
+  std::uint64_t start = first & fMask;
+  std::uint64_t firstChunk = std::min(nRecords, capacity - start);
+  file.write(reinterpret_cast<const char*>(&fBuffer[start]), firstChunk*sizeof(StepRecord));
+  if (firstChunk < nRecords) {
+    file.write(reinterpret_cast<const char*>(&fBuffer[0]), (nRecords - firstChunk)*sizeof(StepRecord));
+  }
+  file.close();
+
+  G4cout << "Step trace: wrote " << nRecords << " records to " << fileName
+         << " (" << reason << ")" << G4endl;
+
+  fHead = 0;
+}
@@ -0,0 +1,144 @@
+// ==============================
+// src/StepperComparison.cc
+// ==============================
+
+#include "StepperComparison.hh"
+#include "FieldIntegration.hh"
+#include "FieldStatistics.hh"
+
+#include "G4ElectroMagneticField.hh"
+#include "G4ChordFinder.hh"
+#include "G4EquationOfMotion.hh"
+#include "G4FieldTrack.hh"
+#include "G4ChargeState.hh"
+#include "G4MuonPlus.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4ios.hh"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+
+namespace {
+  // Physics step proposed to the chord finder, as a long geometry step would be
+  const G4double kProposedStep = 1.0*m;
+  
+  // Reference: Dormand-Prince with a tolerance far below any setting in use
+  const G4double kReferenceEpsilon = 1.0e-10;
+  const G4double kReferenceDeltaChord = 0.001*mm;
+  
+  const unsigned int kMuonSeed = 20240917;
+}
+
+StepperComparison::StepperComparison(const FieldIntegration& integration,
+                                     G4ElectroMagneticField* field)
+: fIntegration(integration),
+  fField(field),
+  fMuonMass(G4MuonPlus::Definition()->GetPDGMass())
+{
+}
+
+StepperComparison::~StepperComparison()
+{
+}
+
+void StepperComparison::Run(G4int nMuons, G4double trackLength)
+{
+  // Same muons for every stepper and every invocation: both charges,
+  // 0.1-3 GeV/c, from the target within 30 degrees of the axis
+  std::mt19937 engine(kMuonSeed);
+  std::uniform_real_distribution<G4double> flat(0., 1.);
+  fMuons.resize(nMuons);
+  for (G4int i = 0; i < nMuons; ++i) {
+    Muon& muon = fMuons[i];
+    G4double momentum = (0.1 + 2.9*flat(engine)) * GeV;
+    G4double cosTheta = 1. - (1. - std::cos(30.*deg)) * flat(engine);
+    G4double phi = 2.*M_PI * flat(engine);
+    G4double sinTheta = std::sqrt(1. - cosTheta*cosTheta);
+    muon.position = G4ThreeVector();
+    muon.direction = G4ThreeVector(sinTheta*std::cos(phi), sinTheta*std::sin(phi), cosTheta);
+    muon.kineticEnergy = std::sqrt(momentum*momentum + fMuonMass*fMuonMass) - fMuonMass;
+    muon.charge = (i % 2 == 0) ? 1. : -1.;
+  }
+  
+  FieldStatistics* statistics = FieldStatistics::Instance();
+  
+  // Reference end points
+  std::vector<G4ThreeVector> reference(nMuons);
+  {
+    G4EquationOfMotion* equation = nullptr;
+    G4ChordFinder* chordFinder = fIntegration.CreateChordFinder("DormandPrince745", fField, true, &equation);
+    chordFinder->SetDeltaChord(kReferenceDeltaChord);
+    for (G4int i = 0; i < nMuons; ++i) {
+      reference[i] = Propagate(chordFinder, equation, fMuons[i], trackLength, kReferenceEpsilon);
+    }
+    delete chordFinder;
+  }
+  
+  G4cout << "\n";
+  G4cout << "================================================================" << G4endl;
+  G4cout << "                   FIELD STEPPER COMPARISON                      " << G4endl;
+  G4cout << "================================================================" << G4endl;
+  G4cout << " " << nMuons << " muons over " << trackLength/m << " m in the "
+         << fIntegration.GetName() << " field, deltaChord "
+         << fIntegration.GetDeltaChord()/mm << " mm" << G4endl;
+  G4cout << std::setw(18) << "Stepper" << " | " 
+         << std::setw(12) << "Calls/track" << " | " 
+         << std::setw(12) << "us/track" << " | " 
+         << std::setw(12) << "Max dev [mm]" << " | " 
+         << std::setw(12) << "Mean dev [mm]" << G4endl;
+  G4cout << "----------------------------------------------------------------" << G4endl;
+  
+  for (G4int s = 0; s < FieldIntegration::kNumSteppers; ++s) {
+    const char* stepperName = FieldIntegration::kStepperNames[s];
+    G4EquationOfMotion* equation = nullptr;
+    G4ChordFinder* chordFinder = fIntegration.CreateChordFinder(stepperName, fField, true, &equation);
+    
+    G4long callsBefore = statistics->GetFieldCalls();
+    auto start = std::chrono::steady_clock::now();
+    
+    G4double maxDeviation = 0.;
+    G4double sumDeviation = 0.;
+    for (G4int i = 0; i < nMuons; ++i) {
+      G4ThreeVector end = Propagate(chordFinder, equation, fMuons[i], trackLength, 0.);
+      G4double deviation = (end - reference[i]).mag();
+      maxDeviation = std::max(maxDeviation, deviation);
+      sumDeviation += deviation;
+    }
+    
+    auto stop = std::chrono::steady_clock::now();
+    G4double microseconds = std::chrono::duration<G4double, std::micro>(stop - start).count();
+    G4long calls = statistics->GetFieldCalls() - callsBefore;
+    delete chordFinder;
+    
+    G4cout << std::setw(18) << stepperName << " | " 
+           << std::setw(12) << static_cast<G4double>(calls) / nMuons << " | " 
+           << std::setw(12) << microseconds / nMuons << " | " 
+           << std::setw(12) << maxDeviation/mm << " | " 
+           << std::setw(12) << sumDeviation/nMuons/mm << G4endl;
+  }
+  G4cout << "================================================================" << G4endl;
+}
+
+G4ThreeVector StepperComparison::Propagate(G4ChordFinder* chordFinder, G4EquationOfMotion* equation,
+                                           const Muon& muon, G4double trackLength, G4double epsilon) const
+{
+  G4FieldTrack track(muon.position, 0., muon.direction, muon.kineticEnergy, fMuonMass, muon.charge);
+  
+  G4double momentum = std::sqrt(muon.kineticEnergy * (muon.kineticEnergy + 2.*fMuonMass));
+  equation->SetChargeMomentumMass(G4ChargeState(muon.charge, 0., 0.5), momentum, fMuonMass);
+  chordFinder->ResetStepEstimate();
+  
+  // Chord-limited steps, as G4PropagatorInField takes them without geometry
+  G4double travelled = 0.;
+  while (travelled < trackLength) {
+    G4double request = std::min(kProposedStep, trackLength - travelled);
+    G4double stepEpsilon = (epsilon > 0.) ? epsilon : fIntegration.GetEpsilon(request);
+    G4double advanced = chordFinder->AdvanceChordLimited(track, request, stepEpsilon,
+                                                         track.GetPosition(), 0.);
+    if (advanced <= 0.) break;
+    travelled += advanced;
+  }
+  return track.GetPosition();
+}
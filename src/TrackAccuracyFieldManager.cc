@@ -0,0 +1,41 @@
+// =====================================
+// src/TrackAccuracyFieldManager.cc
+// =====================================
+
+#include "TrackAccuracyFieldManager.hh"
+#include "G4Track.hh"
+#include "G4VPhysicalVolume.hh"
+
+TrackAccuracyFieldManager::TrackAccuracyFieldManager(const FieldIntegration& integration)
+: G4FieldManager(),
+  fIntegration(integration),
+  fRoles(VolumeRoleTable::Instance()),
+  fStatistics(FieldStatistics::Instance()),
+  fApplied(nullptr),
+  fAppliedVersion(-1)
+{
+}
+
+void TrackAccuracyFieldManager::ConfigureForTrack(const G4Track* track)
+{
+  Species species = fRoles->GetSpecies(track->GetDefinition());
+  fStatistics->EnterFieldStep(species, track->GetVolume()->GetLogicalVolume());
+  
+  const FieldIntegration::TrackAccuracy* accuracy = nullptr;
+  if (fIntegration.IsPerTrackAccuracy()) {
+    G4double momentum = track->GetDynamicParticle()->GetTotalMomentum();
+    for (const FieldIntegration::TrackAccuracy& band : fIntegration.GetTrackAccuracies(species)) {
+      if (momentum <= band.maxMomentum) {
+        accuracy = &band;
+        break;
+      }
+    }
+  }
+  
+  if (accuracy == fApplied && fAppliedVersion == fIntegration.GetTableVersion()) {
+    return;
+  }
+  fIntegration.ApplyAccuracy(this, accuracy);
+  fApplied = accuracy;
+  fAppliedVersion = fIntegration.GetTableVersion();
+}
@@ -0,0 +1,93 @@
+// =============================
+// src/VolumeRoleTable.cc
+// =============================
+
+#include "VolumeRoleTable.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4ParticleTable.hh"
+#include <algorithm>
+
+namespace {
+  const char* const kDetectorNames[kNumDetectors] = {
+    "Detector1", "Detector2", "Detector3"
+  };
+
+  const char* const kSpeciesNames[kNumSpecies] = {
+    "other", "mu+", "mu-", "pi+", "pi-", "pi0", "neutron", "e-", "gamma"
+  };
+
+  struct NamedRole {
+    const char* name;
+    VolumeRole role;
+  };
+
+  const NamedRole kNamedRoles[] = {
+    {"Detector1", kDetector1},
+    {"Detector2", kDetector2},
+    {"Detector3", kDetector3},
+    {"HeliumCloud", kHeliumCloud},
+    {"RFCavity", kRFCavity},
+    {"RFGap", kRFCavity}
+  };
+}
+
+VolumeRoleTable* VolumeRoleTable::Instance()
+{
+  static G4ThreadLocal VolumeRoleTable* instance = nullptr;
+  if (!instance) {
+    instance = new VolumeRoleTable();
+  }
+  return instance;
+}
+
+void VolumeRoleTable::Build()
+{
+  // Every logical volume defaults to passive
+  G4LogicalVolumeStore* lvStore = G4LogicalVolumeStore::GetInstance();
+  G4int maxVolumeID = -1;
+  for (const G4LogicalVolume* volume : *lvStore) {
+    maxVolumeID = std::max(maxVolumeID, volume->GetInstanceID());
+  }
+  fRoles.assign(maxVolumeID + 1, kPassive);
+
+  for (const NamedRole& entry : kNamedRoles) {
+    G4LogicalVolume* volume = lvStore->GetVolume(entry.name, false);
+    if (volume) {
+      fRoles[volume->GetInstanceID()] = entry.role;
+    } else {
+      G4cout << "VolumeRoleTable: logical volume " << entry.name << " not found" << G4endl;
+    }
+  }
+
+  // Particles outside the table map to kOtherSpecies
+  G4ParticleTable* particleTable = G4ParticleTable::GetParticleTable();
+  fSpecies.clear();
+  for (G4int s = kOtherSpecies + 1; s < kNumSpecies; ++s) {
+    const G4ParticleDefinition* particle = particleTable->FindParticle(kSpeciesNames[s]);
+    if (!particle || particle->GetInstanceID() < 0) continue;
+
+    std::size_t id = static_cast<std::size_t>(particle->GetInstanceID());
+    if (id >= fSpecies.size()) {
+      fSpecies.resize(id + 1, kOtherSpecies);
+    }
+    fSpecies[id] = static_cast<Species>(s);
+  }
+}
+
+const char* VolumeRoleTable::GetDetectorName(G4int detectorIndex)
+{
+  return kDetectorNames[detectorIndex];
+}
+
+const char* VolumeRoleTable::GetSpeciesName(Species species)
+{
+  return kSpeciesNames[species];
+}
+
+Species VolumeRoleTable::FindSpecies(const G4String& name)
+{
+  for (G4int s = 0; s < kNumSpecies; ++s) {
+    if (name == kSpeciesNames[s]) return static_cast<Species>(s);
+  }
+  return kNumSpecies;
+}
@@ -0,0 +1,86 @@
+// ==========================
+// tools/phaseSpaceToCsv.cc
+// ==========================
+
+// Convert a columnar phase-space file to the CSV layout of
+// trajectory_data.csv, for scripts written against the CSV output:
+//
+//   phaseSpaceToCsv trajectory_data_run0.bps [trajectory_data.csv] [--species]
+//
+// Without an output file the CSV goes to standard output. --species
+// appends the particle name to every row.
+
+#include "PhaseSpaceReader.hh"
+#include <cstdio>
+#include <cstring>
+
+using namespace PhaseSpaceFormat;
+
+namespace {
+  template <class Real>
+  void WriteGroup(std::FILE* out, const PhaseSpaceReader& reader,
+                  const PhaseSpaceReader::Group& group, G4bool withSpecies)
+  {
+    const std::int32_t* eventIDs = group.GetEventIDs();
+    const std::uint8_t* detectors = group.GetDetectors();
+    const std::uint8_t* species = group.GetSpecies();
+    const Real* columns[kNumRealColumns];
+    for (G4int i = 0; i < kNumRealColumns; ++i) {
+      columns[i] = group.GetColumn<Real>(static_cast<Column>(kX + i));
+    }
+    
+    for (std::size_t row = 0; row < group.GetNRows(); ++row) {
+      std::fprintf(out, "%d,%s", eventIDs[row], reader.GetDetectorName(detectors[row]));
+      for (G4int i = 0; i < kNumRealColumns; ++i) {
+        std::fprintf(out, ",%g", static_cast<G4double>(columns[i][row]));
+      }
+      if (withSpecies) {
+        std::fprintf(out, ",%s", reader.GetSpeciesName(species[row]));
+      }
+      std::fputc('\n', out);
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  const char* inputName = nullptr;
+  const char* outputName = nullptr;
+  G4bool withSpecies = false;
+  for (G4int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--species") == 0) {
+      withSpecies = true;
+    } else if (!inputName) {
+      inputName = argv[i];
+    } else if (!outputName) {
+      outputName = argv[i];
+    }
+  }
+  if (!inputName) {
+    std::fprintf(stderr, "usage: %s input.bps [output.csv] [--species]\n", argv[0]);
+    return 1;
+  }
+  
+  PhaseSpaceReader reader(inputName);
+  if (!reader.IsValid()) return 1;
+  
+  std::FILE* out = outputName ? std::fopen(outputName, "w") : stdout;
+  if (!out) {
+    std::fprintf(stderr, "cannot write %s\n", outputName);
+    return 1;
+  }
+  
+  std::fputs(withSpecies ? "EventID,Detector,X,PX,Y,PY,Z,PZ,ParticleName\n"
+                         : "EventID,Detector,X,PX,Y,PY,Z,PZ\n", out);
+  for (std::size_t g = 0; g < reader.GetNGroups(); ++g) {
+    PhaseSpaceReader::Group group = reader.GetGroup(g);
+    if (reader.IsDoublePrecision()) {
+      WriteGroup<double>(out, reader, group, withSpecies);
+    } else {
+      WriteGroup<float>(out, reader, group, withSpecies);
+    }
+  }
+  
+  if (out != stdout) std::fclose(out);
+  return 0;
+}